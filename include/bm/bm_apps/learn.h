@@ -77,6 +77,8 @@ class LearnListener {
 
  private:
   void listen_loop();
+  void shm_listen_loop(const std::string &shm_name);
+  void handle_msg(const MsgInfo &info, const char *data);
 
  private:
   std::string socket_name{};
@@ -21,8 +21,7 @@
 #ifndef BM_BM_SIM_ACTION_PROFILE_H_
 #define BM_BM_SIM_ACTION_PROFILE_H_
 
-// shared_mutex will only be available in C++-14, so for now I'm using boost
-#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
 
 #include <iosfwd>
 #include <string>
@@ -33,6 +32,8 @@
 #include "handle_mgr.h"
 #include "match_error_codes.h"
 #include "ras.h"
+#include "flow_cache.h"
+#include "sharded_shared_mutex.h"
 
 namespace bm {
 
@@ -164,8 +165,8 @@ class ActionProfile : public NamedP4Object {
   void deserialize(std::istream *in, const P4Objects &objs);
 
  private:
-  using ReadLock = boost::shared_lock<boost::shared_mutex>;
-  using WriteLock = boost::unique_lock<boost::shared_mutex>;
+  using ReadLock = boost::shared_lock<TableSharedMutex>;
+  using WriteLock = boost::unique_lock<TableSharedMutex>;
 
   class IndirectIndexRefCount {
    public:
@@ -268,7 +269,12 @@ class ActionProfile : public NamedP4Object {
 
   // lock can be acquired by MatchTableIndirect
   ReadLock lock_read() const { return ReadLock(t_mutex); }
-  WriteLock lock_write() const { return WriteLock(t_mutex); }
+  // see MatchTableAbstract::lock_write
+  WriteLock lock_write() const {
+    WriteLock lock(t_mutex);
+    FlowCache::invalidate_all();
+    return lock;
+  }
 
   // this method is called by MatchTableIndirect and assumes that the provided
   // index is correct
@@ -293,7 +299,7 @@ class ActionProfile : public NamedP4Object {
                             const IndirectIndex &index) const;
 
  private:
-  mutable boost::shared_mutex t_mutex{};
+  mutable TableSharedMutex t_mutex{};
   bool with_selection;
   std::vector<ActionEntry> action_entries{};
   IndirectIndexRefCount index_ref_count{};
@@ -531,6 +531,14 @@ class ActionPrimitive_ {
     return current_offset + 1;
   }
 
+  //! Primitives which only access their RegisterArray parameters through
+  //! RegisterArray::read() and RegisterArray::write(), and do not keep a
+  //! reference to a register, can override this to return true; see
+  //! RegisterArray for the consequences on locking. The index of the accessed
+  //! register must be the parameter which immediately follows the
+  //! RegisterArray parameter.
+  virtual bool uses_striped_register_accesses() const { return false; }
+
   void _set_p4objects(P4Objects *p4objects) {
     this->p4objects = p4objects;
   }
@@ -622,6 +630,10 @@ class ActionPrimitiveCall {
 
   SourceInfo *get_source_info() const { return source_info.get(); }
 
+  bool uses_striped_register_accesses() const {
+    return primitive->uses_striped_register_accesses();
+  }
+
  private:
   ActionPrimitive_ *primitive;
   size_t param_offset;
@@ -671,6 +683,31 @@ class ActionFn :  public NamedP4Object {
 
   size_t get_num_params() const;
 
+  // set by P4Objects if all the primitives called by the action are known to
+  // only access the PHV through their parameters, see
+  // FlowCache::is_cacheable_primitive
+  void set_flow_cacheable(bool flow_cacheable);
+
+  // appends the PHV fields referenced by the action parameters to fields;
+  // returns false if the action cannot be cached by the FlowCache
+  bool get_flow_cache_fields(FlowCacheFields *fields) const;
+
+  // called by P4Objects once all the primitives have been added; if all the
+  // register arrays referenced by the action are only referenced once, by a
+  // primitive for which uses_striped_register_accesses() returns true, they
+  // are not locked when the action is executed and the primitives lock the
+  // accessed register instead; if the action only references one register
+  // array, through such primitives which all access the same index, only the
+  // stripe containing that index is locked when the action is executed
+  void enable_striped_register_accesses();
+
+ private:
+  bool is_stable_index(const ActionParam &param_1,
+                       const ActionParam &param_2) const;
+
+  bool field_is_only_index(const ActionParam &field_param,
+                           size_t nb_refs) const;
+
  private:
   std::vector<ActionPrimitiveCall> primitives{};
   std::vector<ActionParam> params{};
@@ -680,6 +717,10 @@ class ActionFn :  public NamedP4Object {
   std::vector<std::unique_ptr<ArithExpression> > expressions{};
   std::vector<std::string> strings{};
   size_t num_params;
+  bool flow_cacheable{false};
+  // set by enable_striped_register_accesses() for read-modify-write actions
+  RegisterArray *rmw_register_array{nullptr};
+  size_t rmw_index_param{0};
 
  private:
   static size_t nb_data_tmps;
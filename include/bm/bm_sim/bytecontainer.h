@@ -29,6 +29,9 @@
 #include <iterator>
 #include <string>
 
+#include <cstdint>
+#include <cstring>
+
 #include "short_alloc.h"
 
 namespace bm {
@@ -259,7 +262,18 @@ class ByteContainer {
   //! Will assert if `size() != mask.size()`.
   void apply_mask(const ByteContainer &mask) {
     assert(size() == mask.size());
-    for (size_t i = 0; i < size(); i++)
+    const size_t n = size();
+    size_t i = 0;
+    // 8 bytes at a time; memcpy is used to avoid alignment issues and is
+    // optimized into plain loads / stores by the compiler
+    for (; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+      uint64_t w, m;
+      std::memcpy(&w, &bytes[i], sizeof(w));
+      std::memcpy(&m, &mask.bytes[i], sizeof(m));
+      w &= m;
+      std::memcpy(&bytes[i], &w, sizeof(w));
+    }
+    for (; i < n; i++)
       bytes[i] &= mask[i];
   }
 
@@ -44,6 +44,17 @@
 //! example: `uint32_t(const char *buf, size_t s) const`. Otherwise, you will
 //! get a compilation error.
 //!
+//! Optionally, the functor can also define a `gather` method, which computes
+//! the hash of several buffers (described by HashFragment objects) as if they
+//! were concatenated. When a calculation includes the packet payload, this lets
+//! us hash the payload in place instead of copying it after the fields:
+//! @code
+//! struct hash_ex {
+//!   uint32_t operator()(const char *buf, size_t s) const;
+//!   uint32_t gather(const bm::HashFragment *fragments, size_t n) const;
+//! };
+//! @endcode
+//!
 //! You can then register your hash function like this:
 //! @code
 //! REGISTER_HASH(hash_ex)
@@ -59,6 +70,7 @@
 #include <string>
 #include <unordered_map>
 #include <tuple>
+#include <utility>
 #include <vector>
 #include <algorithm>   // for std::copy
 #include <iosfwd>
@@ -160,6 +172,24 @@ struct HashChecker<true, H> {
 };
 
 
+//! A fragment of the input of a hash algorithm, see RawCalculationIface.
+struct HashFragment {
+  const char *buf;
+  size_t s;
+};
+
+/* Used to determine whether a hash functor defines the optional 'gather'
+   method */
+template <typename T>
+struct defines_gather {
+  template <typename U>
+  static char test(decltype(std::declval<const U &>().gather(
+      static_cast<const HashFragment *>(nullptr), size_t())) *);
+  template <typename> static int test(...);
+
+  static bool constexpr value = sizeof(test<T>(nullptr)) == sizeof(char);
+};
+
 template <typename U,
           typename std::enable_if<std::is_unsigned<U>::value, int>::type = 0>
 class RawCalculationIface {
@@ -168,15 +198,37 @@ class RawCalculationIface {
     return output_(buffer, s);
   }
 
+  //! Returns the hash of the concatenation of the \p n fragments
+  U output(const HashFragment *fragments, size_t n) const {
+    return output_fragments_(fragments, n);
+  }
+
   std::unique_ptr<RawCalculationIface<U> > clone() const {
     return std::unique_ptr<RawCalculationIface<U> > (clone_());
   }
 
   virtual ~RawCalculationIface() { }
 
+ protected:
+  // for algorithms which cannot process fragments one after the other: the
+  // fragments are copied to a per-thread scratch buffer
+  U output_concatenated(const HashFragment *fragments, size_t n) const {
+    static thread_local std::vector<char> scratch;
+    scratch.clear();
+    for (size_t i = 0; i < n; i++) {
+      scratch.insert(scratch.end(), fragments[i].buf,
+                     fragments[i].buf + fragments[i].s);
+    }
+    return output_(scratch.data(), scratch.size());
+  }
+
  private:
   virtual U output_(const char *buffer, size_t s) const = 0;
 
+  virtual U output_fragments_(const HashFragment *fragments, size_t n) const {
+    return output_concatenated(fragments, n);
+  }
+
   virtual RawCalculationIface<U> *clone_() const = 0;
 };
 
@@ -200,6 +252,10 @@ class RawCalculation
     return output__(buffer, s);
   }
 
+  T output_fragments_(const HashFragment *fragments, size_t n) const override {
+    return gather__(fragments, n);
+  }
+
   RawCalculation<T, HashFn> *clone_() const override {
     RawCalculation<T, HashFn> *ptr = new RawCalculation<T, HashFn>();
     return ptr;
@@ -225,6 +281,21 @@ class RawCalculation
     return static_cast<U>(0u);
   }
 
+  template <typename U = T, typename H = HashFn,
+            typename std::enable_if<std::is_unsigned<U>::value, int>::type = 0>
+  typename std::enable_if<HC::valid_hash && defines_gather<H>::value, U>::type
+  gather__(const HashFragment *fragments, size_t n) const {
+    return static_cast<U>(hash.gather(fragments, n));
+  }
+
+  template <typename U = T, typename H = HashFn,
+            typename std::enable_if<std::is_unsigned<U>::value, int>::type = 0>
+  typename std::enable_if<!(HC::valid_hash && defines_gather<H>::value),
+                          U>::type
+  gather__(const HashFragment *fragments, size_t n) const {
+    return this->output_concatenated(fragments, n);
+  }
+
   HashFn hash;
 };
 
@@ -238,6 +309,22 @@ class BufBuilder {
 
   void operator()(const Packet &pkt, ByteContainer *buf) const;
 
+  // Used for incremental checksum updates. Builds the buffer without the
+  // payload, either from the current field values (build_headers) or from the
+  // values the fields had when their headers were extracted from the packet
+  // (build_from_packet_bytes, see Header::get_packet_bytes). The latter returns
+  // false if these values are not available for one of the entries.
+  void build_headers(const Packet &pkt, ByteContainer *buf) const;
+  bool build_from_packet_bytes(const Packet &pkt, ByteContainer *buf) const;
+
+  bool has_payload() const { return with_payload; }
+
+  static HashFragment get_payload(const Packet &pkt);
+
+  // true iff the field is one of the entries, or belongs to one of the header
+  // entries
+  bool uses_field(header_id_t header, int field_offset) const;
+
  private:
   struct field_t {
     header_id_t header;
@@ -254,6 +341,7 @@ class BufBuilder {
   };
 
   struct Deparse;  // defined in calculations.cpp
+  struct DeparseFromPacket;  // defined in calculations.cpp
 
   std::vector<boost::variant<field_t, constant_t, header_t> > entries{};
   bool with_payload{false};
@@ -270,12 +358,20 @@ class Calculation_ {
 
   T output(const Packet &pkt) const {
     static thread_local ByteContainer key;
-    builder(pkt, &key);
-    return c->output(key.data(), key.size());
+    builder.build_headers(pkt, &key);
+    if (!builder.has_payload()) return c->output(key.data(), key.size());
+    // the payload is not copied after the fields
+    const HashFragment fragments[2] = {
+      {key.data(), key.size()}, BufBuilder::get_payload(pkt)};
+    return c->output(fragments, 2);
   }
 
   RawCalculationIface<T> *get_raw_calculation() { return c.get(); }
 
+  const RawCalculationIface<T> &get_raw_calculation() const { return *c; }
+
+  const BufBuilder &get_buf_builder() const { return builder; }
+
  protected:
   ~Calculation_() { }
 
@@ -344,6 +440,10 @@ namespace hash {
 
 uint64_t xxh64(const char *buffer, size_t s);
 
+// returns true if \p c computes the 16-bit one's complement checksum used by
+// IP, TCP & UDP (i.e. "csum16" or "cksum16")
+bool is_csum16(const RawCalculationIface<uint64_t> &c);
+
 }  // namespace hash
 
 
@@ -21,6 +21,7 @@
 #ifndef BM_BM_SIM_CHECKSUMS_H_
 #define BM_BM_SIM_CHECKSUMS_H_
 
+#include <atomic>
 #include <string>
 #include <memory>
 
@@ -46,6 +47,24 @@ class Checksum : public NamedP4Object{
 
   void set_checksum_condition(std::unique_ptr<Expression> cksum_condition);
 
+  //! When enabled, 16-bit one's complement checksums (IPv4Checksum, and
+  //! CalcBasedChecksum using "csum16") are updated incrementally, as per RFC
+  //! 1624: the new value is derived from the checksum found in the packet and
+  //! from the difference between the current and original values of the
+  //! covered fields, instead of going over all the covered bytes again (which
+  //! include the payload for TCP & UDP). This assumes that the checksum in the
+  //! incoming packet is correct; an incorrect checksum will remain incorrect.
+  //! We fall back to a full computation whenever the original values are not
+  //! available (e.g. a covered header was added or invalidated, or a covered
+  //! field belongs to a metadata header). In practice, this means that the
+  //! IPv4 header checksum and UDP checksums (whose pseudo-header uses the
+  //! udp.length field) are updated incrementally, but not TCP checksums, whose
+  //! pseudo-header includes a TCP length computed by the P4 program into
+  //! metadata. Disabled by default.
+  static void set_incremental_updates(bool enable);
+
+  static bool get_incremental_updates();
+
  private:
   virtual void update_(Packet *pkt) const = 0;
   virtual bool verify_(const Packet &pkt) const = 0;
@@ -60,6 +79,8 @@ class Checksum : public NamedP4Object{
 
  private:
   std::unique_ptr<Expression> condition{nullptr};
+
+  static std::atomic<bool> incremental_updates;
 };
 
 class CalcBasedChecksum : public Checksum {
@@ -78,6 +99,8 @@ class CalcBasedChecksum : public Checksum {
   void update_(Packet *pkt) const override;
   bool verify_(const Packet &pkt) const override;
 
+  bool update_incremental(const Packet &pkt, uint64_t *cksum) const;
+
  private:
   const NamedCalculation *calculation{nullptr};
 };
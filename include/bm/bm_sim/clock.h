@@ -0,0 +1,101 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! @file clock.h
+//! This file contains bm::Clock, the time source used by the data path.
+
+#ifndef BM_BM_SIM_CLOCK_H_
+#define BM_BM_SIM_CLOCK_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace bm {
+
+//! A monotonic clock shared by all the components of the data path which need
+//! to read the current time for every packet. By default, every call reads the
+//! system's steady clock. Each consumer can instead be given a resolution with
+//! set_resolution(), in which case the calls made on behalf of this consumer
+//! return a cached time, refreshed by a background thread every `resolution`
+//! (the smallest resolution among all consumers). The cached time can lag
+//! behind the actual time by up to that resolution.
+//!
+//! All the consumers share the same epoch (the epoch of `Clock::clock`), so
+//! values obtained for different consumers can be compared with each other.
+class Clock {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  //! The components which read the time through this class
+  enum class Consumer {
+    //! entry timestamps used for table ageing
+    AGEING,
+    //! meters (see Meter::set_time_resolution())
+    METERS,
+    //! rate limiters of the egress queues
+    QUEUEING,
+    //! packet timestamps exposed to the P4 program by targets
+    TIMESTAMPS,
+    NUM_CONSUMERS
+  };
+
+  static clock::time_point now(Consumer consumer) {
+    const auto c = static_cast<size_t>(consumer);
+    if (!coarse[c].load(std::memory_order_relaxed)) return clock::now();
+    return clock::time_point(
+        clock::duration(cached_ticks.load(std::memory_order_relaxed)));
+  }
+
+  //! Number of microseconds since the clock's epoch
+  static uint64_t get_micros(Consumer consumer) {
+    using std::chrono::duration_cast;
+    return duration_cast<std::chrono::microseconds>(
+        now(consumer).time_since_epoch()).count();
+  }
+
+  //! Number of milliseconds since the clock's epoch
+  static uint64_t get_millis(Consumer consumer) {
+    using std::chrono::duration_cast;
+    return duration_cast<std::chrono::milliseconds>(
+        now(consumer).time_since_epoch()).count();
+  }
+
+  //! Sets the resolution of the time returned for \p consumer. A resolution of
+  //! 0 (the default) means that the steady clock is read on every call.
+  static void set_resolution(Consumer consumer,
+                             std::chrono::microseconds resolution);
+
+  static std::chrono::microseconds get_resolution(Consumer consumer);
+
+  //! Returns the consumer with the given name ("ageing", "meters",
+  //! "queueing" or "timestamps"), or Consumer::NUM_CONSUMERS if the name is
+  //! unknown.
+  static Consumer consumer_from_name(const std::string &name);
+
+ private:
+  static constexpr size_t nb_consumers =
+      static_cast<size_t>(Consumer::NUM_CONSUMERS);
+
+  static std::atomic<bool> coarse[nb_consumers];
+  static std::atomic<clock::rep> cached_ticks;
+};
+
+}  // namespace bm
+
+#endif  // BM_BM_SIM_CLOCK_H_
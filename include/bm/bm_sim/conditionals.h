@@ -53,6 +53,10 @@ class Conditional
   // return pointer to next control flow node
   const ControlFlowNode *operator()(Packet *pkt) const override;
 
+  bool get_flow_cache_fields(FlowCacheFields *fields) const override {
+    return Expression::get_flow_cache_fields(fields);
+  }
+
   Conditional(const Conditional &other) = delete;
   Conditional &operator=(const Conditional &other) = delete;
 
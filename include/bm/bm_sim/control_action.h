@@ -44,6 +44,12 @@ class ControlAction : public ControlFlowNode {
 
   const ControlFlowNode *operator()(Packet *pkt) const override;
 
+  // the action itself is reported to the FlowCache when it is executed
+  bool get_flow_cache_fields(FlowCacheFields *fields) const override {
+    (void) fields;
+    return true;
+  }
+
  private:
   ControlFlowNode *next_node{nullptr};
   ActionFn *action;
@@ -22,12 +22,14 @@
 #define BM_BM_SIM_CONTROL_FLOW_H_
 
 #include <string>
+#include <vector>
 
 #include "named_p4object.h"
 
 namespace bm {
 
 class Packet;
+class FlowCacheFields;
 
 class ControlFlowNode : public NamedP4Object {
  public:
@@ -38,6 +40,24 @@ class ControlFlowNode : public NamedP4Object {
       : NamedP4Object(name, id, std::move(source_info)) {}
   virtual ~ControlFlowNode() { }
   virtual const ControlFlowNode *operator()(Packet *pkt) const = 0;
+
+  // Applies the node to a batch of packets and appends the next node for each
+  // packet to \p next_nodes. Nodes which can share work between packets (e.g.
+  // match tables) override this; by default each packet is processed in turn.
+  virtual void apply_batch(const std::vector<Packet *> &pkts,
+                           std::vector<const ControlFlowNode *> *next_nodes)
+      const {
+    for (auto pkt : pkts) next_nodes->push_back((*this)(pkt));
+  }
+
+  // Used by FlowCache: appends the PHV fields consulted by the node (not by the
+  // actions it executes, which are reported separately) to \p fields. Returns
+  // false if the node has side effects which prevent caching, which is the
+  // default.
+  virtual bool get_flow_cache_fields(FlowCacheFields *fields) const {
+    (void) fields;
+    return false;
+  }
 };
 
 }  // namespace bm
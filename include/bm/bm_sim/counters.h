@@ -42,6 +42,7 @@
 
 #include "named_p4object.h"
 #include "packet.h"
+#include "thread_index.h"
 
 namespace bm {
 
@@ -49,6 +50,13 @@ namespace bm {
 //! and packets. The data plane is in charge of incrementing the counters
 //! (e.g. through an action primitive), the control plane can query or write
 //! a given value to the counters.
+//!
+//! When several packet processing threads update the same counter, the cache
+//! line holding the counter values keeps moving between CPU cores. To avoid
+//! this, counters can be sharded (see set_num_shards() and enable_sharding()):
+//! each thread then increments its own cell, and the cells are added together
+//! when the counter is queried. The cells are only allocated the first time
+//! the counter is incremented.
 class Counter {
  public:
   //! A counter value (measuring bytes or packets) is a `uint64_t`.
@@ -61,8 +69,20 @@ class Counter {
     ERROR
   };
 
+  Counter() = default;
+
+  ~Counter();
+
   //! Increments both counter values (bytes and packets)
   void increment_counter(const Packet &pkt) {
+    if (num_cells > 1) {
+      Cell *c = cells.load(std::memory_order_acquire);
+      if (!c) c = allocate_cells();
+      Cell &cell = c[thread_index() & (num_cells - 1)];
+      cell.bytes.fetch_add(pkt.get_ingress_length(), std::memory_order_relaxed);
+      cell.packets.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
     bytes += pkt.get_ingress_length();
     packets += 1;
   }
@@ -79,9 +99,41 @@ class Counter {
   void serialize(std::ostream *out) const;
   void deserialize(std::istream *in);
 
+  //! Makes this counter use get_num_shards() cells. This is done for the
+  //! counters of a CounterArray and for the direct counters of the match tables
+  //! with counters; all other counters (e.g. the direct counters of a table
+  //! without counters, which are never read) use a single cell. Must be called
+  //! before the counter is first incremented.
+  void enable_sharding();
+
+  //! Sets the number of cells used by the counters for which sharding is
+  //! enabled after this call. The number is rounded up to a power of 2. The
+  //! default is 1, which means that counters are not sharded. Sharding only
+  //! makes sense with several packet processing threads and costs one cache
+  //! line per cell, for each counter which is incremented at least once.
+  static void set_num_shards(size_t num_shards);
+
+  static size_t get_num_shards();
+
  private:
+  // only the first 16 bytes are accessed; with the 16-byte alignment provided
+  // by new, they never straddle 2 cache lines, and since each cell occupies a
+  // full cache line, no 2 cells have their values in the same cache line
+  struct Cell {
+    std::atomic<std::uint_fast64_t> bytes{0u};
+    std::atomic<std::uint_fast64_t> packets{0u};
+    char padding[64 - 2 * sizeof(std::atomic<std::uint_fast64_t>)];
+  };
+
+  Cell *allocate_cells();
+
   std::atomic<std::uint_fast64_t> bytes{0u};
   std::atomic<std::uint_fast64_t> packets{0u};
+  // allocated by the first thread to increment a sharded counter
+  std::atomic<Cell *> cells{nullptr};
+  size_t num_cells{1};
+
+  static size_t num_shards;
 };
 
 using meter_array_id_t = p4object_id_t;
@@ -105,7 +157,9 @@ class CounterArray : public NamedP4Object {
 
  public:
   CounterArray(const std::string &name, p4object_id_t id, size_t size)
-    : NamedP4Object(name, id), counters(size) { }
+    : NamedP4Object(name, id), counters(size) {
+    for (Counter &c : counters) c.enable_sharding();
+  }
 
   CounterErrorCode reset_counters();
 
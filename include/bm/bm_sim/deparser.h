@@ -60,6 +60,11 @@ class Deparser : public NamedP4Object {
   //! Packet::get_data_size().
   void deparse(Packet *pkt) const;
 
+  //! Deparses each packet in \p pkts in turn. This is equivalent to calling
+  //! deparse() for each packet; it exists so that targets which process
+  //! packets in batches can use the same structure for every stage.
+  void deparse_batch(const std::vector<Packet *> &pkts) const;
+
  private:
   size_t get_headers_size(const PHV &phv) const;
 
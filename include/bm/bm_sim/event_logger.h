@@ -26,6 +26,9 @@
 #include <string>
 #include <memory>
 
+#include <cstddef>
+#include <cstdint>
+
 #include "device_id.h"
 #include "phv_forward.h"
 #include "transport.h"
@@ -63,11 +66,24 @@ using entry_handle_t = uint32_t;
 //! responsible of generated "packet in" and "packet out" messages (when a
 //! packet is received / transmitted). Obviously, this is optional and you do
 //! not have to do it if you are not interested in using the event logger.
+//!
+//! By default, each event is published as its own message, by the thread which
+//! generates it. When asynchronous mode is enabled with set_async(), each
+//! thread instead writes events to its own fixed-size ring buffer, which is
+//! drained by a background thread. The background thread concatenates events
+//! (using the same binary format) into messages of up to 8KB, which
+//! subscribers need to split. The events of a given thread are published in
+//! the order in which they were generated, but events from different threads
+//! may be interleaved differently, even for the same packet (e.g. ingress and
+//! egress events). Subscribers can use the packet id and copy id included in
+//! each event to group the events of a packet. Events are dropped (and
+//! counted, see get_dropped_events()) when a ring is full.
 class EventLogger {
  public:
   explicit EventLogger(std::unique_ptr<TransportIface> transport,
-                       device_id_t device_id = 0)
-      : transport_instance(std::move(transport)), device_id(device_id) { }
+                       device_id_t device_id = 0);
+
+  ~EventLogger();
 
   // we need the ingress / egress ports, but they are part of the Packet
   //! Signal that a packet was received by the switch
@@ -99,20 +115,39 @@ class EventLogger {
 
   void config_change();
 
+  //! If \p ring_size is not 0, switch to asynchronous mode, with a ring of \p
+  //! ring_size events (rounded up to a power of 2) for each thread generating
+  //! events. If \p ring_size is 0, go back to synchronous mode. Pending events
+  //! are published before this function returns. This function must not be
+  //! called concurrently with the generation of events.
+  void set_async(size_t ring_size);
+
+  //! Number of events dropped because a ring was full, since the last call to
+  //! set_async().
+  uint64_t get_dropped_events() const;
+
   static EventLogger *get() {
     static EventLogger event_logger(TransportIface::make_dummy());
     return &event_logger;
   }
 
   static void init(std::unique_ptr<TransportIface> transport,
-                   device_id_t device_id = 0) {
-    get()->transport_instance = std::move(transport);
-    get()->device_id = device_id;
+                   device_id_t device_id = 0, size_t ring_size = 0) {
+    auto event_logger = get();
+    event_logger->set_async(0);
+    event_logger->transport_instance = std::move(transport);
+    event_logger->device_id = device_id;
+    event_logger->set_async(ring_size);
   }
 
  private:
+  class AsyncWriter;
+
+  void send(const void *msg, size_t len);
+
   std::unique_ptr<TransportIface> transport_instance{nullptr};
   device_id_t device_id{};
+  std::unique_ptr<AsyncWriter> async_writer{nullptr};
 };
 
 }  // namespace bm
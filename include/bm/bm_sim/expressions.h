@@ -25,6 +25,8 @@
 #include <string>
 #include <vector>
 
+#include <cstdint>
+
 #include "data.h"
 #include "phv_forward.h"
 
@@ -32,6 +34,7 @@ namespace bm {
 
 class RegisterArray;
 class RegisterSync;
+class FlowCacheFields;
 
 enum class ExprOpcode {
   LOAD_FIELD, LOAD_HEADER, LOAD_HEADER_STACK, LOAD_LAST_HEADER_STACK_FIELD,
@@ -118,6 +121,32 @@ struct Op {
   };
 };
 
+// An expression which applies a chain of arithmetic operations with small
+// constant operands to a single field, e.g. (hdr.ihl - 5) * 32. Such
+// expressions are common for the length of variable-length headers, and can be
+// evaluated on 64-bit integers instead of going through the generic evaluator,
+// see Expression::get_field_chain().
+struct FieldChainExpression {
+  struct Step {
+    // one of ADD, SUB, MUL, SHIFT_LEFT and BIT_AND, with the field value
+    // (i.e. the result of the previous step) as the left operand
+    ExprOpcode opcode;
+    int64_t value;
+  };
+
+  header_id_t header;
+  int field_offset;
+  std::vector<Step> steps{};
+
+  // returns false if an intermediate result would not fit in 64 bits, in which
+  // case the expression has to be evaluated normally
+  bool eval(int64_t field_value, int64_t *res) const;
+
+  // same as above, reading the field from the PHV; also returns false if the
+  // field is wider than 32 bits
+  bool eval(const PHV &phv, int64_t *res) const;
+};
+
 class Expression {
  public:
   Expression();
@@ -145,6 +174,16 @@ class Expression {
 
   void grab_register_accesses(RegisterSync *register_sync) const;
 
+  // appends the PHV fields read by the expression to fields; returns false if
+  // the expression reads state which cannot be described this way (registers,
+  // header stacks, unions)
+  bool get_flow_cache_fields(FlowCacheFields *fields) const;
+
+  // returns true and fills chain if the expression is a chain of operations
+  // with constant operands applied to a single field (see
+  // FieldChainExpression)
+  bool get_field_chain(FieldChainExpression *chain) const;
+
   bool eval_bool(const PHV &phv, const std::vector<Data> &locals = {}) const;
   Data eval_arith(const PHV &phv, const std::vector<Data> &locals = {}) const;
   void eval_arith(const PHV &phv, Data *data,
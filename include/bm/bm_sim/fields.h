@@ -62,6 +62,7 @@ class Field : public Data {
     assert(len == nbytes);
     std::copy(src_bytes, src_bytes + len, bytes.begin());
     if (arith) sync_value();
+    mark_modified();
   }
 
   void sync_value() {
@@ -71,6 +72,7 @@ class Field : public Data {
       value += min;
     }
     written_to = true;
+    mark_modified();
     // TODO(antonin): should notifications be disabled for hidden fields?
     DEBUGGER_NOTIFY_UPDATE(*packet_id, my_id, bytes.data(), nbits);
   }
@@ -125,6 +127,7 @@ class Field : public Data {
       }
     }
     written_to = true;
+    mark_modified();
     DEBUGGER_NOTIFY_UPDATE(*packet_id, my_id, bytes.data(), nbits);
   }
 
@@ -176,7 +179,17 @@ class Field : public Data {
     return written_to;
   }
 
+  // called by Header, \p tracker is reset to nullptr every time the value of
+  // the field changes, see Header::deparse_to_packet()
+  void set_modification_tracker(const char **tracker) {
+    modification_tracker = tracker;
+  }
+
  private:
+  void mark_modified() {
+    if (modification_tracker) *modification_tracker = nullptr;
+  }
+
   int nbits;
   int nbytes;
   ByteContainer bytes;
@@ -186,6 +199,7 @@ class Field : public Data {
   bool VL{false};
   bool is_saturating{false};
   bool written_to{false};  // used to keep track of whether a field was modified
+  const char **modification_tracker{nullptr};
   Bignum mask{1};
   Bignum max{1};
   Bignum min{1};
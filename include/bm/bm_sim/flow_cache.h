@@ -0,0 +1,192 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! @file flow_cache.h
+//! This file contains bm::FlowCache, an optional megaflow cache which can be
+//! enabled for a bm::Pipeline with Pipeline::enable_flow_cache().
+//!
+//! When a packet misses in the cache, it goes through the pipeline as usual,
+//! while the cache records which PHV fields are consulted along the way (table
+//! keys, conditions and the fields referenced by the actions executed). The
+//! values of these fields before the pipeline form the flow key; the fields
+//! whose value changed form the list of writes. Subsequent packets which have
+//! the same values for the same set of fields are not sent through the
+//! pipeline: the writes are replayed directly on their PHV.
+//!
+//! Caching is only attempted when every node and action on the packet's path
+//! can describe exactly which PHV fields it accesses, and has no other side
+//! effect. In particular tables with direct counters, meters or ageing, action
+//! selectors, register accesses, header stacks and most target primitives
+//! (except for the ones listed in FlowCache::is_cacheable_primitive) disable
+//! caching for the paths on which they appear. The contents of all caches are
+//! invalidated every time a match table or an action profile is modified.
+
+#ifndef BM_BM_SIM_FLOW_CACHE_H_
+#define BM_BM_SIM_FLOW_CACHE_H_
+
+#include <boost/thread/locks.hpp>
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+
+#include "bytecontainer.h"
+#include "phv_forward.h"
+#include "sharded_shared_mutex.h"
+
+namespace bm {
+
+class ActionFn;
+class ControlFlowNode;
+class Packet;
+
+//! Used by control flow nodes and actions to report to the FlowCache which PHV
+//! fields they may access.
+class FlowCacheFields {
+ public:
+  // a field, identified by its header and offset; if the offset is VALID, the
+  // validity bit of the header, if it is HEADER, the full header
+  using FieldRef = std::pair<header_id_t, int>;
+
+  static constexpr int VALID = -1;
+  static constexpr int HEADER = -2;
+
+  void push_back_field(header_id_t header, int field_offset) {
+    refs.emplace_back(header, field_offset);
+  }
+
+  void push_back_valid(header_id_t header) {
+    refs.emplace_back(header, VALID);
+  }
+
+  void push_back_header(header_id_t header) {
+    refs.emplace_back(header, HEADER);
+  }
+
+  const std::vector<FieldRef> &get_refs() const { return refs; }
+
+ private:
+  std::vector<FieldRef> refs{};
+};
+
+class FlowCache {
+ public:
+  using FieldRef = FlowCacheFields::FieldRef;
+
+  //! Records the accesses made by a packet going through the pipeline, so
+  //! that they can be turned into a new cache entry with commit(). Only one
+  //! Recorder can be active at a time in a given thread.
+  class Recorder {
+   public:
+    Recorder(FlowCache *cache, const PHV &phv);
+    ~Recorder();
+
+    // must be called before the node is applied
+    void visit_node(const ControlFlowNode &node);
+
+    // must be called before the action is executed
+    void visit_action(const ActionFn &action_fn);
+
+    void commit();
+
+    Recorder(const Recorder &other) = delete;
+    Recorder &operator=(const Recorder &other) = delete;
+
+   private:
+    void capture(const FlowCacheFields &fields);
+    void capture_one(const FieldRef &ref);
+
+    FlowCache *cache;
+    const PHV &phv;
+    uint64_t generation;
+    bool cacheable{true};
+    // value of each field when it is first consulted, which is also its value
+    // before the pipeline: a field can only be written by an action which
+    // references it, at which point it is captured
+    std::map<FieldRef, ByteContainer> values{};
+  };
+
+  explicit FlowCache(size_t max_entries);
+
+  //! Looks up \p pkt in the cache and, if found, replays the cached writes on
+  //! its PHV. Returns true iff the packet was found in the cache.
+  bool lookup(Packet *pkt);
+
+  //! Number of flows currently in the cache
+  size_t get_num_entries() const;
+
+  void clear();
+
+  //! Invalidates the contents of all the flow caches. This is called every
+  //! time a match table or an action profile is modified.
+  static void invalidate_all() {
+    generation.fetch_add(1, std::memory_order_seq_cst);
+  }
+
+  //! Called for every executed action, forwards the action to the Recorder
+  //! active in this thread, if any.
+  static void record_action(const ActionFn &action_fn) {
+    if (recorder) recorder->visit_action(action_fn);
+  }
+
+  //! Returns true if the primitive with the given name only accesses the PHV
+  //! through its parameters, in which case it can be part of a cached action.
+  static bool is_cacheable_primitive(const std::string &name);
+
+  FlowCache(const FlowCache &other) = delete;
+  FlowCache &operator=(const FlowCache &other) = delete;
+
+ private:
+  using ReadLock = boost::shared_lock<ShardedSharedMutex>;
+  using WriteLock = boost::unique_lock<ShardedSharedMutex>;
+
+  struct Write {
+    FieldRef ref;
+    ByteContainer value;
+  };
+
+  // all the flows which were recorded with the same set of consulted fields
+  struct Mask {
+    std::vector<FieldRef> refs;
+    std::unordered_map<ByteContainer, std::vector<Write>, ByteContainerKeyHash>
+        flows;
+  };
+
+  void insert(std::vector<FieldRef> refs, const ByteContainer &key,
+              std::vector<Write> writes, uint64_t recorded_generation);
+  void clear_();
+
+  static void append_value(const PHV &phv, const FieldRef &ref,
+                           ByteContainer *key);
+  static void apply_write(const Write &write, PHV *phv);
+
+  size_t max_entries;
+  size_t num_entries{0};
+  std::vector<Mask> masks{};
+  std::atomic<uint64_t> cache_generation;
+  mutable ShardedSharedMutex mutex{};
+
+  static std::atomic<uint64_t> generation;
+  static thread_local Recorder *recorder;
+};
+
+}  // namespace bm
+
+#endif  // BM_BM_SIM_FLOW_CACHE_H_
@@ -69,12 +69,16 @@ class HeaderUnion : public NamedP4Object {
   // used for stacks of header unions
   void swap_values(HeaderUnion *other) {
     assert(headers.size() == other->headers.size());
+    // only the valid headers carry data; swapping the pair of headers at the
+    // index of each valid header is enough to exchange the unions' contents
+    if (valid)
+      headers[valid_header_idx].get().swap_values(
+          &other->headers[valid_header_idx].get());
+    if (other->valid && !(valid && valid_header_idx == other->valid_header_idx))
+      headers[other->valid_header_idx].get().swap_values(
+          &other->headers[other->valid_header_idx].get());
     std::swap(valid, other->valid);
     std::swap(valid_header_idx, other->valid_header_idx);
-    // this is probably too conservative, I think we only need to swap valid
-    // headers, but this is a good place to start
-    for (size_t i = 0; i < headers.size(); i++)
-      headers[i].get().swap_values(&other->headers[i].get());
   }
 
   //! Returns a pointer to the valid Header instance in the union, or nullptr if
@@ -37,6 +37,7 @@ using header_type_id_t = p4object_id_t;
 
 class VLHeaderExpression;
 class ArithExpression;
+struct FieldChainExpression;
 
 class HeaderUnion;
 
@@ -57,6 +58,14 @@ class HeaderType : public NamedP4Object {
     bool is_hidden;
   };
 
+  // Position of a field in the packet data, see get_extract_plan()
+  struct FieldPlacement {
+    int field_offset;
+    int byte_offset;
+    // offset of the first bit of the field in the byte at byte_offset
+    int bit_offset;
+  };
+
   size_t get_hidden_offset(HiddenF hf) const {
     return fields_info.size() - 1 - static_cast<size_t>(hf);
   }
@@ -131,8 +140,20 @@ class HeaderType : public NamedP4Object {
 
   int get_VL_max_header_bytes() const;
 
+  // The position of each non-hidden field in the packet data, computed as
+  // fields are added to the type, so that Header::extract and Header::deparse
+  // do not need to walk the fields with a running bit offset. Empty for VL
+  // headers, since the position of the fields after the VL field depends on
+  // the packet.
+  const std::vector<FieldPlacement> &get_extract_plan() const {
+    return extract_plan;
+  }
+
  private:
+  void build_extract_plan();
+
   std::vector<FInfo> fields_info;
+  std::vector<FieldPlacement> extract_plan{};
   // used for VL headers only
   std::unique_ptr<VLHeaderExpression> VL_expr_raw;
   int VL_offset{-1};
@@ -225,6 +246,21 @@ class Header : public NamedP4Object {
 
   void deparse(char *data) const;
 
+  //! Same as deparse(), except that nothing is written if the header was
+  //! extracted from (or last deparsed to) \p data and none of its fields has
+  //! been modified since, in which case \p data already holds the right bytes.
+  //! This assumes that only the parser and the deparser write to the packet
+  //! bytes before the packet data. Returns true iff the header was written.
+  bool deparse_to_packet(char *data);
+
+  //! Returns the location of the header in the packet data, i.e. where it was
+  //! extracted from (or last deparsed to by deparse_to_packet()). Unlike for
+  //! deparse_to_packet(), modifying a field does not reset this location, so
+  //! the returned bytes hold the values the fields had at that time. Returns
+  //! nullptr if the header was not extracted from the packet, or if it has
+  //! been marked valid / invalid, reset or copied to since.
+  const char *get_packet_bytes() const { return packet_bytes; }
+
   //! Returns the number of fields in the header
   size_type size() const noexcept { return fields.size(); }
 
@@ -312,7 +348,15 @@ class Header : public NamedP4Object {
   bool metadata{false};
   int nbytes_packet{0};
   std::unique_ptr<ArithExpression> VL_expr;
+  // set when VL_expr is a simple function of a field (e.g. (ihl - 5) * 32), in
+  // which case we do not need to go through the expression evaluator
+  std::unique_ptr<FieldChainExpression> VL_chain{nullptr};
   std::unique_ptr<UnionMembership> union_membership{nullptr};
+  // location of the header bytes in the packet, reset by the fields when they
+  // are modified
+  const char *unmodified_packet_bytes{nullptr};
+  // location of the header bytes in the packet, even if modified
+  const char *packet_bytes{nullptr};
 #ifdef BMDEBUG_ON
   const Debugger::PacketId *packet_id{&Debugger::dummy_PacketId};
 #endif
@@ -97,6 +97,10 @@ class LearnEngineIface {
   //! The \p list_id should be mapped to a field list in the JSON fed into the
   //! switch. Since learning is still not well-standardized in P4, this process
   //! is a little bit hacky for now.
+  //!
+  //! The calling thread only stages the learn sample. Removing duplicates,
+  //! batching samples into notifications and sending the notifications is
+  //! done by a background thread, one per learn list.
   virtual void learn(list_id_t list_id, const Packet &pkt) = 0;
 
   virtual LearnErrorCode ack(list_id_t list_id, buffer_id_t buffer_id,
@@ -108,6 +112,16 @@ class LearnEngineIface {
 
   virtual void reset_state() = 0;
 
+  //! Sets the number of entries in the recent-key caches used to drop
+  //! duplicate learn samples before they reach the exact filter (the value is
+  //! rounded up to a power of 2). Each learn list has one such cache per
+  //! staging slot of its ingress threads. A value of 0 disables the caches.
+  //! This only applies to learn lists created after the call. The default is
+  //! 256.
+  static void set_dedup_cache_size(size_t cache_size);
+
+  static size_t get_dedup_cache_size();
+
   static std::unique_ptr<LearnEngineIface> make(device_id_t device_id = 0,
                                                 cxt_id_t cxt_id = 0);
 };
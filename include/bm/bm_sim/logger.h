@@ -29,14 +29,32 @@
 //! packet
 //!   - BMLOG_TRACE(), or BMLOG_TRACE_PKT() for messages regarding a specific
 //! packet
+//!
+//! When they are compiled in, these macros cost a single branch when the
+//! message would not be logged: their arguments are not evaluated. Messages
+//! are attributed to a subsystem (see Logger::Subsystem), which can be enabled
+//! or disabled at runtime. A source file selects its subsystem by defining
+//! BMLOG_SUBSYSTEM before including any header, e.g.:
+//! @code
+//! #define BMLOG_SUBSYSTEM PARSER
+//! @endcode
+//! The default subsystem is GENERAL.
 
 #ifndef BM_BM_SIM_LOGGER_H_
 #define BM_BM_SIM_LOGGER_H_
 
 #include <bm/spdlog/spdlog.h>
 
+#include <atomic>
 #include <string>
 
+#include <cstddef>
+#include <cstdint>
+
+#ifndef BMLOG_SUBSYSTEM
+#define BMLOG_SUBSYSTEM GENERAL
+#endif
+
 namespace bm {
 
 //! Provides logging for bmv2.
@@ -62,6 +80,13 @@ class Logger {
     TRACE, DEBUG, INFO, NOTICE, WARN, ERROR, CRITICAL, ALERT, EMERG, OFF
   };
 
+  //! Subsystems for which debug and trace messages can be enabled or disabled
+  //! independently
+  enum class Subsystem {
+    GENERAL, PARSER, DEPARSER, PIPELINE, TABLES, ACTIONS, CHECKSUMS, TARGET,
+    NUM_SUBSYSTEMS
+  };
+
  public:
   //! Get an instance of the logger. It actually returns a pointer to a spdlog
   //! logger instance.
@@ -91,7 +116,41 @@ class Logger {
   static void set_logger_file(const std::string &filename,
                               bool force_flush = false);
 
+  //! Log messages are formatted and written by a background thread, which
+  //! messages reach through a queue of \p queue_size entries (must be a power
+  //! of 2). Must be called before set_logger_console() or set_logger_file().
+  static void set_async(size_t queue_size);
+
+  //! Enable or disable debug and trace messages for a given subsystem. All
+  //! subsystems are enabled by default. Can be called at any time.
+  static void set_subsystem_enabled(Subsystem subsystem, bool enabled);
+
+  static bool is_subsystem_enabled(Subsystem subsystem);
+
+  static const char *subsystem_name(Subsystem subsystem);
+
+  //! Returns false if \p name is not the name of a subsystem.
+  static bool subsystem_from_name(const std::string &name,
+                                  Subsystem *subsystem);
+
+  //! Returns true iff a debug message for \p subsystem would be logged.
+  static bool debug_enabled(Subsystem subsystem) {
+    return debug_mask.load(std::memory_order_relaxed) & bit(subsystem);
+  }
+
+  //! Returns true iff a trace message for \p subsystem would be logged.
+  static bool trace_enabled(Subsystem subsystem) {
+    return trace_mask.load(std::memory_order_relaxed) & bit(subsystem);
+  }
+
  private:
+  static uint32_t bit(Subsystem subsystem) {
+    return static_cast<uint32_t>(1) << static_cast<int>(subsystem);
+  }
+
+  // recomputes debug_mask and trace_mask after a configuration change
+  static void update_masks();
+
   static spdlog::logger *init_logger();
 
   static spdlog::level::level_enum to_spd_level(LogLevel level);
@@ -102,6 +161,11 @@ class Logger {
 
  private:
   static spdlog::logger *logger;
+  // one bit per subsystem, set iff a message with the corresponding level
+  // would be logged: the subsystem is enabled, the log level is low enough
+  // and messages are not going to the null sink
+  static std::atomic<uint32_t> debug_mask;
+  static std::atomic<uint32_t> trace_mask;
 };
 
 }  // namespace bm
@@ -109,7 +173,9 @@ class Logger {
 #ifdef BMLOG_DEBUG_ON
 //! Preferred way (because can be disabled at compile time) to log a debug
 //! message. Is enabled by preprocessor BMLOG_DEBUG_ON.
-#define BMLOG_DEBUG(...) bm::Logger::get()->debug(__VA_ARGS__);
+#define BMLOG_DEBUG(...)                                                \
+  (bm::Logger::debug_enabled(bm::Logger::Subsystem::BMLOG_SUBSYSTEM)    \
+    ? (void) bm::Logger::get()->debug(__VA_ARGS__) : (void) 0);
 #else
 #define BMLOG_DEBUG(...)
 #endif
@@ -117,7 +183,9 @@ class Logger {
 #ifdef BMLOG_TRACE_ON
 //! Preferred way (because can be disabled at compile time) to log a trace
 //! message. Is enabled by preprocessor BMLOG_TRACE_ON.
-#define BMLOG_TRACE(...) bm::Logger::get()->trace(__VA_ARGS__);
+#define BMLOG_TRACE(...)                                                \
+  (bm::Logger::trace_enabled(bm::Logger::Subsystem::BMLOG_SUBSYSTEM)    \
+    ? (void) bm::Logger::get()->trace(__VA_ARGS__) : (void) 0);
 #else
 #define BMLOG_TRACE(...)
 #endif
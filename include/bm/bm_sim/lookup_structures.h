@@ -105,6 +105,9 @@
 #ifndef BM_BM_SIM_LOOKUP_STRUCTURES_H_
 #define BM_BM_SIM_LOOKUP_STRUCTURES_H_
 
+#include <memory>
+#include <vector>
+
 #include "match_key_types.h"
 #include "bytecontainer.h"
 
@@ -125,6 +128,20 @@ class LookupStructure {
   virtual bool lookup(const ByteContainer &key_data,
                       internal_handle_t *handle) const = 0;
 
+  //! Look up a batch of keys (for a batch of packets). On return, `(*hits)[i]`
+  //! is true if and only if there is a match for `keys[i]`, in which case
+  //! `(*handles)[i]` is set to the found value. The default implementation
+  //! calls lookup() for each key; implementations may override it to share
+  //! work between keys or to overlap their memory accesses.
+  virtual void lookup_batch(const std::vector<ByteContainer> &keys,
+                            std::vector<internal_handle_t> *handles,
+                            std::vector<bool> *hits) const {
+    handles->resize(keys.size());
+    hits->resize(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+      (*hits)[i] = lookup(keys[i], &(*handles)[i]);
+  }
+
   //! Check whether an entry exists. This is distinct from a lookup operation
   //! in that this will also match against the prefix length in the case of
   //! an LPM structure, and against the mask and priority in the case of a
@@ -164,6 +181,11 @@ using RangeLookupStructure = LookupStructure<RangeMatchKey>;
 //! data structure.
 class LookupStructureFactory {
  public:
+  //! Ternary tables with at most this many entries use a priority-sorted
+  //! array, which lets lookups stop at the first match, instead of the default
+  //! ternary lookup structure.
+  static constexpr size_t small_ternary_max_size = 256;
+
   explicit LookupStructureFactory(bool enable_ternary_cache = true);
 
   virtual ~LookupStructureFactory() = default;
@@ -21,8 +21,7 @@
 #ifndef BM_BM_SIM_MATCH_TABLES_H_
 #define BM_BM_SIM_MATCH_TABLES_H_
 
-// shared_mutex will only be available in C++-14, so for now I'm using boost
-#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
 
 #include <vector>
 #include <type_traits>
@@ -35,6 +34,8 @@
 #include "lookup_structures.h"
 #include "action_entry.h"
 #include "action_profile.h"
+#include "flow_cache.h"
+#include "sharded_shared_mutex.h"
 
 namespace bm {
 
@@ -112,12 +113,29 @@ class MatchTableAbstract : public NamedP4Object {
 
   const ControlFlowNode *apply_action(Packet *pkt);
 
+  //! Same as apply_action() for a batch of packets. All the lookups are
+  //! performed first, then the actions are executed. The next node for each
+  //! packet is appended to \p next_nodes.
+  void apply_action_batch(const std::vector<Packet *> &pkts,
+                          std::vector<const ControlFlowNode *> *next_nodes);
+
   virtual MatchTableType get_table_type() const = 0;
 
   virtual const ActionEntry &lookup(const Packet &pkt, bool *hit,
                                     entry_handle_t *handle,
                                     const ControlFlowNode **next_node) = 0;
 
+  struct LookupResult {
+    const ActionEntry *action_entry;
+    entry_handle_t handle;
+    bool hit;
+    const ControlFlowNode *next_node;
+  };
+
+  // the default implementation calls lookup() for each packet
+  virtual void lookup_batch(const std::vector<Packet *> &pkts,
+                            std::vector<LookupResult> *results);
+
   virtual size_t get_num_entries() const = 0;
 
   virtual bool is_valid_handle(entry_handle_t handle) const = 0;
@@ -175,9 +193,19 @@ class MatchTableAbstract : public NamedP4Object {
 
   void sweep_entries(std::vector<entry_handle_t> *entries) const;
 
+  // used by the ageing monitor, see MatchUnitAbstract_::take_ttl_updates and
+  // MatchUnitAbstract_::get_entries_expiry
+  void take_ttl_updates(std::vector<entry_handle_t> *handles);
+
+  void get_entries_expiry(const std::vector<entry_handle_t> &handles,
+                          std::vector<uint64_t> *expiry_ms) const;
+
   handle_iterator handles_begin() const;
   handle_iterator handles_end() const;
 
+  // see ControlFlowNode::get_flow_cache_fields
+  bool get_flow_cache_fields(FlowCacheFields *fields) const;
+
   // meant to be called by P4Objects when loading the JSON
   // set_default_entry sets a default entry obtained from the JSON. You can make
   // sure that it cannot be changed by the control plane by using the is_const
@@ -193,8 +221,8 @@ class MatchTableAbstract : public NamedP4Object {
   MatchTableAbstract &operator=(MatchTableAbstract &&other) = delete;
 
  protected:
-  using ReadLock = boost::shared_lock<boost::shared_mutex>;
-  using WriteLock = boost::unique_lock<boost::shared_mutex>;
+  using ReadLock = boost::shared_lock<TableSharedMutex>;
+  using WriteLock = boost::unique_lock<TableSharedMutex>;
 
  protected:
   const ControlFlowNode *get_next_node(p4object_id_t action_id) const;
@@ -204,7 +232,13 @@ class MatchTableAbstract : public NamedP4Object {
   void set_entry_common_info(EntryCommon *entry) const;
 
   ReadLock lock_read() const { return ReadLock(t_mutex); }
-  WriteLock lock_write() const { return WriteLock(t_mutex); }
+  // every modification to the table goes through this method, which makes it a
+  // convenient place to invalidate the flow caches
+  WriteLock lock_write() const {
+    WriteLock lock(t_mutex);
+    FlowCache::invalidate_all();
+    return lock;
+  }
 
  protected:
   // Not sure these guys need to be atomic with the current code
@@ -239,6 +273,10 @@ class MatchTableAbstract : public NamedP4Object {
   int meter_target_offset{};
 
  private:
+  // everything which happens in apply_action() after the lookup
+  void execute_action(Packet *pkt, const ActionEntry &action_entry, bool hit,
+                      entry_handle_t handle);
+
   virtual void reset_state_(bool reset_default_entry) = 0;
 
   virtual void serialize_(std::ostream *out) const = 0;
@@ -275,7 +313,7 @@ class MatchTableAbstract : public NamedP4Object {
   std::string dump_entry_string_(entry_handle_t handle) const;
 
  private:
-  mutable boost::shared_mutex t_mutex{};
+  mutable TableSharedMutex t_mutex{};
   MatchUnitAbstract_ *match_unit_{nullptr};
 };
 
@@ -328,6 +366,9 @@ class MatchTable : public MatchTableAbstract {
                             entry_handle_t *handle,
                             const ControlFlowNode **next_node) override;
 
+  void lookup_batch(const std::vector<Packet *> &pkts,
+                    std::vector<LookupResult> *results) override;
+
   size_t get_num_entries() const override {
     return match_unit->get_num_entries();
   }
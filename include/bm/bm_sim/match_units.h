@@ -25,6 +25,7 @@
 #include <unordered_map>
 #include <vector>
 #include <atomic>
+#include <mutex>
 #include <utility>  // for pair<>
 #include <memory>
 #include <iosfwd>
@@ -33,6 +34,7 @@
 #include "match_error_codes.h"
 #include "lookup_structures.h"
 #include "bytecontainer.h"
+#include "clock.h"
 #include "packet.h"
 #include "handle_mgr.h"
 #include "counters.h"
@@ -42,6 +44,7 @@
 namespace bm {
 
 class P4Objects;  // forward declaration for deserialize
+class FlowCacheFields;
 
 // using string and not ByteContainer for efficiency
 struct MatchKeyParam {
@@ -100,10 +103,14 @@ class MatchKeyBuilder {
 
   void apply_big_mask(ByteContainer *key) const;
 
+  // overwrites the contents of key, which is resized to get_nbytes_key()
   void operator()(const PHV &phv, ByteContainer *key) const;
 
   std::vector<std::string> key_to_fields(const ByteContainer &key) const;
 
+  // appends the fields used to build the key to fields
+  void get_flow_cache_fields(FlowCacheFields *fields) const;
+
   std::string key_to_string(const ByteContainer &key,
                             std::string separator = "",
                             bool upper_case = false) const;
@@ -157,6 +164,8 @@ class MatchKeyBuilder {
   // inverse of key_mapping, could be handy
   std::vector<size_t> inv_mapping{};
   std::vector<size_t> key_offsets{};
+  // byte offset of each entry of key_input in the implementation-specific key
+  std::vector<size_t> imp_offsets{};
   NameMap name_map{};
   bool built{false};
   std::vector<ByteContainer> masks{};
@@ -206,7 +215,7 @@ struct AtomicTimestamp {
 };
 
 struct EntryMeta {
-  using clock = Packet::clock;
+  using clock = Clock::clock;
 
   AtomicTimestamp ts{};
   uint32_t timeout_ms{0};
@@ -215,7 +224,7 @@ struct EntryMeta {
 
   void reset() {
     counter.reset_counter();
-    ts.set(clock::now());
+    ts.set(Clock::get_millis(Clock::Consumer::AGEING));
   }
 };
 
@@ -274,6 +283,10 @@ class MatchUnitAbstract_ {
 
   size_t get_nbytes_key() const { return nbytes_key; }
 
+  const MatchKeyBuilder &get_match_key_builder() const {
+    return match_key_builder;
+  }
+
   bool valid_handle(entry_handle_t handle) const;
 
   MatchUnit::EntryMeta &get_entry_meta(entry_handle_t handle);
@@ -281,6 +294,10 @@ class MatchUnitAbstract_ {
 
   void reset_counters();
 
+  // shards the direct counters (see Counter::enable_sharding()); only done for
+  // tables with counters, since the other tables never read them
+  void enable_counter_sharding();
+
   void set_direct_meters(MeterArray *meter_array);
 
   Meter &get_meter(entry_handle_t handle);
@@ -289,6 +306,16 @@ class MatchUnitAbstract_ {
 
   void sweep_entries(std::vector<entry_handle_t> *entries) const;
 
+  // moves to handles the handles of the entries whose TTL was set since the
+  // last call; used by the ageing monitor to know which entries to track
+  void take_ttl_updates(std::vector<entry_handle_t> *handles);
+
+  // for each handle, the time (in ms, same reference as EntryMeta::ts) at which
+  // the entry will expire if it is not hit, or 0 if the handle is no longer
+  // valid or if the entry has no TTL
+  void get_entries_expiry(const std::vector<entry_handle_t> &handles,
+                          std::vector<uint64_t> *expiry_ms) const;
+
   void dump_key_params(std::ostream *out,
                        const std::vector<MatchKeyParam> &params,
                        int priority = -1) const;
@@ -330,8 +357,13 @@ class MatchUnitAbstract_ {
   HandleMgr handles{};
   MatchKeyBuilder match_key_builder;
   std::vector<MatchUnit::EntryMeta> entry_meta{};
+  // handles of the entries whose TTL was set, see take_ttl_updates(); has its
+  // own mutex so that the ageing monitor does not need the table lock
+  std::vector<entry_handle_t> ttl_updates{};
+  std::mutex ttl_updates_mutex{};
   // non-owning pointer, the meter array still belongs to P4Objects
   MeterArray *direct_meters{nullptr};
+  bool shard_counters{false};
 };
 
 template <typename V>
@@ -357,6 +389,11 @@ class MatchUnitAbstract : public MatchUnitAbstract_ {
 
   MatchUnitLookup lookup(const Packet &pkt);
 
+  // same as lookup() for a batch of packets, results are appended to results;
+  // all the keys are built first and then looked up together
+  void lookup_batch(const std::vector<Packet *> &pkts,
+                    std::vector<MatchUnitLookup> *results);
+
   MatchErrorCode add_entry(const std::vector<MatchKeyParam> &match_key,
                            V value,  // by value for possible std::move
                            entry_handle_t *handle,
@@ -428,6 +465,11 @@ class MatchUnitAbstract : public MatchUnitAbstract_ {
 
   virtual MatchUnitLookup lookup_key(const ByteContainer &key) const = 0;
 
+  virtual void lookup_key_batch(const std::vector<ByteContainer> &keys,
+                                std::vector<MatchUnitLookup> *results) const {
+    for (const auto &key : keys) results->push_back(lookup_key(key));
+  }
+
   virtual void serialize_(std::ostream *out) const = 0;
   virtual void deserialize_(std::istream *in, const P4Objects &objs) = 0;
 };
@@ -480,6 +522,9 @@ class MatchUnitGeneric : public MatchUnitAbstract<V> {
 
   MatchUnitLookup lookup_key(const ByteContainer &key) const override;
 
+  void lookup_key_batch(const std::vector<ByteContainer> &keys,
+                        std::vector<MatchUnitLookup> *results) const override;
+
   void serialize_(std::ostream *out) const override;
   void deserialize_(std::istream *in, const P4Objects &objs) override;
 
@@ -41,6 +41,8 @@
 #include <string>
 #include <iosfwd>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 
 #include <cassert>
 
@@ -68,6 +70,12 @@ class Packet;
 //!
 //! Note that a Meter operates on either bytes or packets (not both, unlike a
 //! Counter).
+//!
+//! Executing a meter does not require any lock: the state of each token bucket
+//! is a single integer which is updated with a compare-and-swap. The buckets
+//! of a multi-rate meter are however updated one after the other, which means
+//! that concurrent packets may observe the state of different buckets at
+//! slightly different times.
 class Meter {
  public:
   using color_t = unsigned int;
@@ -99,8 +107,12 @@ class Meter {
   };
 
  public:
-  Meter(MeterType type, size_t rate_count)
-    : type(type), rates(rate_count) { }
+  Meter(MeterType type, size_t rate_count);
+
+  // std::atomic is not movable, so we need to define these ourselves; they
+  // must not be used concurrently with any other operation on the meters
+  Meter(Meter &&other) noexcept;
+  Meter &operator=(Meter &&other) noexcept;
 
   // the rate configs must be sorted from smaller rate to higher rate
   // in the 2 rate meter case: {CIR, PIR}
@@ -128,8 +140,7 @@ class Meter {
       MeterErrorCode rc = set_rate(idx++, *it);
       if (rc != SUCCESS) return rc;
     }
-    std::reverse(rates.begin(), rates.end());
-    configured = true;
+    configured.store(true, std::memory_order_release);
     return SUCCESS;
   }
 
@@ -160,6 +171,15 @@ class Meter {
   void serialize(std::ostream *out) const;
   void deserialize(std::istream *in);
 
+  //! By default, the current time is read from the system clock every time a
+  //! meter is executed. When \p resolution is not zero, a background thread
+  //! refreshes a shared timestamp every \p resolution instead, and meters use
+  //! that timestamp. Meters may then see up to \p resolution less time than
+  //! has actually elapsed, which means that the colors returned by meters may
+  //! lag behind the exact rates by that much time. This is equivalent to
+  //! calling Clock::set_resolution() for Clock::Consumer::METERS.
+  static void set_time_resolution(std::chrono::microseconds resolution);
+
  public:
   /* This is for testing purposes only, for more accurate tests */
   static void reset_global_clock();
@@ -170,16 +190,28 @@ class Meter {
   void unlock(UniqueLock &lock) const { lock.unlock(); }  // NOLINT
 
  private:
+  // The configuration is written by the control plane (with the mutex held)
+  // and read by execute() without any lock, hence the atomics.
   struct MeterRate {
     bool valid{};  // TODO(antonin): get rid of this?
-    double info_rate{};  // in bytes / packets per microsecond
-    size_t burst_size{};
-    size_t tokens{};
-    uint64_t tokens_last{};
+    std::atomic<double> info_rate{};  // in bytes / packets per microsecond
+    std::atomic<size_t> burst_size{};
+    // The tokens generated since init (i.e. the elapsed time multiplied by the
+    // rate) minus the tokens in the bucket, which is enough to represent the
+    // state of the bucket with a single integer: tokens are consumed by
+    // increasing this value, the bucket being full whenever the value is
+    // smaller than (tokens generated since init - burst_size).
+    std::atomic<int64_t> tokens_base{};
     color_t color{};
+
+    // returns false if there are not enough tokens in the bucket, in which
+    // case no token is consumed
+    bool consume(int64_t micros_since_init, int64_t input);
   };
 
  private:
+  // idx is the position of the rate in the configuration list, i.e. from
+  // smaller to higher rate
   MeterErrorCode set_rate(size_t idx, const rate_config_t &config);
 
  private:
@@ -189,8 +221,10 @@ class Meter {
   // MeterArray implementation. I don't think this will incur a performance hit
   std::unique_ptr<std::mutex> m_mutex{new std::mutex()};
   // mutable std::mutex m_mutex;
+  // from higher to smaller rate, in the order in which they are checked by
+  // execute()
   std::vector<MeterRate> rates;
-  bool configured{false};
+  std::atomic<bool> configured{false};
 };
 
 using meter_array_id_t = p4object_id_t;
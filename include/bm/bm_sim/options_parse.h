@@ -26,6 +26,7 @@
 #include <iosfwd>
 #include <string>
 #include <map>
+#include <vector>
 
 #include "device_id.h"
 #include "logger.h"
@@ -79,17 +80,37 @@ class OptionsParser {
   bool packet_in{false};
   std::string packet_in_addr{};
   std::string event_logger_addr{};
+  // 0 means that the event logger publishes each event synchronously
+  size_t nanolog_ring_size{0};
   std::string file_logger{};
   bool console_logging{false};
   // by default everything is logged
   Logger::LogLevel log_level{Logger::LogLevel::TRACE};
   // by default file logs are not "force-flushed" to disk
   bool log_flush{false};
+  // 0 means that messages are written by the thread which logs them
+  size_t log_async_queue_size{0};
+  std::vector<Logger::Subsystem> log_disabled_subsystems{};
   std::string notifications_addr{};
+  // replace shared memory rings even if they were not closed
+  bool shm_replace{false};
+  // permissions of the shared memory rings, only the owner can read them by
+  // default
+  unsigned int shm_mode{0600};
   bool debugger{false};
   std::string debugger_addr{};
   std::string state_file_path{};
   size_t dump_packet_data{0};
+  bool incremental_checksums{false};
+  size_t counter_shards{1};
+  size_t learn_dedup_cache_size{256};
+  // 0 means that pipelines do not have a flow cache
+  size_t flow_cache_size{0};
+  // 0 means that meters read the system clock for every packet
+  unsigned int meter_time_resolution_us{0};
+  // consumer name (see Clock::consumer_from_name) -> resolution in
+  // microseconds, applied after meter_time_resolution_us
+  std::map<std::string, unsigned int> clock_resolution_us{};
 };
 
 }  // namespace bm
@@ -218,6 +218,9 @@ class Packet final {
 
   const PacketBuffer &get_packet_buffer() const { return buffer; }
 
+  //! Time at which the packet was created, as returned by
+  //! Clock::get_millis() for Clock::Consumer::AGEING. It is used to update the
+  //! hit timestamp of match table entries.
   uint64_t get_ingress_ts_ms() const { return ingress_ts_ms; }
 
   // TODO(antonin): use references instead?
@@ -360,7 +363,6 @@ class Packet final {
 
   size_t truncated_length{std::numeric_limits<size_t>::max()};
 
-  clock::time_point ingress_ts{};
   uint64_t ingress_ts_ms{};
 
   std::unique_ptr<PHV> phv;
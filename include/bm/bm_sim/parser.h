@@ -23,6 +23,7 @@
 #ifndef BM_BM_SIM_PARSER_H_
 #define BM_BM_SIM_PARSER_H_
 
+#include <memory>
 #include <utility>
 #include <string>
 #include <vector>
@@ -107,6 +108,8 @@ class ParseSwitchKeyBuilder {
   void operator()(const PHV &phv, const char *data, ByteContainer *key) const;
 
  private:
+  friend class ParserAutomaton;
+
   struct Entry {
     enum {FIELD, LOOKAHEAD, STACK_FIELD, UNION_STACK_FIELD} tag{};
     // I made sure ParserLookAhead was POD data so that it is easy to use in the
@@ -204,6 +207,15 @@ class ParseSwitchCaseIface {
   virtual bool match(const ByteContainer &input,
                      const ParseState **state) const = 0;
 
+  // Used by Parser::compile(). If this case only matches a set of exact keys,
+  // appends them, along with the corresponding next states, to \p cases and
+  // returns true. Returns false otherwise.
+  virtual bool get_exact_cases(
+      std::vector<std::pair<ByteContainer, const ParseState *> > *cases) const {
+    (void) cases;
+    return false;
+  }
+
   static std::unique_ptr<ParseSwitchCaseIface>
   make_case(const ByteContainer &key, const ParseState *next_state);
 
@@ -221,6 +233,9 @@ class ParseSwitchCaseIface {
                            const ParseState *next_state);
 };
 
+class ParseSwitchCaseExactTable;
+class ParserAutomaton;
+
 class ParseState : public NamedP4Object {
  public:
   ParseState(const std::string &name, p4object_id_t id);
@@ -298,6 +313,8 @@ class ParseState : public NamedP4Object {
                                size_t *bytes_parsed) const;
 
  private:
+  friend class ParserAutomaton;
+
   const ParseState *find_next_state(Packet *pkt, const char *data,
                                     size_t *bytes_parsed) const;
 
@@ -306,6 +323,10 @@ class ParseState : public NamedP4Object {
   bool has_switch;
   ParseSwitchKeyBuilder key_builder{};
   std::vector<std::unique_ptr<ParseSwitchCaseIface> > parser_switch{};
+  // consecutive exact cases are grouped in a single table; this points to the
+  // table at the end of parser_switch, if any, to which new exact cases are
+  // added
+  ParseSwitchCaseExactTable *exact_table_tail{nullptr};
   const ParseState *default_next_state{nullptr};
 };
 
@@ -319,6 +340,20 @@ class Parser : public NamedP4Object {
 
   void add_checksum(const Checksum *checksum);
 
+  //! Lowers the parse graph reachable from the initial state into a flat,
+  //! table-driven automaton which parse() then uses instead of walking the
+  //! graph. States which only extract fixed-size headers and select the next
+  //! state with exact cases on at most 8 bytes of key are compiled: their
+  //! headers are extracted with a single bounds check, the key is read
+  //! directly from the packet data at precomputed offsets and the transition
+  //! is a single hash table lookup. All other states are still run by the
+  //! interpreter. Parsing results, errors and logged events are the same as
+  //! without compilation. Must be called once the parse graph is complete.
+  void compile(const PHVFactory &phv_factory);
+
+  //! Returns true if compile() was called successfully
+  bool is_compiled() const;
+
   //! Extracts Packet headers as specified by the parse graph. When the parser
   //! extracts a header to the PHV, the header is marked as valid. After parsing
   //! a packet, you can send it to the appropriate match-action Pipeline for
@@ -326,6 +361,11 @@ class Parser : public NamedP4Object {
   //! send it to another Parser for deeper parsing.
   void parse(Packet *pkt) const;
 
+  //! Parses each packet in \p pkts in turn. This is equivalent to calling
+  //! parse() for each packet; it exists so that targets which process packets
+  //! in batches can use the same structure for every stage.
+  void parse_batch(const std::vector<Packet *> &pkts) const;
+
   //! Deleted copy constructor
   Parser(const Parser &other) = delete;
   //! Deleted copy assignment operator
@@ -343,6 +383,7 @@ class Parser : public NamedP4Object {
   const ErrorCodeMap *error_codes;
   const ErrorCode no_error;
   std::vector<const Checksum *> checksums{};
+  std::shared_ptr<const ParserAutomaton> automaton{nullptr};
 };
 
 }  // namespace bm
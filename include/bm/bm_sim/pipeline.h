@@ -23,9 +23,12 @@
 #ifndef BM_BM_SIM_PIPELINE_H_
 #define BM_BM_SIM_PIPELINE_H_
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "control_flow.h"
+#include "flow_cache.h"
 #include "named_p4object.h"
 
 namespace bm {
@@ -35,9 +38,10 @@ namespace bm {
 //! tables and conditions.
 class Pipeline : public NamedP4Object {
  public:
+  //! If set_default_flow_cache_size() was called with a non-zero value, the
+  //! pipeline is created with a flow cache of that size.
   Pipeline(const std::string &name, p4object_id_t id,
-           ControlFlowNode *first_node)
-    : NamedP4Object(name, id), first_node(first_node) {}
+           ControlFlowNode *first_node);
 
   //! Sends the \p pkt through the correct match-action tables and
   //! condiitons. Each step is determined based on the result of the previous
@@ -45,6 +49,32 @@ class Pipeline : public NamedP4Object {
   //! flow graph.
   void apply(Packet *pkt);
 
+  //! Sends a batch of packets through the pipeline. Packets which are at the
+  //! same node of the control flow graph are processed together, which lets
+  //! match-action tables perform all their lookups before executing any
+  //! action. Each packet goes through the same nodes as with apply(), but when
+  //! packets take different paths, the relative order in which they visit
+  //! stateful objects (e.g. registers) may differ from calling apply() on each
+  //! packet in turn. If a flow cache is enabled, this is equivalent to calling
+  //! apply() for each packet.
+  void apply_batch(const std::vector<Packet *> &pkts);
+
+  //! Enables a megaflow cache (see bm::FlowCache) for this pipeline, which can
+  //! hold up to \p max_entries flows. This is not thread-safe and must be
+  //! called before packets are sent through the pipeline. Packets which hit
+  //! the cache do not generate any per-table log message or event.
+  void enable_flow_cache(size_t max_entries);
+
+  //! Returns the flow cache for this pipeline, or `nullptr` if
+  //! enable_flow_cache() was not called.
+  FlowCache *get_flow_cache() const { return flow_cache.get(); }
+
+  //! Sets the size of the flow cache enabled for every Pipeline created after
+  //! this call, including the pipelines of a JSON configuration swapped in at
+  //! runtime. The default is 0, which means that pipelines are created without
+  //! a flow cache.
+  static void set_default_flow_cache_size(size_t max_entries);
+
   //! Deleted copy constructor
   Pipeline(const Pipeline &other) = delete;
   //! Deleted copy assignment operator
@@ -56,7 +86,12 @@ class Pipeline : public NamedP4Object {
   Pipeline &operator=(Pipeline &&other) /*noexcept*/ = default;
 
  private:
+  void apply_nodes(Packet *pkt, FlowCache::Recorder *recorder);
+
   ControlFlowNode *first_node;
+  std::unique_ptr<FlowCache> flow_cache{nullptr};
+
+  static size_t default_flow_cache_size;
 };
 
 }  // namespace bm
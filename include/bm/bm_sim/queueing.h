@@ -38,6 +38,8 @@
 #include <chrono>
 #include <algorithm>  // for std::max
 
+#include "clock.h"
+
 namespace bm {
 
 //! One of the most basic queueing block possible. Lets you choose (at runtime)
@@ -220,7 +222,7 @@ class QueueingLogicRL {
       : nb_queues(nb_queues), nb_workers(nb_workers),
         queues_info(nb_queues), workers_info(nb_workers),
         map_to_worker(std::move(map_to_worker)) {
-    auto now = clock::now();
+    auto now = Clock::now(Clock::Consumer::QUEUEING);
     for (auto &q_info : queues_info) {
       q_info.capacity = capacity;
       q_info.last_sent = now;
@@ -330,9 +332,11 @@ class QueueingLogicRL {
 
  private:
   using ticks = std::chrono::nanoseconds;
-  // clock choice? switch to steady if observing re-ordering
-  // using clock = std::chrono::steady_clock;
-  using clock = std::chrono::high_resolution_clock;
+  // the departure times of elements are computed with Clock, which can be
+  // configured to return a cached time for Clock::Consumer::QUEUEING; however
+  // the time is always read exactly in pop_back(), to be consistent with the
+  // condition variable timeouts
+  using clock = Clock::clock;
 
   struct QE {
     // QE(T e, size_t queue_id, const clock::time_point &send, size_t id)
@@ -375,7 +379,8 @@ class QueueingLogicRL {
   };
 
   clock::time_point get_next_tp(const QueueInfo &q_info) {
-    return std::max(clock::now(), q_info.last_sent + q_info.pkt_delay_ticks);
+    return std::max(Clock::now(Clock::Consumer::QUEUEING),
+                    q_info.last_sent + q_info.pkt_delay_ticks);
   }
 
   size_t nb_queues;
@@ -420,7 +425,7 @@ class QueueingLogicPriRL {
         workers_info(nb_workers),
         map_to_worker(std::move(map_to_worker)),
         nb_priorities(nb_priorities) {
-    auto now = clock::now();
+    auto now = Clock::now(Clock::Consumer::QUEUEING);
     for (size_t i = 0; i < nb_queues; i++) {
       QueueInfoPri v = {0, capacity, 0, ticks::zero(), now};
       queues_info.emplace_back(nb_priorities, v);
@@ -589,9 +594,11 @@ class QueueingLogicPriRL {
 
  private:
   using ticks = std::chrono::nanoseconds;
-  // clock choice? switch to steady if observing re-ordering
-  // using clock = std::chrono::steady_clock;
-  using clock = std::chrono::high_resolution_clock;
+  // the departure times of elements are computed with Clock, which can be
+  // configured to return a cached time for Clock::Consumer::QUEUEING; however
+  // the time is always read exactly in pop_back(), to be consistent with the
+  // condition variable timeouts
+  using clock = Clock::clock;
 
   struct QE {
     QE(T e, size_t queue_id, const clock::time_point &send)
@@ -633,7 +640,7 @@ class QueueingLogicPriRL {
   };
 
   clock::time_point get_next_tp(const QueueInfoPri &q_info_pri) {
-    return std::max(clock::now(),
+    return std::max(Clock::now(Clock::Consumer::QUEUEING),
                     q_info_pri.last_sent + q_info_pri.pkt_delay_ticks);
   }
 
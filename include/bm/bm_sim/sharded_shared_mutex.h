@@ -0,0 +1,121 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! @file sharded_shared_mutex.h
+
+#ifndef BM_BM_SIM_SHARDED_SHARED_MUTEX_H_
+#define BM_BM_SIM_SHARDED_SHARED_MUTEX_H_
+
+// shared_mutex will only be available in C++-14, so for now I'm using boost
+#include <boost/thread/shared_mutex.hpp>
+
+#include <atomic>
+#include <mutex>
+
+#include <cstddef>
+
+#include "thread_index.h"
+
+namespace bm {
+
+//! A reader-writer mutex optimized for read-mostly objects (e.g. match tables,
+//! which are read for every packet but only modified by the control plane).
+//! Each reader thread announces itself in its own cache line (one of
+//! `nb_slots` slots), so readers never write to a cache line shared with other
+//! reader threads, unlike with `boost::shared_mutex`. A writer raises a flag
+//! and waits for all the slots to drain; in the meantime new readers back off,
+//! and if the writer holds the mutex for more than a few scheduling quanta,
+//! they block until it releases it instead of spinning.
+//! Like `boost::shared_mutex`, this mutex is not recursive, and a thread
+//! holding it in shared mode must not try to acquire it again in shared mode.
+//! It satisfies the SharedLockable concept and can be used with
+//! `boost::shared_lock` and `boost::unique_lock`.
+class ShardedSharedMutex {
+ public:
+  static constexpr size_t nb_slots = 32;
+
+  ShardedSharedMutex() = default;
+
+  ShardedSharedMutex(const ShardedSharedMutex &other) = delete;
+  ShardedSharedMutex &operator=(const ShardedSharedMutex &other) = delete;
+
+  void lock_shared() {
+    auto &readers = slots[get_slot()].readers;
+    while (true) {
+      readers.fetch_add(1, std::memory_order_seq_cst);
+      if (!writer.load(std::memory_order_seq_cst)) return;
+      readers.fetch_sub(1, std::memory_order_release);
+      wait_for_writer();
+    }
+  }
+
+  bool try_lock_shared() {
+    auto &readers = slots[get_slot()].readers;
+    readers.fetch_add(1, std::memory_order_seq_cst);
+    if (!writer.load(std::memory_order_seq_cst)) return true;
+    readers.fetch_sub(1, std::memory_order_release);
+    return false;
+  }
+
+  void unlock_shared() {
+    slots[get_slot()].readers.fetch_sub(1, std::memory_order_release);
+  }
+
+  void lock();
+
+  bool try_lock();
+
+  void unlock();
+
+ private:
+  // a slot occupies a full cache line, the padding ensures that 2 counters
+  // never share a line, even if the object itself is not aligned
+  struct Slot {
+    std::atomic<int> readers{0};
+    char padding[64 - sizeof(std::atomic<int>)];
+  };
+
+  // slots are assigned to threads in a round-robin fashion
+  static size_t get_slot() {
+    return thread_index() % nb_slots;
+  }
+
+  void wait_for_writer();
+
+  void wait_for_readers() const;
+
+  // number of times a reader yields before blocking on w_mutex
+  static constexpr int reader_spin_iterations = 64;
+
+  Slot slots[nb_slots];
+  std::atomic<bool> writer{false};
+  // serializes writers; held for the whole write critical section, which is
+  // what lets readers block while a writer is active
+  std::mutex w_mutex{};
+};
+
+//! The mutex type used to protect match tables and action profiles. Unless
+//! bmv2 is configured with `--disable-sharded-table-locks`, this is
+//! ShardedSharedMutex. Otherwise it is `boost::shared_mutex`, which can be
+//! useful for comparison.
+#ifdef BM_LEGACY_TABLE_LOCKS
+using TableSharedMutex = boost::shared_mutex;
+#else
+using TableSharedMutex = ShardedSharedMutex;
+#endif
+
+}  // namespace bm
+
+#endif  // BM_BM_SIM_SHARDED_SHARED_MUTEX_H_
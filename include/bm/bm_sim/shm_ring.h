@@ -0,0 +1,368 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! @file shm_ring.h
+//! This file contains bm::ShmRing, a single-producer single-consumer message
+//! ring in shared memory. It is used by the shared memory transport (see
+//! TransportIface::make_shm()) and by the clients in bm_apps. Because these
+//! clients do not link against the bm_sim library, this class is header-only.
+
+#ifndef BM_BM_SIM_SHM_RING_H_
+#define BM_BM_SIM_SHM_RING_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <cstdint>
+#include <cstring>
+
+namespace bm {
+
+//! A ring of variable-size messages, stored in a file under /dev/shm so that
+//! it can be mapped by a consumer running in a different process on the same
+//! host. The producer creates the ring with create(), the consumer maps it
+//! with attach(). There can be only one producer thread and one consumer
+//! thread at a time; callers which need more have to serialize their calls.
+//!
+//! When the consumer falls behind and the ring is full, new messages are
+//! dropped (and counted, see get_dropped()), like with a nanomsg pub socket:
+//! the producer never blocks. The consumer spins for a little while when the
+//! ring is empty, then sleeps (on a futex on Linux) until a new message is
+//! pushed.
+class ShmRing {
+ public:
+  struct Buf {
+    const char *buf;
+    size_t len;
+  };
+
+  //! Values returned by pop() when no message was popped
+  enum PopStatus : int {
+    //! no message was pushed before the timeout expired
+    POP_TIMEOUT = -1,
+    //! the ring was closed by its producer and all its messages were popped
+    POP_CLOSED = -2,
+    //! the next message had an invalid size (the ring is corrupted); it was
+    //! dropped, together with all the messages pushed after it
+    POP_INVALID = -3
+  };
+
+  //! Default permissions of the file backing a ring, see create()
+  static constexpr mode_t default_mode = 0600;
+
+  //! Returns true iff \p addr refers to a shared memory ring rather than to a
+  //! nanomsg socket, i.e. starts with `shm://` (e.g.
+  //! `shm://bmv2-0-notifications`), in which case the name of the ring is
+  //! copied to \p name
+  static bool parse_addr(const std::string &addr, std::string *name) {
+    const std::string prefix("shm://");
+    if (addr.compare(0, prefix.size(), prefix) != 0) return false;
+    *name = addr.substr(prefix.size());
+    return true;
+  }
+
+  static std::string get_path(const std::string &name) {
+    return std::string("/dev/shm/") + name;
+  }
+
+  //! Creates a new ring with the given name, with \p capacity bytes of storage
+  //! (rounded up to a power of 2). An existing ring with the same name which
+  //! was closed by its producer is replaced. If the existing ring was not
+  //! closed, it may still be in use by another producer (or its producer may
+  //! have crashed): it is only replaced if \p replace_open is true, in which
+  //! case the consumers attached to it are told to re-attach, otherwise this
+  //! function fails. The backing file is always created anew (never through a
+  //! symbolic link), with permissions \p mode, which determine which users
+  //! can attach to the ring. Returns nullptr in case of error.
+  static std::unique_ptr<ShmRing> create(const std::string &name,
+                                         size_t capacity,
+                                         bool replace_open = false,
+                                         mode_t mode = default_mode) {
+    size_t cap = 4096;
+    while (cap < capacity) cap <<= 1;
+    const std::string path = get_path(name);
+    if (!replace_existing(path, replace_open)) return nullptr;
+    // if someone re-creates the file after replace_existing() removed it, we
+    // fail instead of using their file
+    int fd = ::open(path.c_str(),
+                    O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, mode);
+    if (fd < 0) return nullptr;
+    const size_t size = sizeof(Header) + cap;
+    // the mode passed to open() is subject to the umask
+    if (::fchmod(fd, mode) != 0 ||
+        ::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      ::unlink(path.c_str());
+      ::close(fd);
+      return nullptr;
+    }
+    void *mem = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                       0);
+    ::close(fd);
+    if (mem == MAP_FAILED) return nullptr;
+    // the file is zero-filled, which is a valid initial state for all the
+    // atomic variables; the magic number is written last
+    auto hdr = static_cast<Header *>(mem);
+    hdr->capacity = cap;
+    hdr->magic.store(magic_number, std::memory_order_release);
+    return std::unique_ptr<ShmRing>(new ShmRing(mem, size, true));
+  }
+
+  //! Maps the ring with the given name, returns nullptr if it does not exist
+  //! (yet).
+  static std::unique_ptr<ShmRing> attach(const std::string &name) {
+    return map_existing(get_path(name), false);
+  }
+
+  //! The producer marks the ring as closed, which lets the consumer know that
+  //! no more messages will be pushed to it.
+  ~ShmRing() {
+    if (producer) {
+      hdr->closed.store(1, std::memory_order_seq_cst);
+      notify();
+    }
+    ::munmap(hdr, size);
+  }
+
+  //! Pushes one message made of the concatenation of the \p nb_bufs buffers
+  //! in \p bufs. Returns false if the message was dropped because there was
+  //! not enough room in the ring.
+  bool push(const Buf *bufs, size_t nb_bufs) {
+    size_t len = 0;
+    for (size_t i = 0; i < nb_bufs; i++) len += bufs[i].len;
+    const uint64_t cap = capacity;
+    const uint64_t record_size = sizeof(RecordHdr) + round_up(len);
+    const uint64_t head = hdr->head.load(std::memory_order_relaxed);
+    const uint64_t tail = hdr->tail.load(std::memory_order_acquire);
+    uint64_t offset = head & (cap - 1);
+    // records are never split, we skip the end of the ring if needed
+    const uint64_t skip = (offset + record_size > cap) ? (cap - offset) : 0;
+    if (record_size > cap / 2 || head + skip + record_size - tail > cap) {
+      hdr->dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (skip > 0) {
+      write_record_hdr(offset, RecordHdr{0, wrap_flag});
+      offset = 0;
+    }
+    write_record_hdr(offset, RecordHdr{static_cast<uint32_t>(len), 0});
+    char *dst = data + offset + sizeof(RecordHdr);
+    for (size_t i = 0; i < nb_bufs; i++) {
+      std::memcpy(dst, bufs[i].buf, bufs[i].len);
+      dst += bufs[i].len;
+    }
+    hdr->head.store(head + skip + record_size, std::memory_order_release);
+    notify();
+    return true;
+  }
+
+  bool push(std::initializer_list<Buf> bufs) {
+    return push(bufs.begin(), bufs.size());
+  }
+
+  //! Pops the next message into \p dst, waiting up to \p timeout for one to be
+  //! available. Messages larger than \p max_len are truncated. Returns the
+  //! size of the message (before truncation), which can be 0, or one of the
+  //! negative PopStatus values if no message was popped.
+  int pop(char *dst, size_t max_len, std::chrono::milliseconds timeout) {
+    // the shared memory may be written by another process, so every value
+    // read from it is checked before being used
+    const uint64_t cap = capacity;
+    while (true) {
+      const uint64_t tail = hdr->tail.load(std::memory_order_relaxed);
+      if (!wait_for_data(tail, timeout)) {
+        return hdr->closed.load(std::memory_order_acquire) ?
+            POP_CLOSED : POP_TIMEOUT;
+      }
+      const uint64_t offset = tail & (cap - 1);
+      RecordHdr record;
+      std::memcpy(&record, data + offset, sizeof(record));
+      if (record.flags & wrap_flag) {
+        hdr->tail.store(tail + (cap - offset), std::memory_order_release);
+        continue;
+      }
+      if (record.len > cap - offset - sizeof(RecordHdr)) {
+        hdr->tail.store(hdr->head.load(std::memory_order_acquire),
+                        std::memory_order_release);
+        return POP_INVALID;
+      }
+      std::memcpy(dst, data + offset + sizeof(RecordHdr),
+                  (record.len < max_len) ? record.len : max_len);
+      hdr->tail.store(tail + sizeof(RecordHdr) + round_up(record.len),
+                      std::memory_order_release);
+      return static_cast<int>(record.len);
+    }
+  }
+
+  //! Number of messages dropped because the ring was full
+  uint64_t get_dropped() const {
+    return hdr->dropped.load(std::memory_order_relaxed);
+  }
+
+  bool is_closed() const {
+    return hdr->closed.load(std::memory_order_acquire) != 0;
+  }
+
+  size_t get_capacity() const { return capacity; }
+
+  ShmRing(const ShmRing &other) = delete;
+  ShmRing &operator=(const ShmRing &other) = delete;
+
+ private:
+  static constexpr uint64_t magic_number = 0x626d76325f726e67;  // "bmv2_rng"
+  static constexpr uint32_t wrap_flag = 1;
+  static constexpr int spin_iterations = 1000;
+
+  // head and tail are byte offsets which are never wrapped, each of the
+  // variables written by a different side lives in its own cache line
+  struct Header {
+    std::atomic<uint64_t> magic;
+    uint64_t capacity;
+    std::atomic<uint32_t> closed;
+    alignas(64) std::atomic<uint64_t> head;
+    // futex word, incremented every time the consumer needs to be woken up
+    std::atomic<uint32_t> seq;
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> consumer_waiting;
+    alignas(64) std::atomic<uint64_t> dropped;
+  };
+
+  struct RecordHdr {
+    uint32_t len;
+    uint32_t flags;
+  };
+
+  static_assert(sizeof(Header) % 64 == 0, "Invalid ShmRing header size");
+  static_assert(sizeof(RecordHdr) == 8, "Invalid ShmRing record header size");
+
+  ShmRing(void *mem, size_t size, bool producer)
+      : hdr(static_cast<Header *>(mem)),
+        data(static_cast<char *>(mem) + sizeof(Header)),
+        size(size), capacity(size - sizeof(Header)), producer(producer) { }
+
+  static uint64_t round_up(uint64_t len) { return (len + 7) & ~uint64_t(7); }
+
+  static std::unique_ptr<ShmRing> map_existing(const std::string &path,
+                                               bool producer) {
+    int fd = ::open(path.c_str(), O_RDWR | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) <= sizeof(Header)) {
+      ::close(fd);
+      return nullptr;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    void *mem = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                       0);
+    ::close(fd);
+    if (mem == MAP_FAILED) return nullptr;
+    auto hdr = static_cast<Header *>(mem);
+    const uint64_t cap = size - sizeof(Header);
+    if (hdr->magic.load(std::memory_order_acquire) != magic_number ||
+        hdr->capacity != cap || (cap & (cap - 1)) != 0) {
+      ::munmap(mem, size);
+      return nullptr;
+    }
+    return std::unique_ptr<ShmRing>(new ShmRing(mem, size, producer));
+  }
+
+  // closes the ring currently at this path, if any (through the destructor),
+  // so that its consumer notices that it needs to re-attach, then removes the
+  // file; returns false if the ring is still open and replace_open is false
+  static bool replace_existing(const std::string &path, bool replace_open) {
+    auto existing = map_existing(path, true);
+    if (existing && !existing->is_closed() && !replace_open) {
+      // we are not the producer, the destructor must not close the ring
+      existing->producer = false;
+      return false;
+    }
+    existing.reset();
+    ::unlink(path.c_str());
+    return true;
+  }
+
+  void write_record_hdr(uint64_t offset, const RecordHdr &record) {
+    std::memcpy(data + offset, &record, sizeof(record));
+  }
+
+  void notify() {
+    hdr->seq.fetch_add(1, std::memory_order_seq_cst);
+    if (hdr->consumer_waiting.load(std::memory_order_seq_cst)) {
+#ifdef __linux__
+      ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&hdr->seq), FUTEX_WAKE,
+                1, nullptr, nullptr, 0);
+#endif
+    }
+  }
+
+  bool has_data(uint64_t tail) const {
+    return hdr->head.load(std::memory_order_acquire) != tail;
+  }
+
+  bool wait_for_data(uint64_t tail, std::chrono::milliseconds timeout) {
+    for (int i = 0; i < spin_iterations; i++) {
+      if (has_data(tail)) return true;
+    }
+    using clock = std::chrono::steady_clock;
+    const auto deadline = clock::now() + timeout;
+    while (true) {
+      hdr->consumer_waiting.store(1, std::memory_order_seq_cst);
+      const uint32_t seq = hdr->seq.load(std::memory_order_seq_cst);
+      if (has_data(tail) || hdr->closed.load(std::memory_order_acquire)) break;
+      const auto now = clock::now();
+      if (now >= deadline) break;
+#ifdef __linux__
+      const auto remaining = std::chrono::duration_cast<
+        std::chrono::nanoseconds>(deadline - now).count();
+      struct timespec ts;
+      ts.tv_sec = static_cast<time_t>(remaining / 1000000000);
+      ts.tv_nsec = static_cast<long>(remaining % 1000000000);  // NOLINT
+      ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&hdr->seq), FUTEX_WAIT,
+                seq, &ts, nullptr, 0);
+#else
+      (void) seq;
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+#endif
+    }
+    hdr->consumer_waiting.store(0, std::memory_order_relaxed);
+    return has_data(tail);
+  }
+
+  Header *hdr;
+  char *data;
+  size_t size;
+  // never read from the shared memory after the ring is mapped
+  size_t capacity;
+  bool producer;
+};
+
+}  // namespace bm
+
+#endif  // BM_BM_SIM_SHM_RING_H_
@@ -27,7 +27,7 @@
 //! class register_write
 //!   : public ActionPrimitive<RegisterArray &, const Data &, const Data &> {
 //!   void operator ()(RegisterArray &dst, const Data &idx, const Data &src) {
-//!     dst[idx.get_uint()].set(src);
+//!     dst.write(idx.get_uint(), src);
 //!   }
 //! };
 //! @endcode
@@ -39,6 +39,7 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 #include <mutex>
 #include <unordered_set>
 #include <functional>
@@ -85,10 +86,31 @@ using register_array_id_t = p4object_id_t;
 //! class register_write
 //!   : public ActionPrimitive<RegisterArray &, const Data &, const Data &> {
 //!   void operator ()(RegisterArray &dst, const Data &idx, const Data &src) {
-//!     dst[idx.get_uint()].set(src);
+//!     dst.write(idx.get_uint(), src);
 //!   }
 //! };
 //! @endcode
+//!
+//! By default, an action is given exclusive access to all the register arrays
+//! it references for its whole duration. When each register array referenced
+//! by an action is only referenced once, as the RegisterArray parameter of a
+//! primitive which overrides ActionPrimitive_::uses_striped_register_accesses()
+//! to return true, the arrays are not locked for the action; instead the
+//! primitive's read() or write() call only locks the stripe of the array
+//! containing the accessed register, so that packets accessing different
+//! indices can be processed concurrently. Because a striped access does not
+//! take part in the ordered acquisition of RegisterSync, it is never made
+//! while the action holds another register array lock.
+//!
+//! An action which only references one register array, through several such
+//! primitives which all access the same index (e.g. a `register_read`
+//! followed by a `register_write`, to increment a register), locks the stripe
+//! containing that index for its whole duration, so the read-modify-write
+//! stays atomic.
+//!
+//! Exclusive access to the array (unique_lock(), RegisterSync) takes a plain
+//! mutex, and, only for the arrays for which striped accesses were enabled
+//! (see enable_striped_accesses()), all the stripes.
 class RegisterArray : public NamedP4Object {
   friend class RegisterSync;
   friend class Register;
@@ -97,10 +119,26 @@ class RegisterArray : public NamedP4Object {
   using iterator = std::vector<Register>::iterator;
   using const_iterator = std::vector<Register>::const_iterator;
 
-  using UniqueLock = std::unique_lock<std::mutex>;
+  //! The mutex which gives exclusive access to the array, see unique_lock().
+  class ExclusiveMutex {
+   public:
+    explicit ExclusiveMutex(const RegisterArray *register_array)
+        : register_array(register_array) { }
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+   private:
+    const RegisterArray *register_array;
+  };
+
+  using UniqueLock = std::unique_lock<ExclusiveMutex>;
 
   //! Used to notify listeners that a write occurred in the array at \p idx. You
   //! can register your own notifier function by calling register_notifier().
+  //! Writes to different stripes of the array can happen concurrently, so
+  //! notifiers may be called concurrently from different threads.
   using Notifier = std::function<void(size_t idx)>;
 
   RegisterArray(const std::string &name, p4object_id_t id,
@@ -147,8 +185,23 @@ class RegisterArray : public NamedP4Object {
   //! includes)
   size_t size() const { return registers.size(); }
 
+  //! Copy the value of the register at position \p idx to \p dst. Unless the
+  //! calling thread already has exclusive access to the array (e.g. because
+  //! the array is locked for the action being executed), only the stripe
+  //! containing \p idx is locked. Asserts if bad \p idx.
+  void read(size_t idx, Data *dst) const;
+
+  //! Set the value of the register at position \p idx to \p src, with the same
+  //! locking as read(). Asserts if bad \p idx.
+  void write(size_t idx, const Data &src);
+
   void reset_state();
 
+  //! Called by ActionFn when some actions access this array through striped
+  //! accesses; from then on, exclusive access to the array also locks all the
+  //! stripes. Must be called before packets are processed.
+  void enable_striped_accesses();
+
   //! Register your own notifier function. Every time a write operation is
   //! performed on the register array, your notifier will be called, with the
   //! index at which the write happened as an argument. This method is not
@@ -160,19 +213,72 @@ class RegisterArray : public NamedP4Object {
   //! never necessary to call this method in a primitive action, since when an
   //! action is executed, it is guaranteed exclusive access to all the register
   //! arrays it reads or writes.
-  UniqueLock unique_lock() const { return UniqueLock(m_mutex); }
+  UniqueLock unique_lock() const { return UniqueLock(x_mutex); }
   // NOLINTNEXTLINE(runtime/references)
   void unlock(UniqueLock &lock) const { lock.unlock(); }
 
  private:
+  // a stripe occupies a full cache line, so that threads locking different
+  // stripes do not contend on the same line
+  struct Stripe {
+    std::mutex mutex{};
+    char padding[64 - sizeof(std::mutex)];
+  };
+
+  static constexpr size_t max_stripes = 64;
+
   void notify(const Register &reg) const;
 
+  std::mutex &get_stripe(size_t idx) const {
+    return stripes[idx & (nb_stripes - 1)].mutex;
+  }
+
+  std::mutex &get_access_mutex(size_t idx) const;
+
   std::vector<Register> registers{};
+  // held by unique_lock() and by the actions / parse states which reference
+  // the array, and by read() and write() if the array has no striped accesses
   mutable std::mutex m_mutex{};
+  mutable ExclusiveMutex x_mutex{this};
+  bool striped_accesses{false};
+  size_t nb_stripes{1};
+  std::unique_ptr<Stripe[]> stripes{nullptr};
   int bitwidth{};
   std::vector<Notifier> notifiers{};
 };
 
+// defined here so that exclusive access to an array without striped accesses
+// costs the same as locking a plain mutex
+inline void
+RegisterArray::ExclusiveMutex::lock() {
+  register_array->m_mutex.lock();
+  if (!register_array->striped_accesses) return;
+  for (size_t i = 0; i < register_array->nb_stripes; i++)
+    register_array->stripes[i].mutex.lock();
+}
+
+inline bool
+RegisterArray::ExclusiveMutex::try_lock() {
+  if (!register_array->m_mutex.try_lock()) return false;
+  if (!register_array->striped_accesses) return true;
+  for (size_t i = 0; i < register_array->nb_stripes; i++) {
+    if (register_array->stripes[i].mutex.try_lock()) continue;
+    while (i-- > 0) register_array->stripes[i].mutex.unlock();
+    register_array->m_mutex.unlock();
+    return false;
+  }
+  return true;
+}
+
+inline void
+RegisterArray::ExclusiveMutex::unlock() {
+  if (register_array->striped_accesses) {
+    for (size_t i = register_array->nb_stripes; i-- > 0;)
+      register_array->stripes[i].mutex.unlock();
+  }
+  register_array->m_mutex.unlock();
+}
+
 
 // This class was added to provide some measure of concurrency support for
 // register accesses. Every time an action is executed, this action is given
@@ -186,24 +292,58 @@ class RegisterSync {
   using LockVector = std::vector<
     Lock, ::detail::short_alloc<Lock, NumLocks * sizeof(Lock), alignof(Lock)> >;
 
+  // the RegisterLocks objects alive in a thread form a stack, which is used by
+  // RegisterArray::read() and RegisterArray::write() to determine whether the
+  // thread already has exclusive access to the array
   struct RegisterLocks {
+    RegisterLocks() : prev(current) { current = this; }
+    ~RegisterLocks() { current = prev; }
+
+    RegisterLocks(const RegisterLocks &other) = delete;
+    RegisterLocks &operator=(const RegisterLocks &other) = delete;
+
     LockVector<>::allocator_type::arena_type a;
     LockVector<> v{a};
+    const RegisterSync *sync{nullptr};
+    // the array whose stripe is held, see lock_stripe()
+    const RegisterArray *striped_array{nullptr};
+    std::unique_lock<std::mutex> stripe_lock{};
+    RegisterLocks *prev;
   };
 
   void add_register_array(const RegisterArray *register_array);
 
+  void remove_register_array(const RegisterArray *register_array);
+
+  bool has_register_array(const RegisterArray *register_array) const;
+
+  size_t size() const { return register_arrays.size(); }
+
   void merge_from(const RegisterSync &other);
 
   // tried NRVO, but RegisterLocks not movable
   void lock(RegisterLocks *RL) const {
+    RL->sync = this;
     for (auto m : mutexes) RL->v.emplace_back(*m, std::defer_lock);
     boost::lock(RL->v.begin(), RL->v.end());
   }
 
+  // locks the stripe of register_array which contains idx, until RL is
+  // destroyed; used by the actions which access a single register several
+  // times
+  static void lock_stripe(const RegisterArray *register_array, size_t idx,
+                          RegisterLocks *RL);
+
+  // returns true if the calling thread has exclusive access to the array
+  // through a RegisterSync, or holds the stripe of the array through
+  // lock_stripe() (in which case it only accesses registers of that stripe)
+  static bool is_locked_by_thread(const RegisterArray *register_array);
+
  private:
-  mutable std::vector<std::mutex *> mutexes{};
+  mutable std::vector<RegisterArray::ExclusiveMutex *> mutexes{};
   std::unordered_set<const RegisterArray *> register_arrays{};
+
+  static thread_local RegisterLocks *current;
 };
 
 }  // namespace bm
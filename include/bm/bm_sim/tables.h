@@ -23,6 +23,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "control_flow.h"
 #include "match_tables.h"
@@ -52,6 +53,14 @@ class MatchActionTable : public ControlFlowNode {
 
   const ControlFlowNode *operator()(Packet *pkt) const override;
 
+  void apply_batch(const std::vector<Packet *> &pkts,
+                   std::vector<const ControlFlowNode *> *next_nodes)
+      const override;
+
+  bool get_flow_cache_fields(FlowCacheFields *fields) const override {
+    return match_table->get_flow_cache_fields(fields);
+  }
+
   MatchTableAbstract *get_match_table() { return match_table.get(); }
 
  public:
@@ -0,0 +1,40 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! @file thread_index.h
+
+#ifndef BM_BM_SIM_THREAD_INDEX_H_
+#define BM_BM_SIM_THREAD_INDEX_H_
+
+#include <atomic>
+
+#include <cstddef>
+
+namespace bm {
+
+//! Returns a small integer identifying the calling thread. Indices are handed
+//! out in increasing order (0, 1, 2, ...), the first time each thread calls
+//! this function, and are never reused. Objects which keep per-thread state to
+//! avoid contention (sharded counters, reader slots, ...) use this index,
+//! usually modulo their number of shards, to pick the shard of a thread.
+inline size_t thread_index() {
+  static std::atomic<size_t> next_index{0};
+  static thread_local const size_t index = next_index++;
+  return index;
+}
+
+}  // namespace bm
+
+#endif  // BM_BM_SIM_THREAD_INDEX_H_
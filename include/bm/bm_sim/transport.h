@@ -25,6 +25,8 @@
 #include <initializer_list>
 #include <memory>
 
+#include <cstddef>
+
 namespace bm {
 
 class TransportIface {
@@ -34,6 +36,12 @@ class TransportIface {
     unsigned int len;
   };
 
+  //! Default size in bytes of the shared memory ring used by make_shm()
+  static constexpr size_t default_shm_capacity = 1 << 20;
+  //! Default permissions of the shared memory ring used by make_shm(): only
+  //! processes running as the same user as the switch can read it
+  static constexpr unsigned int default_shm_mode = 0600;
+
  public:
   virtual ~TransportIface() { }
 
@@ -62,6 +70,14 @@ class TransportIface {
 #ifdef BMNANOMSG_ON
   static std::unique_ptr<TransportIface> make_nanomsg(const std::string &addr);
 #endif
+  //! Sends messages through a shared memory ring (see ShmRing) named \p name,
+  //! which can be read by a single consumer on the same host. The ring is
+  //! created by open(), with permissions \p mode, which exits the process if a
+  //! ring with the same name is still open, unless \p replace_open is true
+  //! (see ShmRing::create()).
+  static std::unique_ptr<TransportIface> make_shm(
+      const std::string &name, size_t capacity = default_shm_capacity,
+      bool replace_open = false, unsigned int mode = default_shm_mode);
   static std::unique_ptr<TransportIface> make_dummy();
   static std::unique_ptr<TransportIface> make_stdout();
 
@@ -35,12 +35,14 @@ namespace thrift_provider = apache::thrift;
 #endif
 
 #include <bm/bm_apps/learn.h>
+#include <bm/bm_sim/shm_ring.h>
 #include <bm/thrift/stdcxx.h>
 #include <bm/Standard.h>
 #include <bm/SimplePre.h>
 
 #include <nanomsg/pubsub.h>
 
+#include <chrono>
 #include <iostream>
 #include <string>
 
@@ -66,6 +68,12 @@ struct learn_hdr_t {
 static_assert(sizeof(learn_hdr_t) == 32u,
               "Invalid size for learning notification header");
 
+LearnListener::MsgInfo
+make_msg_info(const learn_hdr_t &learn_hdr) {
+  return {learn_hdr.switch_id, learn_hdr.cxt_id, learn_hdr.list_id,
+          learn_hdr.buffer_id, learn_hdr.num_samples};
+}
+
 }  // namespace
 
 LearnListener::LearnListener(const std::string &learn_socket,
@@ -121,8 +129,67 @@ LearnListener::start() {
   listen_thread = std::thread(&LearnListener::listen_loop, this);
 }
 
+void
+LearnListener::handle_msg(const MsgInfo &info, const char *data) {
+  LearnCb cb_fn_;
+  void *cb_cookie_;
+  std::cout << "I received " << info.num_samples << " samples\n";
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    // I don't believe this is expensive
+    cb_fn_ = cb_fn;
+    cb_cookie_ = cb_cookie;
+  }
+
+  if (!cb_fn_) {
+    std::cout << "No callback\n";
+    return;
+  }
+
+  std::cout << "Calling callback function\n";
+  cb_fn_(info, data, cb_cookie_);
+}
+
+// see NotificationsListenerImp::shm_listen_loop
+void
+LearnListener::shm_listen_loop(const std::string &shm_name) {
+  const auto timeout = std::chrono::milliseconds(200);
+  std::unique_ptr<bm::ShmRing> ring{nullptr};
+  char msg[sizeof(learn_hdr_t) + 4096];
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (stop_listen_thread) return;
+    }
+    if (!ring) {
+      ring = bm::ShmRing::attach(shm_name);
+      if (!ring || ring->is_closed()) {
+        ring = nullptr;
+        std::this_thread::sleep_for(timeout);
+        continue;
+      }
+    }
+    int len = ring->pop(msg, sizeof(msg), timeout);
+    if (len == bm::ShmRing::POP_CLOSED) ring = nullptr;  // closed by the switch
+    if (len < static_cast<int>(sizeof(learn_hdr_t))) continue;
+    // only learn notifications are of interest
+    if (memcmp("LEA|", msg, 4)) continue;
+    learn_hdr_t learn_hdr;
+    memcpy(&learn_hdr, msg, sizeof(learn_hdr));
+    handle_msg(make_msg_info(learn_hdr), msg + sizeof(learn_hdr));
+  }
+}
+
 void
 LearnListener::listen_loop() {
+  std::string shm_name;
+  if (bm::ShmRing::parse_addr(socket_name, &shm_name)) {
+    shm_listen_loop(shm_name);
+    return;
+  }
+
   nn::socket s(AF_SP, NN_SUB);
   // only subscribe to learn notifications
   s.setsockopt(NN_SUB, NN_SUB_SUBSCRIBE, "LEA", 3);
@@ -149,26 +216,7 @@ LearnListener::listen_loop() {
       continue;
     }
 
-    LearnCb cb_fn_;
-    void *cb_cookie_;
-    std::cout << "I received " << learn_hdr.num_samples << " samples\n";
-
-    {
-      std::unique_lock<std::mutex> lock(mutex);
-      // I don't believe this is expensive
-      cb_fn_ = cb_fn;
-      cb_cookie_ = cb_cookie;
-    }
-
-    if (!cb_fn_) {
-      std::cout << "No callback\n";
-      continue;
-    }
-
-    std::cout << "Calling callback function\n";
-    MsgInfo info = {learn_hdr.switch_id, learn_hdr.cxt_id, learn_hdr.list_id,
-                    learn_hdr.buffer_id, learn_hdr.num_samples};
-    cb_fn_(info, data, cb_cookie_);
+    handle_msg(make_msg_info(learn_hdr), data);
   }
 }
 
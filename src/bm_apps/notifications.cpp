@@ -19,9 +19,11 @@
  */
 
 #include <bm/bm_apps/notifications.h>
+#include <bm/bm_sim/shm_ring.h>
 
 #include <nanomsg/pubsub.h>
 
+#include <chrono>
 #include <string>
 #include <thread>
 #include <mutex>
@@ -75,6 +77,8 @@ class NotificationsListenerImp {
 
   explicit NotificationsListenerImp(const std::string &socket_name)
       : socket_name(socket_name), s(AF_SP, NN_SUB) {
+    use_shm = bm::ShmRing::parse_addr(socket_name, &shm_name);
+    if (use_shm) return;
     // subscribe to all notifications. In theory we could just subscribe to the
     // notifications for which the client has provided a callback; we can
     // implement this later if needed.
@@ -116,12 +120,17 @@ class NotificationsListenerImp {
 
  private:
   void listen_loop();
+  void shm_listen_loop();
+  bool must_stop() const;
+  void receive(const char *hdr, const char *data);
   void receive_AGE(const char *hdr, const char *data);
   void receive_LEA(const char *hdr, const char *data);
   void receive_PRT(const char *hdr, const char *data);
 
   std::string socket_name{};
   nn::socket s;
+  bool use_shm{false};
+  std::string shm_name{};
 
   LearnCb LEA_cb_fn{};
   void *LEA_cb_cookie{nullptr};
@@ -198,8 +207,32 @@ NotificationsListenerImp::receive_PRT(const char *hdr, const char *data) {
   }
 }
 
+void
+NotificationsListenerImp::receive(const char *hdr, const char *data) {
+  if (!memcmp("AGE|", hdr, 4)) {
+    receive_AGE(hdr, data);
+  } else if (!memcmp("LEA|", hdr, 4)) {
+    receive_LEA(hdr, data);
+  } else if (!memcmp("PRT|", hdr, 4)) {
+    receive_PRT(hdr, data);
+  } else {
+    std::cout << "Unknown notification type\n";
+  }
+}
+
+bool
+NotificationsListenerImp::must_stop() const {
+  std::unique_lock<std::mutex> lock(mutex);
+  return stop_listen_thread;
+}
+
 void
 NotificationsListenerImp::listen_loop() {
+  if (use_shm) {
+    shm_listen_loop();
+    return;
+  }
+
   struct nn_msghdr msghdr;
   struct nn_iovec iov[2];
   // all notification headers have size 32 bytes, padded at the end if needed
@@ -221,15 +254,32 @@ NotificationsListenerImp::listen_loop() {
     }
 
     const char *hdr = reinterpret_cast<char *>(&storage);
-    if (!memcmp("AGE|", hdr, 4)) {
-      receive_AGE(hdr, data);
-    } else if (!memcmp("LEA|", hdr, 4)) {
-      receive_LEA(hdr, data);
-    } else if (!memcmp("PRT|", hdr, 4)) {
-      receive_PRT(hdr, data);
-    } else {
-      std::cout << "Unknown notification type\n";
+    receive(hdr, data);
+  }
+}
+
+// the ring may not exist yet when the listener is started, and it is replaced
+// if the switch is restarted, in which case we need to attach to the new one
+void
+NotificationsListenerImp::shm_listen_loop() {
+  const auto timeout = std::chrono::milliseconds(200);
+  std::unique_ptr<bm::ShmRing> ring{nullptr};
+  // all notification headers have size 32 bytes, padded at the end if needed
+  char msg[32 + 4096];
+
+  while (!must_stop()) {
+    if (!ring) {
+      ring = bm::ShmRing::attach(shm_name);
+      if (!ring || ring->is_closed()) {
+        ring = nullptr;
+        std::this_thread::sleep_for(timeout);
+        continue;
+      }
     }
+    int len = ring->pop(msg, sizeof(msg), timeout);
+    if (len == bm::ShmRing::POP_CLOSED) ring = nullptr;  // closed by the switch
+    if (len < 32) continue;
+    receive(msg, msg + 32);
   }
 }
 
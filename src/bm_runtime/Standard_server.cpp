@@ -25,6 +25,7 @@
 #include <bm/bm_sim/switch.h>
 
 #include <functional>
+#include <map>
 
 namespace bm_runtime { namespace standard {
 
@@ -1151,6 +1152,34 @@ public:
     switch_->reset_state();
   }
 
+  void bm_set_log_subsystem(const std::string& subsystem, const bool enabled) {
+    Logger::get()->trace("bm_set_log_subsystem");
+    if (subsystem == "all") {
+      for (int i = 0; i < static_cast<int>(Logger::Subsystem::NUM_SUBSYSTEMS);
+           i++) {
+        Logger::set_subsystem_enabled(static_cast<Logger::Subsystem>(i),
+                                      enabled);
+      }
+      return;
+    }
+    Logger::Subsystem s;
+    if (!Logger::subsystem_from_name(subsystem, &s)) {
+      InvalidLogOperation ilo;
+      ilo.code = LogErrorCode::INVALID_SUBSYSTEM;
+      throw ilo;
+    }
+    Logger::set_subsystem_enabled(s, enabled);
+  }
+
+  void bm_get_log_subsystems(std::map<std::string, bool>& _return) {
+    Logger::get()->trace("bm_get_log_subsystems");
+    for (int i = 0; i < static_cast<int>(Logger::Subsystem::NUM_SUBSYSTEMS);
+         i++) {
+      auto s = static_cast<Logger::Subsystem>(i);
+      _return[Logger::subsystem_name(s)] = Logger::is_subsystem_enabled(s);
+    }
+  }
+
   void bm_get_config(std::string& _return) {
     Logger::get()->trace("bm_get_config");
     _return.append(switch_->get_config());
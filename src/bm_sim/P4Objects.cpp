@@ -1291,6 +1291,7 @@ P4Objects::init_parsers(const Json::Value &cfg_root, InitState *init_state) {
     const string init_state_name = cfg_parser["init_state"].asString();
     const ParseState *init_state = current_parse_states[init_state_name];
     parser->set_init_state(init_state);
+    parser->compile(phv_factory);
 
     add_parser(parser_name, std::move(parser));
   }
@@ -1450,8 +1451,14 @@ P4Objects::init_actions(const Json::Value &cfg_root) {
         object_source_info(cfg_action)));
 
     const auto &cfg_primitive_calls = cfg_action["primitives"];
-    for (const auto &cfg_primitive_call : cfg_primitive_calls)
+    bool flow_cacheable = true;
+    for (const auto &cfg_primitive_call : cfg_primitive_calls) {
       add_primitive_to_action(cfg_primitive_call, action_fn.get());
+      flow_cacheable &= FlowCache::is_cacheable_primitive(
+          cfg_primitive_call["op"].asString());
+    }
+    action_fn->set_flow_cacheable(flow_cacheable);
+    action_fn->enable_striped_register_accesses();
 
     add_action(action_id, std::move(action_fn));
   }
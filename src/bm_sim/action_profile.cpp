@@ -18,6 +18,8 @@
  *
  */
 
+#define BMLOG_SUBSYSTEM TABLES
+
 #include <bm/bm_sim/_assert.h>
 #include <bm/bm_sim/action_profile.h>
 #include <bm/bm_sim/logger.h>
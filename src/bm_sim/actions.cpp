@@ -18,14 +18,18 @@
  *
  */
 
+#define BMLOG_SUBSYSTEM ACTIONS
+
 #include <bm/bm_sim/actions.h>
 #include <bm/bm_sim/debugger.h>
 #include <bm/bm_sim/event_logger.h>
+#include <bm/bm_sim/flow_cache.h>
 #include <bm/bm_sim/P4Objects.h>
 #include <bm/bm_sim/packet.h>
 #include <bm/bm_sim/logger.h>
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "utils.h"
@@ -238,6 +242,160 @@ ActionFn::get_num_params() const {
   return num_params;
 }
 
+void
+ActionFn::set_flow_cacheable(bool flow_cacheable) {
+  this->flow_cacheable = flow_cacheable;
+}
+
+bool
+ActionFn::get_flow_cache_fields(FlowCacheFields *fields) const {
+  if (!flow_cacheable) return false;
+  for (const auto &param : params) {
+    switch (param.tag) {
+      case ActionParam::CONST:
+      case ActionParam::ACTION_DATA:
+      case ActionParam::STRING:
+        break;
+      case ActionParam::FIELD:
+        fields->push_back_field(param.field.header, param.field.field_offset);
+        break;
+      case ActionParam::HEADER:
+        fields->push_back_header(param.header);
+        break;
+      case ActionParam::EXPRESSION:
+        if (!param.expression.ptr->get_flow_cache_fields(fields)) return false;
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+void
+ActionFn::enable_striped_register_accesses() {
+  // for each register array, the position of the index parameter of each
+  // striped access, and the number of references which prevent striping
+  struct RegisterRefs {
+    std::vector<size_t> index_params{};
+    int others{0};
+  };
+  std::unordered_map<RegisterArray *, RegisterRefs> refs;
+  RegisterSync expression_accesses;
+  for (const auto &expr : expressions)
+    expr->grab_register_accesses(&expression_accesses);
+  for (const auto &primitive : primitives) {
+    const bool striped = primitive.uses_striped_register_accesses();
+    const size_t end =
+        primitive.get_param_offset() + primitive.get_num_params();
+    for (size_t p = primitive.get_param_offset(); p < end; p++) {
+      const auto &param = params.at(p);
+      switch (param.tag) {
+        case ActionParam::REGISTER_ARRAY:
+          // the index is the parameter which follows the array
+          if (striped && p + 1 < end)
+            refs[param.register_array].index_params.push_back(p + 1);
+          else
+            refs[param.register_array].others++;
+          break;
+        case ActionParam::REGISTER_REF:
+          refs[param.register_ref.array].others++;
+          break;
+        case ActionParam::REGISTER_GEN:
+          refs[param.register_gen.array].others++;
+          break;
+        default:
+          break;
+      }
+    }
+  }
+  std::vector<RegisterArray *> striped_arrays;
+  for (const auto &p : refs) {
+    if (p.second.others == 0 && p.second.index_params.size() == 1 &&
+        !expression_accesses.has_register_array(p.first))
+      striped_arrays.push_back(p.first);
+  }
+  // a striped access must not be made while the action holds the lock of
+  // another register array: with another action locking the arrays in the
+  // opposite order, this would be a lock-order inversion; so it is all or
+  // nothing
+  if (striped_arrays.size() == register_sync.size()) {
+    for (auto register_array : striped_arrays) {
+      register_array->enable_striped_accesses();
+      register_sync.remove_register_array(register_array);
+    }
+    return;
+  }
+  // read-modify-write: the action only references one register array, always
+  // at the same index, so it can hold the stripe containing that index for its
+  // whole duration
+  if (refs.size() != 1 || register_sync.size() != 1) return;
+  auto register_array = refs.begin()->first;
+  const auto &array_refs = refs.begin()->second;
+  if (array_refs.others > 0 ||
+      expression_accesses.has_register_array(register_array))
+    return;
+  const size_t index_param = array_refs.index_params.front();
+  for (size_t p : array_refs.index_params) {
+    if (!is_stable_index(params[index_param], params[p])) return;
+  }
+  if (params[index_param].tag == ActionParam::FIELD &&
+      !field_is_only_index(params[index_param], array_refs.index_params.size()))
+    return;
+  register_array->enable_striped_accesses();
+  register_sync.remove_register_array(register_array);
+  rmw_register_array = register_array;
+  rmw_index_param = index_param;
+}
+
+// true if both parameters are guaranteed to evaluate to the same value
+// whenever the action is executed; a field may still be modified by the action,
+// which is checked by field_is_only_index()
+bool
+ActionFn::is_stable_index(const ActionParam &param_1,
+                          const ActionParam &param_2) const {
+  if (param_1.tag != param_2.tag) return false;
+  switch (param_1.tag) {
+    case ActionParam::CONST:
+      return const_values[param_1.const_offset] ==
+          const_values[param_2.const_offset];
+    case ActionParam::ACTION_DATA:
+      return param_1.action_data_offset == param_2.action_data_offset;
+    case ActionParam::FIELD:
+      return param_1.field.header == param_2.field.header &&
+          param_1.field.field_offset == param_2.field.field_offset;
+    default:
+      return false;
+  }
+}
+
+// true if the field is not passed to any primitive other than as one of the
+// nb_refs index parameters, and no primitive takes a whole header as a
+// parameter, so that the action cannot modify the index
+bool
+ActionFn::field_is_only_index(const ActionParam &field_param,
+                              size_t nb_refs) const {
+  size_t count = 0;
+  for (const auto &param : params) {
+    switch (param.tag) {
+      case ActionParam::FIELD:
+        if (param.field.header == field_param.field.header &&
+            param.field.field_offset == field_param.field.field_offset)
+          count++;
+        break;
+      case ActionParam::HEADER:
+      case ActionParam::HEADER_STACK:
+      case ActionParam::LAST_HEADER_STACK_FIELD:
+      case ActionParam::HEADER_UNION:
+      case ActionParam::HEADER_UNION_STACK:
+        return false;
+      default:
+        break;
+    }
+  }
+  return count == nb_refs;
+}
+
 namespace core {
 
 extern int _bm_core_primitives_import();
@@ -335,10 +493,18 @@ ActionFnEntry::operator()(Packet *pkt) const {
   DEBUGGER_NOTIFY_CTR(
       Debugger::PacketId::make(pkt->get_packet_id(), pkt->get_copy_id()),
       DBG_CTR_ACTION | action_fn->get_id());
+  FlowCache::record_action(*action_fn);
 
   {
     RegisterSync::RegisterLocks RL;
     action_fn->register_sync.lock(&RL);
+    if (action_fn->rmw_register_array) {
+      ActionEngineState state(pkt, action_data, action_fn->const_values);
+      const auto &idx = action_fn->params[action_fn->rmw_index_param]
+          .to<const Data &>(&state);
+      RegisterSync::lock_stripe(action_fn->rmw_register_array,
+                                idx.get<size_t>(), &RL);
+    }
     execute(pkt);
   }
 
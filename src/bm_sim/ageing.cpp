@@ -19,6 +19,7 @@
  */
 
 #include <bm/bm_sim/ageing.h>
+#include <bm/bm_sim/clock.h>
 #include <bm/bm_sim/match_tables.h>
 #include <bm/bm_sim/packet.h>
 #include <bm/bm_sim/logger.h>
@@ -27,8 +28,10 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <algorithm>  // std::max
 #include <map>
-#include <unordered_set>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <memory>
 
@@ -37,11 +40,101 @@ namespace bm {
 static_assert(sizeof(AgeingMonitorIface::msg_hdr_t) == 32u,
               "Invalid size for ageing notification header");
 
+namespace {
+
+// Hierarchical timer wheel with a 1 ms resolution. Level l has 256 slots, each
+// one covering 256^l ms. A timer is stored at the lowest level at which its
+// deadline and the current time differ; when the current time reaches the
+// start of a slot at level l > 0, the timers in this slot are moved down to a
+// lower level. Advancing the wheel costs O(1) per elapsed ms and per expired
+// (or moved) timer, independently of the total number of timers.
+class TimerWheel {
+ public:
+  using Timer = std::pair<entry_handle_t, uint64_t>;  // handle, deadline
+
+  explicit TimerWheel(uint64_t now_ms)
+      : current(now_ms) { }
+
+  void reset(uint64_t now_ms) {
+    for (auto &level : slots)
+      for (auto &slot : level) slot.clear();
+    current = now_ms;
+    num_timers = 0;
+  }
+
+  void add(entry_handle_t handle, uint64_t deadline_ms) {
+    num_timers++;
+    // timers which are already due are fired at the next tick
+    insert_(Timer(handle, deadline_ms), std::max(deadline_ms, current + 1));
+  }
+
+  // appends to expired all the timers with a deadline <= now_ms
+  void advance(uint64_t now_ms, std::vector<Timer> *expired) {
+    if (num_timers == 0) {
+      current = std::max(current, now_ms);
+      return;
+    }
+    while (current < now_ms) {
+      current++;
+      for (int l = 1; l < nb_levels; l++) {
+        if ((current & ((uint64_t(1) << (l * slot_bits)) - 1)) != 0) break;
+        auto &slot = slots[l][get_slot_idx(current, l)];
+        std::vector<Timer> cascaded;
+        cascaded.swap(slot);
+        // deadlines are >= current here
+        for (const auto &timer : cascaded) insert_(timer, timer.second);
+      }
+      auto &slot = slots[0][get_slot_idx(current, 0)];
+      num_timers -= slot.size();
+      expired->insert(expired->end(), slot.begin(), slot.end());
+      slot.clear();
+      if (num_timers == 0) current = now_ms;
+    }
+  }
+
+ private:
+  static constexpr int nb_levels = 5;  // 2^40 ms, more than 30 years
+  static constexpr int slot_bits = 8;
+  static constexpr size_t nb_slots = 1 << slot_bits;
+
+  static size_t get_slot_idx(uint64_t t, int level) {
+    return (t >> (level * slot_bits)) & (nb_slots - 1);
+  }
+
+  // when is the time used to select the slot, which has to be >= current and
+  // is the deadline of the timer unless the timer is already due
+  void insert_(const Timer &timer, uint64_t when) {
+    int level = 0;
+    while ((when >> ((level + 1) * slot_bits)) !=
+           (current >> ((level + 1) * slot_bits))) {
+      if (++level == nb_levels - 1) break;
+    }
+    // a deadline beyond the range of the wheel is capped: the timer will fire
+    // early, which is fine since the expiry of the entry is checked again
+    if (level == nb_levels - 1 &&
+        (when >> (nb_levels * slot_bits)) !=
+        (current >> (nb_levels * slot_bits))) {
+      when = current + (uint64_t(1) << (level * slot_bits));
+    }
+    slots[level][get_slot_idx(when, level)].push_back(timer);
+  }
+
+  std::vector<Timer> slots[nb_levels][nb_slots];
+  uint64_t current{0};
+  size_t num_timers{0};
+};
+
+constexpr int TimerWheel::nb_levels;
+constexpr int TimerWheel::slot_bits;
+constexpr size_t TimerWheel::nb_slots;
+
+}  // namespace
+
 class AgeingMonitor final : public AgeingMonitorIface {
  public:
   using msg_hdr_t = AgeingMonitorIface::msg_hdr_t;
   using buffer_id_t = uint64_t;
-  using clock = Packet::clock;
+  using clock = Clock::clock;
 
   AgeingMonitor(device_id_t device_id, cxt_id_t cxt_id,
                 std::shared_ptr<TransportIface> writer,
@@ -59,10 +152,21 @@ class AgeingMonitor final : public AgeingMonitorIface {
   void sweep_loop();
   void do_sweep();
 
+  static uint64_t get_now_ms() {
+    return Clock::get_millis(Clock::Consumer::AGEING);
+  }
+
  private:
+  // Instead of checking every entry of the table at each sweep, we keep one
+  // timer per entry with a TTL, set to the time at which the entry would
+  // expire if it was not hit. When the timer fires, the expiry of the entry is
+  // computed again from its timestamp: if it was hit in the meantime, the
+  // timer is simply re-armed. Otherwise, a notification is sent and the timer
+  // is re-armed so that the entry is reported again 2 sweeps later if it is
+  // still idle.
   struct TableData {
-    explicit TableData(MatchTableAbstract *table)
-      : table(table) { }
+    TableData(MatchTableAbstract *table, uint64_t now_ms)
+      : table(table), wheel(now_ms) { }
 
     TableData(const TableData &other) = delete;
     TableData &operator=(const TableData &other) = delete;
@@ -71,7 +175,11 @@ class AgeingMonitor final : public AgeingMonitorIface {
     TableData &operator=(TableData &&other) /*noexcept*/ = default;
 
     MatchTableAbstract *table{nullptr};
-    std::unordered_set<entry_handle_t> prev_sweep_entries{};
+    TimerWheel wheel;
+    // deadline of the last timer armed for each tracked entry, timers with a
+    // different deadline are obsolete and are ignored when they fire; 0 means
+    // that the entry is being checked
+    std::unordered_map<entry_handle_t, uint64_t> deadlines{};
   };
 
  private:
@@ -87,7 +195,10 @@ class AgeingMonitor final : public AgeingMonitorIface {
   std::atomic<unsigned int> sweep_interval_ms{0};
 
   std::vector<entry_handle_t> entries{};
-  std::vector<entry_handle_t> entries_tmp{};
+  std::vector<entry_handle_t> ttl_updates{};
+  std::vector<entry_handle_t> handles_to_check{};
+  std::vector<uint64_t> expiry_ms{};
+  std::vector<TimerWheel::Timer> expired_timers{};
   buffer_id_t buffer_id{0};
 
   std::thread sweep_thread{};
@@ -114,7 +225,9 @@ AgeingMonitor::~AgeingMonitor() {
 
 void
 AgeingMonitor::add_table(MatchTableAbstract *table) {
-  tables_with_ageing.insert(std::make_pair(table->get_id(), TableData(table)));
+  std::unique_lock<std::mutex> lock(mutex);
+  tables_with_ageing.insert(
+      std::make_pair(table->get_id(), TableData(table, get_now_ms())));
 }
 
 void
@@ -126,11 +239,12 @@ void
 AgeingMonitor::reset_state() {
   std::unique_lock<std::mutex> lock(mutex);
   entries.clear();
-  entries_tmp.clear();
   buffer_id = 0;
+  const auto now_ms = get_now_ms();
   for (auto &entry : tables_with_ageing) {
     TableData &data = entry.second;
-    data.prev_sweep_entries.clear();
+    data.wheel.reset(now_ms);
+    data.deadlines.clear();
   }
 }
 
@@ -149,31 +263,54 @@ AgeingMonitor::sweep_loop() {
 
 void
 AgeingMonitor::do_sweep() {
+  const uint64_t now_ms = get_now_ms();
+  const uint64_t renotify_ms = 2 * static_cast<uint64_t>(sweep_interval_ms);
   for (auto &entry : tables_with_ageing) {
     TableData &data = entry.second;
-    const MatchTableAbstract *t = data.table;
-    auto &prev_sweep_entries = data.prev_sweep_entries;
-    t->sweep_entries(&entries_tmp);
-    if (entries_tmp.empty()) {
-      prev_sweep_entries.clear();
-      continue;
+    MatchTableAbstract *t = data.table;
+    auto &deadlines = data.deadlines;
+
+    // the entries to check are the ones whose TTL was just set and the ones
+    // whose timer expired, each entry is only checked once
+    handles_to_check.clear();
+    t->take_ttl_updates(&ttl_updates);
+    for (entry_handle_t handle : ttl_updates) {
+      auto p = deadlines.emplace(handle, 0);
+      if (!p.second) {
+        if (p.first->second == 0) continue;
+        p.first->second = 0;
+      }
+      handles_to_check.push_back(handle);
     }
-
-    for (entry_handle_t handle : entries_tmp) {
-      if (prev_sweep_entries.find(handle) == prev_sweep_entries.end()) {
+    expired_timers.clear();
+    data.wheel.advance(now_ms, &expired_timers);
+    for (const auto &timer : expired_timers) {
+      auto it = deadlines.find(timer.first);
+      if (it == deadlines.end() || it->second != timer.second) continue;
+      it->second = 0;
+      handles_to_check.push_back(timer.first);
+    }
+    if (handles_to_check.empty()) continue;
+
+    t->get_entries_expiry(handles_to_check, &expiry_ms);
+    for (size_t i = 0; i < handles_to_check.size(); i++) {
+      entry_handle_t handle = handles_to_check[i];
+      uint64_t deadline = expiry_ms[i];
+      if (deadline == 0) {  // entry deleted or TTL removed
+        deadlines.erase(handle);
+        continue;
+      }
+      if (deadline <= now_ms) {
         BMLOG_TRACE("Ageing entry {} in table '{}'\n", handle, t->get_name());
         entries.push_back(handle);
+        deadline = now_ms + renotify_ms;
       }
+      deadlines[handle] = deadline;
+      data.wheel.add(handle, deadline);
     }
-    entries_tmp.clear();
-    prev_sweep_entries.clear();
 
     if (entries.empty()) continue;
 
-    for (entry_handle_t handle : entries) {
-      prev_sweep_entries.insert(handle);
-    }
-
     BMLOG_TRACE("Sending ageing notification for table '{}' ({})",
                 t->get_name(), entry.first);
 
@@ -31,8 +31,8 @@
 #include <ostream>
 
 #include "xxhash.h"
-#include "crc_tables.h"
 #include "extract.h"
+#include "hash_kernels.h"
 
 namespace bm {
 
@@ -124,6 +124,91 @@ BufBuilder::operator()(const Packet &pkt, ByteContainer *buf) const {
   }
 }
 
+// Same layout as Deparse, but the field values are read from the header bytes
+// in the packet; ok is set to false if they are not available.
+struct BufBuilder::DeparseFromPacket : public boost::static_visitor<> {
+  DeparseFromPacket(const PHV &phv, ByteContainer *buf)
+      : phv(phv), deparse(phv, buf) { }
+
+  void operator()(const field_t &f) {
+    const Header &header = phv.get_header(f.header);
+    const char *packet_bytes = header.get_packet_bytes();
+    // if the header is not valid, we do not know whether it was valid when the
+    // packet was parsed; hidden fields are not part of the plan
+    const auto &plan = header.get_header_type().get_extract_plan();
+    if (!header.is_valid() || !packet_bytes ||
+        static_cast<size_t>(f.field_offset) >= plan.size()) {
+      ok = false;
+      return;
+    }
+    static thread_local ByteContainer value;
+    const auto &placement = plan[f.field_offset];
+    const int bitwidth = header.get_field(f.field_offset).get_nbits();
+    value.resize((bitwidth + 7) / 8);
+    extract::generic_extract(packet_bytes + placement.byte_offset,
+                             placement.bit_offset, bitwidth, value.data());
+    const auto offset = deparse.get_offset();
+    extract::generic_deparse(value.data(), bitwidth, deparse.extend(bitwidth),
+                             offset);
+  }
+
+  void operator()(const constant_t &c) {
+    deparse(c);
+  }
+
+  void operator()(const header_t &h) {
+    const Header &header = phv.get_header(h.header);
+    const char *packet_bytes = header.get_packet_bytes();
+    if (!header.is_valid() || !packet_bytes) {
+      ok = false;
+      return;
+    }
+    const int nbytes = header.get_nbytes_packet();
+    std::copy(packet_bytes, packet_bytes + nbytes, deparse.extend(nbytes * 8));
+  }
+
+  const PHV &phv;
+  Deparse deparse;
+  bool ok{true};
+};
+
+void
+BufBuilder::build_headers(const Packet &pkt, ByteContainer *buf) const {
+  buf->clear();
+  Deparse visitor(*pkt.get_phv(), buf);
+  std::for_each(entries.begin(), entries.end(),
+                boost::apply_visitor(visitor));
+}
+
+bool
+BufBuilder::build_from_packet_bytes(const Packet &pkt,
+                                    ByteContainer *buf) const {
+  buf->clear();
+  DeparseFromPacket visitor(*pkt.get_phv(), buf);
+  for (const auto &entry : entries) {
+    boost::apply_visitor(visitor, entry);
+    if (!visitor.ok) return false;
+  }
+  return true;
+}
+
+HashFragment
+BufBuilder::get_payload(const Packet &pkt) {
+  return {pkt.data(), pkt.get_data_size()};
+}
+
+bool
+BufBuilder::uses_field(header_id_t header, int field_offset) const {
+  for (const auto &entry : entries) {
+    if (const auto *f = boost::get<field_t>(&entry)) {
+      if (f->header == header && f->field_offset == field_offset) return true;
+    } else if (const auto *h = boost::get<header_t>(&entry)) {
+      if (h->header == header) return true;
+    }
+  }
+  return false;
+}
+
 namespace hash {
 
 uint64_t xxh64(const char *buffer, size_t s) {
@@ -134,41 +219,36 @@ uint64_t xxh64(const char *buffer, size_t s) {
 
 namespace {
 
-/* This code was adapted from:
-   http://www.barrgroup.com/Embedded-Systems/How-To/CRC-Calculation-C-Code */
-
-template <typename T>
-T reflect(T data, int nBits) {
-  T reflection = static_cast<T>(0x00);
-  int bit;
-
-  // Reflect the data about the center bit.
-  for (bit = 0; bit < nBits; ++bit) {
-    // If the LSB bit is set, set the reflection of it.
-    if (data & 0x01) {
-      reflection |= (static_cast<T>(1) << ((nBits - 1) - bit));
-    }
-    data = (data >> 1);
-  }
-
-  return reflection;
-}
+using hash_kernels::CrcSlicing8;
+using hash_kernels::reflect;
 
 struct xxh64 {
   uint64_t operator()(const char *buf, size_t len) const {
     return XXH64(buf, len, 0);
   }
+
+  uint64_t gather(const HashFragment *fragments, size_t n) const {
+    XXH64_state_t state;
+    XXH64_reset(&state, 0);
+    for (size_t i = 0; i < n; i++)
+      XXH64_update(&state, fragments[i].buf, fragments[i].s);
+    return XXH64_digest(&state);
+  }
 };
 
 struct crc16 {
   uint16_t operator()(const char *buf, size_t len) const {
+    const HashFragment fragment = {buf, len};
+    return gather(&fragment, 1);
+  }
+
+  // CRC-16/ARC
+  uint16_t gather(const HashFragment *fragments, size_t n) const {
+    static const CrcSlicing8<uint16_t> crc(0x8005, true);
     uint16_t remainder = 0x0000;
-    uint16_t final_xor_value = 0x0000;
-    for (unsigned int byte = 0; byte < len; byte++) {
-      int data = reflect<uint16_t>(buf[byte], 8) ^ (remainder >> 8);
-      remainder = table_crc16[data] ^ (remainder << 8);
-    }
-    return reflect<uint16_t>(remainder, 16) ^ final_xor_value;
+    for (size_t i = 0; i < n; i++)
+      remainder = crc.update(remainder, fragments[i].buf, fragments[i].s);
+    return remainder;
   }
 };
 
@@ -221,26 +301,42 @@ true, true};
 template <typename T>
 struct crc_custom {
   static constexpr size_t width = sizeof(T) * 8;
-  static constexpr size_t kTEntries = 256u;
   using crc_config_t = typename CustomCrcMgr<T>::crc_config_t;
 
-  crc_custom() {
-    config = crc_custom_init<T>::config;
-    recompute_crc_table(config, crc_table);
-  }
+  crc_custom()
+      : config(crc_custom_init<T>::config), crc(make_crc(config)) { }
 
   T operator()(const char *buf, size_t len) const {
+    const HashFragment fragment = {buf, len};
+    return gather(&fragment, 1);
+  }
+
+  T gather(const HashFragment *fragments, size_t n) const {
     // clearly not optimized (critical section may be made smaller), but we will
     // try to do better if needed
     std::unique_lock<std::mutex> lock(m);
 
+    if (config.data_reflected == config.remainder_reflected) {
+      T remainder = config.data_reflected ?
+          reflect<T>(config.initial_remainder, width) :
+          config.initial_remainder;
+      for (size_t i = 0; i < n; i++)
+        remainder = crc.update(remainder, fragments[i].buf, fragments[i].s);
+      return remainder ^ config.final_xor_value;
+    }
+
+    // uncommon case, we process one byte at a time
+    const T *crc_table = crc.get_byte_table();
     T remainder = config.initial_remainder;
-    for (unsigned int byte = 0; byte < len; byte++) {
-      unsigned char uchar = static_cast<unsigned char>(buf[byte]);
-      int data = (config.data_reflected) ?
-          reflect<T>(uchar, 8) ^ (remainder >> (width - 8)) :
-          uchar ^ (remainder >> (width - 8));
-      remainder = crc_table[data] ^ (remainder << 8);
+    for (size_t i = 0; i < n; i++) {
+      const char *buf = fragments[i].buf;
+      for (size_t byte = 0; byte < fragments[i].s; byte++) {
+        unsigned char uchar = static_cast<unsigned char>(buf[byte]);
+        int data = (config.data_reflected) ?
+            reflect<T>(uchar, 8) ^ (remainder >> (width - 8)) :
+            uchar ^ (remainder >> (width - 8));
+        remainder = crc_table[data] ^ (remainder << 8);
+      }
     }
     return (config.remainder_reflected) ?
         reflect<T>(remainder, width) ^ config.final_xor_value :
@@ -248,107 +344,76 @@ struct crc_custom {
   }
 
   void update_config(const crc_config_t &new_config) {
-    T crc_table_new[kTEntries];
-    recompute_crc_table(new_config, crc_table_new);
+    const CrcSlicing8<T> crc_new = make_crc(new_config);
 
     std::unique_lock<std::mutex> lock(m);
     config = new_config;
-    std::memcpy(crc_table, crc_table_new, sizeof(crc_table));
+    crc = crc_new;
   }
 
  private:
-  void recompute_crc_table(const crc_config_t &new_config, T *new_table) {
-    // Compute the remainder of each possible dividend
-    for (size_t dividend = 0; dividend < kTEntries; dividend++) {
-      // Start with the dividend followed by zeros
-      T remainder = static_cast<T>(dividend) << (width - 8);
-      // Perform modulo-2 division, a bit at a time
-      for (unsigned char bit = 8; bit > 0; bit--) {
-        // Try to divide the current data bit
-        if (remainder & (static_cast<T>(1) << (width - 1))) {
-          remainder = (remainder << 1) ^ new_config.polynomial;
-        } else {
-          remainder = (remainder << 1);
-        }
-      }
-
-      // Compute the remainder of each possible dividend
-      new_table[dividend] = remainder;
-    }
+  // the remainder is only processed in the reflected domain if both the data
+  // and the remainder are reflected
+  static CrcSlicing8<T> make_crc(const crc_config_t &config) {
+    return CrcSlicing8<T>(
+        config.polynomial,
+        config.data_reflected && config.remainder_reflected);
   }
 
-  T crc_table[kTEntries];
   crc_config_t config;
+  CrcSlicing8<T> crc;
   mutable std::mutex m{};
 };
 
 struct crc32 {
   uint32_t operator()(const char *buf, size_t len) const {
+    const HashFragment fragment = {buf, len};
+    return gather(&fragment, 1);
+  }
+
+  uint32_t gather(const HashFragment *fragments, size_t n) const {
+    static const CrcSlicing8<uint32_t> crc(0x04c11db7, true);
     uint32_t remainder = 0xFFFFFFFF;
-    uint32_t final_xor_value = 0xFFFFFFFF;
-    for (unsigned int byte = 0; byte < len; byte++) {
-      int data = reflect<uint32_t>(buf[byte], 8) ^ (remainder >> 24);
-      remainder = table_crc32[data] ^ (remainder << 8);
-    }
-    return reflect<uint32_t>(remainder, 32) ^ final_xor_value;
+    for (size_t i = 0; i < n; i++)
+      remainder = crc.update(remainder, fragments[i].buf, fragments[i].s);
+    return remainder ^ 0xFFFFFFFF;
   }
 };
 
 struct crcCCITT {
   uint16_t operator()(const char *buf, size_t len) const {
+    const HashFragment fragment = {buf, len};
+    return gather(&fragment, 1);
+  }
+
+  uint16_t gather(const HashFragment *fragments, size_t n) const {
+    static const CrcSlicing8<uint16_t> crc(0x1021, false);
     uint16_t remainder = 0xFFFF;
-    uint16_t final_xor_value = 0x0000;
-    for (unsigned int byte = 0; byte < len; byte++) {
-      int data = static_cast<unsigned char>(buf[byte]) ^ (remainder >> 8);
-      remainder = table_crcCCITT[data] ^ (remainder << 8);
-    }
-    return remainder ^ final_xor_value;
+    for (size_t i = 0; i < n; i++)
+      remainder = crc.update(remainder, fragments[i].buf, fragments[i].s);
+    return remainder;
   }
 };
 
 struct cksum16 {
   uint16_t operator()(const char *buf, size_t len) const {
-    uint64_t sum = 0;
-    const uint64_t *b = reinterpret_cast<const uint64_t *>(buf);
-    uint32_t t1, t2;
-    uint16_t t3, t4;
-    const uint8_t *tail;
-    /* Main loop - 8 bytes at a time */
-    while (len >= sizeof(uint64_t)) {
-      uint64_t s = *b++;
-      sum += s;
-      if (sum < s) sum++;
-      len -= 8;
-    }
-    /* Handle tail less than 8-bytes long */
-    tail = reinterpret_cast<const uint8_t *>(b);
-    if (len & 4) {
-      uint32_t s = *reinterpret_cast<const uint32_t *>(tail);
-      sum += s;
-      if (sum < s) sum++;
-      tail += 4;
-    }
-    if (len & 2) {
-      uint16_t s = *reinterpret_cast<const uint16_t *>(tail);
-      sum += s;
-      if (sum < s) sum++;
-      tail += 2;
-    }
-    if (len & 1) {
-      uint8_t s = *reinterpret_cast<const uint8_t *>(tail);
+    return ntohs(~hash_kernels::ones_complement_sum(buf, len));
+  }
+
+  // a fragment starting at an odd offset contributes the byte-swapped value of
+  // its own sum (RFC 1071)
+  uint16_t gather(const HashFragment *fragments, size_t n) const {
+    uint32_t sum = 0;
+    size_t offset = 0;
+    for (size_t i = 0; i < n; i++) {
+      uint16_t s = hash_kernels::ones_complement_sum(fragments[i].buf,
+                                                     fragments[i].s);
+      if (offset & 1) s = static_cast<uint16_t>((s >> 8) | (s << 8));
       sum += s;
-      if (sum < s) sum++;
+      offset += fragments[i].s;
     }
-    /* Fold down to 16 bits */
-    t1 = sum;
-    t2 = sum >> 32;
-    t1 += t2;
-    if (t1 < t2) t1++;
-    t3 = t1;
-    t4 = t1 >> 16;
-    t3 += t4;
-    if (t3 < t4) t3++;
-    return ntohs(~t3);
+    while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+    return ntohs(~static_cast<uint16_t>(sum));
   }
 };
 
@@ -356,14 +421,27 @@ struct csum16 {
   uint16_t operator()(const char *buf, size_t len) const {
     return cksum16()(buf, len);
   }
+
+  uint16_t gather(const HashFragment *fragments, size_t n) const {
+    return cksum16().gather(fragments, n);
+  }
 };
 
 struct identity {
   uint64_t operator()(const char *buf, size_t len) const {
+    const HashFragment fragment = {buf, len};
+    return gather(&fragment, 1);
+  }
+
+  // the first 8 bytes of input
+  uint64_t gather(const HashFragment *fragments, size_t n) const {
     uint64_t res = 0ULL;
-    for (size_t i = 0; i < std::min(sizeof(res), len); i++) {
-      if (i > 0) res <<= 8;
-      res += static_cast<uint8_t>(buf[i]);
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < fragments[i].s && count < sizeof(res); j++) {
+        res = (res << 8) + static_cast<uint8_t>(fragments[i].buf[j]);
+        count++;
+      }
     }
     return res;
   }
@@ -390,6 +468,15 @@ REGISTER_HASH(crc32_custom);
 using crc64_custom = crc_custom<uint64_t>;
 REGISTER_HASH(crc64_custom);
 
+namespace hash {
+
+bool is_csum16(const RawCalculationIface<uint64_t> &c) {
+  return dynamic_cast<const RawCalculation<uint64_t, csum16> *>(&c) ||
+      dynamic_cast<const RawCalculation<uint64_t, cksum16> *>(&c);
+}
+
+}  // namespace hash
+
 namespace detail {
 
 template <typename T>
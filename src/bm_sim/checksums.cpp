@@ -18,66 +18,62 @@
  *
  */
 
+#define BMLOG_SUBSYSTEM CHECKSUMS
+
 #include <bm/bm_sim/checksums.h>
 #include <bm/bm_sim/calculations.h>
 #include <bm/bm_sim/logger.h>
 #include <bm/bm_sim/packet.h>
 #include <bm/bm_sim/phv.h>
 
-#include <cstdint>
+#include <algorithm>
 #include <string>
 
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "extract.h"
+#include "hash_kernels.h"
+
 namespace bm {
 
 namespace {
 
-// TODO(antonin): remove this ? it is duplicated in calculations.cpp
+// the result is in network byte order
 uint16_t cksum16(char *buf, size_t len) {
-  uint64_t sum = 0;
-  uint64_t *b = reinterpret_cast<uint64_t *>(buf);
-  uint32_t t1, t2;
-  uint16_t t3, t4;
-  uint8_t *tail;
-  /* Main loop - 8 bytes at a time */
-  while (len >= sizeof(uint64_t)) {
-    uint64_t s = *b++;
-    sum += s;
-    if (sum < s) sum++;
-    len -= 8;
-  }
-  /* Handle tail less than 8-bytes long */
-  tail = reinterpret_cast<uint8_t *>(b);
-  if (len & 4) {
-    uint32_t s = *reinterpret_cast<uint32_t *>(tail);
-    sum += s;
-    if (sum < s) sum++;
-    tail += 4;
-  }
-  if (len & 2) {
-    uint16_t s = *reinterpret_cast<uint16_t *>(tail);
-    sum += s;
-    if (sum < s) sum++;
-    tail += 2;
-  }
-  if (len & 1) {
-    uint8_t s = *reinterpret_cast<uint8_t *>(tail);
-    sum += s;
-    if (sum < s) sum++;
+  return ~hash_kernels::ones_complement_sum(buf, len);
+}
+
+uint16_t read_word(const char *buf, size_t len, size_t i) {
+  auto ubuf = reinterpret_cast<const unsigned char *>(buf);
+  uint16_t w = ubuf[i] << 8;
+  if (i + 1 < len) w |= ubuf[i + 1];
+  return w;
+}
+
+// RFC 1624, eqn. 3: HC' = ~(~HC + ~m + m'), applied to all the 16-bit words m
+// which differ between old_buf and new_buf. An odd length is ok, as long as the
+// bytes following both buffers in the checksum computation are the same. The
+// checksums are in host byte order.
+uint16_t cksum16_update(uint16_t cksum, const char *old_buf,
+                        const char *new_buf, size_t len) {
+  uint64_t sum = static_cast<uint16_t>(~cksum);
+  for (size_t i = 0; i < len; i += 2) {
+    const uint16_t m = read_word(old_buf, len, i);
+    const uint16_t m_ = read_word(new_buf, len, i);
+    if (m == m_) continue;
+    sum += static_cast<uint16_t>(~m);
+    sum += m_;
   }
-  /* Fold down to 16 bits */
-  t1 = sum;
-  t2 = sum >> 32;
-  t1 += t2;
-  if (t1 < t2) t1++;
-  t3 = t1;
-  t4 = t1 >> 16;
-  t3 += t4;
-  if (t3 < t4) t3++;
-  return ~t3;
+  while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+  return ~static_cast<uint16_t>(sum);
 }
 
 }  // namespace
 
+std::atomic<bool> Checksum::incremental_updates{false};
+
 Checksum::Checksum(const std::string &name, p4object_id_t id,
                    header_id_t header_id, int field_offset)
   : NamedP4Object(name, id),
@@ -122,6 +118,16 @@ Checksum::set_checksum_condition(std::unique_ptr<Expression> cksum_condition) {
   condition = std::move(cksum_condition);
 }
 
+void
+Checksum::set_incremental_updates(bool enable) {
+  incremental_updates = enable;
+}
+
+bool
+Checksum::get_incremental_updates() {
+  return incremental_updates.load(std::memory_order_relaxed);
+}
+
 bool
 Checksum::is_checksum_condition_met(const Packet &pkt) const {
   return (!condition) || (condition->eval_bool(*pkt.get_phv()));
@@ -141,11 +147,55 @@ CalcBasedChecksum::CalcBasedChecksum(const std::string &name, p4object_id_t id,
 
 void
 CalcBasedChecksum::update_(Packet *pkt) const {
-  const uint64_t cksum = calculation->output(*pkt);
   auto &f_cksum = pkt->get_phv()->get_field(header_id, field_offset);
+  uint64_t cksum;
+  if (get_incremental_updates() && update_incremental(*pkt, &cksum)) {
+    // leave the field untouched if possible, so that the header does not need
+    // to be deparsed again
+    if (f_cksum.get<uint64_t>() != cksum) f_cksum.set(cksum);
+    return;
+  }
+  cksum = calculation->output(*pkt);
   f_cksum.set(cksum);
 }
 
+bool
+CalcBasedChecksum::update_incremental(const Packet &pkt,
+                                      uint64_t *cksum) const {
+  if (!hash::is_csum16(calculation->get_raw_calculation())) return false;
+  const auto &builder = calculation->get_buf_builder();
+  if (builder.uses_field(header_id, field_offset)) return false;
+  // the payload needs to be the one the incoming checksum was computed on
+  if (builder.has_payload() &&
+      pkt.get_data_size() != pkt.get_packet_buffer().get_data_size()) {
+    return false;
+  }
+  const Header &hdr = pkt.get_phv()->get_header(header_id);
+  const char *packet_bytes = hdr.get_packet_bytes();
+  const auto &plan = hdr.get_header_type().get_extract_plan();
+  // hidden fields are not part of the plan
+  if (!packet_bytes || static_cast<size_t>(field_offset) >= plan.size())
+    return false;
+  const auto &placement = plan[field_offset];
+  if (hdr.get_field(field_offset).get_nbits() != 16) return false;
+  char old_bytes[2];
+  extract::generic_extract(packet_bytes + placement.byte_offset,
+                           placement.bit_offset, 16, old_bytes);
+  const uint16_t old_cksum = read_word(old_bytes, sizeof(old_bytes), 0);
+  // for UDP, 0 means that the sender did not compute the checksum
+  if (old_cksum == 0) return false;
+
+  static thread_local ByteContainer old_buf;
+  static thread_local ByteContainer new_buf;
+  if (!builder.build_from_packet_bytes(pkt, &old_buf)) return false;
+  builder.build_headers(pkt, &new_buf);
+  assert(old_buf.size() == new_buf.size());
+  *cksum = cksum16_update(old_cksum, old_buf.data(), new_buf.data(),
+                          old_buf.size());
+  BMLOG_TRACE_PKT(pkt, "Checksum '{}' updated incrementally", get_name());
+  return true;
+}
+
 bool
 CalcBasedChecksum::verify_(const Packet &pkt) const {
   const uint64_t cksum = calculation->output(pkt);
@@ -167,6 +217,26 @@ void IPv4Checksum::update_(Packet *pkt) const {
   if (!ipv4_hdr.is_valid()) return;
   Field &ipv4_cksum = ipv4_hdr[field_offset];
   ipv4_hdr.deparse(buffer);
+  const char *packet_bytes = ipv4_hdr.get_packet_bytes();
+  if (get_incremental_updates() && packet_bytes) {
+    const size_t nbytes = ipv4_hdr.get_nbytes_packet();
+    // the checksum itself is not covered, we use the original one as the
+    // starting point
+    std::copy(packet_bytes + IPV4_CKSUM_OFFSET,
+              packet_bytes + IPV4_CKSUM_OFFSET + 2,
+              buffer + IPV4_CKSUM_OFFSET);
+    const uint16_t old_cksum = read_word(buffer, nbytes, IPV4_CKSUM_OFFSET);
+    const uint16_t cksum = cksum16_update(old_cksum, packet_bytes, buffer,
+                                          nbytes);
+    BMLOG_TRACE_PKT(*pkt, "Checksum '{}' updated incrementally", get_name());
+    const char new_bytes[2] = {static_cast<char>(cksum >> 8),
+                               static_cast<char>(cksum & 0xff)};
+    // leave the field untouched if possible, so that the header does not need
+    // to be deparsed again
+    if (memcmp(new_bytes, ipv4_cksum.get_bytes().data(), 2))
+      ipv4_cksum.set_bytes(new_bytes, 2);
+    return;
+  }
   buffer[IPV4_CKSUM_OFFSET] = 0; buffer[IPV4_CKSUM_OFFSET + 1] = 0;
   uint16_t cksum = cksum16(buffer, ipv4_hdr.get_nbytes_packet());
   // cksum is in network byte order
@@ -0,0 +1,136 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <bm/bm_sim/clock.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace bm {
+
+constexpr size_t Clock::nb_consumers;
+
+std::atomic<bool> Clock::coarse[Clock::nb_consumers];
+std::atomic<Clock::clock::rep> Clock::cached_ticks{0};
+
+namespace {
+
+using ticks = std::chrono::microseconds;
+
+// Background thread refreshing the cached time, it runs as long as at least
+// one consumer has a non-zero resolution
+class Ticker {
+ public:
+  ~Ticker() {
+    std::unique_lock<std::mutex> config_lock(config_mutex);
+    stop();
+  }
+
+  // called with config_mutex held
+  void set_resolution(size_t consumer, ticks resolution,
+                      std::atomic<bool> *coarse,
+                      std::atomic<Clock::clock::rep> *cached_ticks) {
+    if (resolution.count() == 0)
+      coarse->store(false, std::memory_order_relaxed);
+    resolutions[consumer] = resolution;
+    ticks period = ticks::zero();
+    for (const auto &r : resolutions) {
+      if (r.count() > 0 && (period.count() == 0 || r < period)) period = r;
+    }
+    if (period != current_period) {
+      stop();
+      if (period.count() > 0) start(period, cached_ticks);
+      current_period = period;
+    }
+    // the cached time is valid as soon as the ticker has been started
+    if (resolution.count() > 0)
+      coarse->store(true, std::memory_order_relaxed);
+  }
+
+  ticks get_resolution(size_t consumer) const {
+    return resolutions[consumer];
+  }
+
+  std::mutex config_mutex{};
+
+ private:
+  void start(ticks period, std::atomic<Clock::clock::rep> *cached_ticks) {
+    cached_ticks->store(Clock::clock::now().time_since_epoch().count(),
+                        std::memory_order_relaxed);
+    stop_ticker = false;
+    ticker = std::thread(&Ticker::loop, this, period, cached_ticks);
+  }
+
+  void stop() {
+    if (!ticker.joinable()) return;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      stop_ticker = true;
+    }
+    cv.notify_one();
+    ticker.join();
+  }
+
+  void loop(ticks period, std::atomic<Clock::clock::rep> *cached_ticks) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stop_ticker) {
+      cv.wait_for(lock, period);
+      cached_ticks->store(Clock::clock::now().time_since_epoch().count(),
+                          std::memory_order_relaxed);
+    }
+  }
+
+  ticks resolutions[static_cast<size_t>(Clock::Consumer::NUM_CONSUMERS)]{};
+  ticks current_period{ticks::zero()};
+  std::thread ticker{};
+  std::mutex mutex{};
+  std::condition_variable cv{};
+  bool stop_ticker{false};
+};
+
+Ticker ticker;
+
+}  // namespace
+
+void
+Clock::set_resolution(Consumer consumer, std::chrono::microseconds resolution) {
+  const auto c = static_cast<size_t>(consumer);
+  if (c >= nb_consumers) return;
+  std::unique_lock<std::mutex> lock(ticker.config_mutex);
+  ticker.set_resolution(c, std::max(resolution, ticks::zero()), &coarse[c],
+                        &cached_ticks);
+}
+
+std::chrono::microseconds
+Clock::get_resolution(Consumer consumer) {
+  const auto c = static_cast<size_t>(consumer);
+  if (c >= nb_consumers) return ticks::zero();
+  std::unique_lock<std::mutex> lock(ticker.config_mutex);
+  return ticker.get_resolution(c);
+}
+
+Clock::Consumer
+Clock::consumer_from_name(const std::string &name) {
+  if (name == "ageing") return Consumer::AGEING;
+  if (name == "meters") return Consumer::METERS;
+  if (name == "queueing") return Consumer::QUEUEING;
+  if (name == "timestamps") return Consumer::TIMESTAMPS;
+  return Consumer::NUM_CONSUMERS;
+}
+
+}  // namespace bm
@@ -18,6 +18,8 @@
  *
  */
 
+#define BMLOG_SUBSYSTEM PIPELINE
+
 #include <bm/bm_sim/conditionals.h>
 #include <bm/bm_sim/event_logger.h>
 #include <bm/bm_sim/packet.h>
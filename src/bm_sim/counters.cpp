@@ -24,22 +24,56 @@
 
 namespace bm {
 
+size_t Counter::num_shards = 1;
+
+Counter::~Counter() {
+  delete[] cells.load();
+}
+
+void
+Counter::enable_sharding() {
+  num_cells = num_shards;
+}
+
+// several threads may race to allocate the cells, only one of them wins
+Counter::Cell *
+Counter::allocate_cells() {
+  Cell *new_cells = new Cell[num_cells];
+  Cell *expected = nullptr;
+  if (cells.compare_exchange_strong(expected, new_cells,
+                                    std::memory_order_acq_rel)) {
+    return new_cells;
+  }
+  delete[] new_cells;
+  return expected;
+}
+
 Counter::CounterErrorCode
 Counter::query_counter(counter_value_t *bytes, counter_value_t *packets) const {
   *bytes = this->bytes;
   *packets = this->packets;
+  const Cell *c = cells.load(std::memory_order_acquire);
+  if (!c) return SUCCESS;
+  for (size_t i = 0; i < num_cells; i++) {
+    *bytes += c[i].bytes.load(std::memory_order_relaxed);
+    *packets += c[i].packets.load(std::memory_order_relaxed);
+  }
   return SUCCESS;
 }
 
 Counter::CounterErrorCode
 Counter::reset_counter() {
-  bytes = 0u;
-  packets = 0u;
-  return SUCCESS;
+  return write_counter(0u, 0u);
 }
 
+// the cells are cleared, and the value is stored in the base counter
 Counter::CounterErrorCode
 Counter::write_counter(counter_value_t bytes, counter_value_t packets) {
+  Cell *c = cells.load(std::memory_order_acquire);
+  for (size_t i = 0; c && i < num_cells; i++) {
+    c[i].bytes = 0u;
+    c[i].packets = 0u;
+  }
   this->bytes = bytes;
   this->packets = packets;
   return SUCCESS;
@@ -47,6 +81,8 @@ Counter::write_counter(counter_value_t bytes, counter_value_t packets) {
 
 void
 Counter::serialize(std::ostream *out) const {
+  counter_value_t bytes, packets;
+  query_counter(&bytes, &packets);
   (*out) << bytes << " " << packets << "\n";
 }
 
@@ -54,8 +90,19 @@ void
 Counter::deserialize(std::istream *in) {
   uint64_t b, p;
   (*in) >> b >> p;
-  bytes = b;
-  packets = p;
+  write_counter(b, p);
+}
+
+void
+Counter::set_num_shards(size_t num_shards) {
+  size_t n = 1;
+  while (n < num_shards) n <<= 1;
+  Counter::num_shards = n;
+}
+
+size_t
+Counter::get_num_shards() {
+  return num_shards;
 }
 
 Counter::CounterErrorCode
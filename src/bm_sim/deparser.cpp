@@ -18,6 +18,8 @@
  *
  */
 
+#define BMLOG_SUBSYSTEM DEPARSER
+
 #include <bm/bm_sim/deparser.h>
 #include <bm/bm_sim/debugger.h>
 #include <bm/bm_sim/logger.h>
@@ -26,6 +28,8 @@
 #include <bm/bm_sim/checksums.h>
 #include <bm/bm_sim/phv.h>
 
+#include <vector>
+
 namespace bm {
 
 size_t
@@ -42,7 +46,7 @@ Deparser::get_headers_size(const PHV &phv) const {
 
 void
 Deparser::deparse(Packet *pkt) const {
-  const PHV *phv = pkt->get_phv();
+  PHV *phv = pkt->get_phv();
   BMELOG(deparser_start, *pkt, *this);
   // TODO(antonin)
   // this is temporary while we experiment with the debugger
@@ -56,11 +60,16 @@ Deparser::deparse(Packet *pkt) const {
   // invalidating headers, and resetting header stacks is done in the Packet
   // destructor, when the PHV is released
   for (auto it = headers.begin(); it != headers.end(); ++it) {
-    const auto &header = phv->get_header(*it);
+    auto &header = phv->get_header(*it);
     if (header.is_valid()) {
       BMELOG(deparser_emit, *pkt, *it);
       BMLOG_DEBUG_PKT(*pkt, "Deparsing header '{}'", header.get_name());
-      header.deparse(data + bytes_parsed);
+      // headers which were not modified since they were extracted are usually
+      // already in the right place
+      if (!header.deparse_to_packet(data + bytes_parsed)) {
+        BMLOG_TRACE_PKT(*pkt, "Header '{}' is unmodified, not rewriting it",
+                        header.get_name());
+      }
       bytes_parsed += header.get_nbytes_packet();
     }
   }
@@ -71,6 +80,11 @@ Deparser::deparse(Packet *pkt) const {
   BMLOG_DEBUG_PKT(*pkt, "Deparser '{}': end", get_name());
 }
 
+void
+Deparser::deparse_batch(const std::vector<Packet *> &pkts) const {
+  for (auto pkt : pkts) deparse(pkt);
+}
+
 void
 Deparser::update_checksums(Packet *pkt) const {
   for (const Checksum *checksum : checksums) {
@@ -28,6 +28,16 @@
 #include <bm/bm_sim/pipeline.h>
 #include <bm/bm_sim/checksums.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cassert>
 #include <cstring>
 
 namespace bm {
@@ -67,6 +77,289 @@ fill_msg_hdr(EventType type, device_id_t device_id,
 
 }  // namespace
 
+// Each thread generating events owns a single-producer / single-consumer ring
+// of fixed-size records, so that generating an event does not require any lock.
+// The rings are drained by a background thread, which publishes the events in
+// batches. Each ring is drained in FIFO order, so the events of one thread are
+// published in the order in which they were generated; there is no ordering
+// across threads (which would require the producers to share a counter), each
+// event carries the packet id and copy id instead. The drain thread sleeps when
+// all the rings are empty and is woken up by the next producer. A ring is freed
+// once its thread has exited and all its events have been published.
+class EventLogger::AsyncWriter {
+ public:
+  AsyncWriter(const TransportIface *transport, size_t ring_size)
+      : transport(transport), ring_size(ring_size),
+        id(next_id.fetch_add(1)) {
+    batch.reserve(max_batch_size);
+    drain_thread = std::thread(&AsyncWriter::drain_loop, this);
+  }
+
+  ~AsyncWriter() {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cv.notify_one();
+    drain_thread.join();
+  }
+
+  void push(const void *msg, size_t len) {
+    assert(len <= max_msg_size);
+    get_ring()->push(msg, len);
+    // the flag is only written by the drain thread when it goes to sleep, so
+    // checking it does not make the producers contend on a cache line
+    if (sleeping.load(std::memory_order_relaxed) &&
+        sleeping.exchange(false, std::memory_order_relaxed)) {
+      // the drain thread holds the mutex until it is waiting on the condition
+      // variable, so the notification cannot be missed
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.notify_one();
+    }
+  }
+
+  uint64_t get_dropped() const {
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t dropped = retired_dropped;
+    for (const auto &ring : rings)
+      dropped += ring->dropped.load(std::memory_order_relaxed);
+    return dropped;
+  }
+
+  AsyncWriter(const AsyncWriter &other) = delete;
+  AsyncWriter &operator=(const AsyncWriter &other) = delete;
+
+ private:
+  // large enough for the biggest event message
+  static constexpr size_t max_msg_size = 60;
+  static constexpr size_t max_batch_size = 8192;
+  // the drain thread is normally woken up by the producers, but a producer may
+  // miss the sleeping flag if it pushes while the drain thread is checking the
+  // rings; this bounds how long such an event can wait
+  static constexpr std::chrono::milliseconds max_sleep{100};
+
+  struct Record {
+    uint32_t len;
+    std::array<char, max_msg_size> data;
+  };
+
+  class Ring {
+   public:
+    explicit Ring(size_t size)
+        : records(round_up_pow2(size)), mask(records.size() - 1) { }
+
+    // called by the owning thread only
+    void push(const void *msg, size_t len) {
+      const auto t = tail.load(std::memory_order_relaxed);
+      if (t - head_cache == records.size()) {
+        head_cache = head.load(std::memory_order_acquire);
+        if (t - head_cache == records.size()) {
+          dropped.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+      }
+      auto &record = records[t & mask];
+      record.len = static_cast<uint32_t>(len);
+      std::memcpy(record.data.data(), msg, len);
+      tail.store(t + 1, std::memory_order_release);
+    }
+
+    // called by the owning thread only, after its last push
+    void close() {
+      closed.store(true, std::memory_order_release);
+    }
+
+    // called by the drain thread only; returns nullptr if the ring is empty
+    const Record *front() const {
+      const auto h = head.load(std::memory_order_relaxed);
+      if (h == tail.load(std::memory_order_acquire)) return nullptr;
+      return &records[h & mask];
+    }
+
+    // called by the drain thread only, after a successful front()
+    void pop() {
+      head.store(head.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+    }
+
+    // called by the drain thread only; true if the ring can be freed
+    bool is_done() const {
+      return closed.load(std::memory_order_acquire) && front() == nullptr;
+    }
+
+    std::atomic<uint64_t> dropped{0};
+
+   private:
+    static size_t round_up_pow2(size_t size) {
+      size_t pow2 = 1;
+      while (pow2 < size) pow2 <<= 1;
+      return pow2;
+    }
+
+    std::vector<Record> records;
+    const size_t mask;
+    // the producer and consumer indices are kept on separate cache lines
+    char pad0[64];
+    std::atomic<size_t> tail{0};
+    size_t head_cache{0};
+    char pad1[64];
+    std::atomic<size_t> head{0};
+    std::atomic<bool> closed{false};
+  };
+
+  // closes the ring of the thread when the thread exits (or starts using
+  // another writer); the ring is shared with the writer, which may be destroyed
+  // first
+  class ThreadRing {
+   public:
+    ~ThreadRing() {
+      if (ring) ring->close();
+    }
+
+    void reset(uint64_t new_writer_id, std::shared_ptr<Ring> new_ring) {
+      if (ring) ring->close();
+      writer_id = new_writer_id;
+      ring = std::move(new_ring);
+    }
+
+    // the writer id (unlike its address) is never reused, so a stale ring
+    // cannot be mistaken for a valid one
+    uint64_t writer_id{0};
+    std::shared_ptr<Ring> ring{nullptr};
+  };
+
+  Ring *get_ring() {
+    static thread_local ThreadRing thread_ring;
+    if (thread_ring.writer_id != id) {
+      std::shared_ptr<Ring> ring(new Ring(ring_size));
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        rings.push_back(ring);
+      }
+      thread_ring.reset(id, std::move(ring));
+    }
+    return thread_ring.ring.get();
+  }
+
+  // returns the number of events published
+  size_t drain() {
+    // rings are only removed by this thread, the pointers remain valid
+    std::vector<Ring *> snapshot;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      for (const auto &ring : rings) snapshot.push_back(ring.get());
+    }
+    // a slow producer only delays its own events, the other rings are drained
+    // independently
+    size_t count = 0;
+    for (auto ring : snapshot) {
+      const Record *record;
+      while ((record = ring->front()) != nullptr) {
+        if (batch.size() + record->len > max_batch_size) flush();
+        batch.insert(batch.end(), record->data.begin(),
+                     record->data.begin() + record->len);
+        ring->pop();
+        count++;
+      }
+    }
+    flush();
+    remove_done_rings();
+    return count;
+  }
+
+  void remove_done_rings() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (auto it = rings.begin(); it != rings.end();) {
+      if ((*it)->is_done()) {
+        retired_dropped += (*it)->dropped.load(std::memory_order_relaxed);
+        it = rings.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // must be called with the mutex held
+  bool has_events() const {
+    for (const auto &ring : rings)
+      if (ring->front() != nullptr) return true;
+    return false;
+  }
+
+  void flush() {
+    if (batch.empty()) return;
+    transport->send(batch.data(), static_cast<int>(batch.size()));
+    batch.clear();
+  }
+
+  void drain_loop() {
+    while (true) {
+      if (drain() > 0) continue;
+      std::unique_lock<std::mutex> lock(mutex);
+      if (stop) break;
+      sleeping.store(true);
+      // an event may have been pushed after the last drain but before the flag
+      // was set, in which case its producer did not wake us up
+      if (!has_events()) cv.wait_for(lock, max_sleep);
+      sleeping.store(false, std::memory_order_relaxed);
+    }
+    // producers are not supposed to generate events at this stage, this
+    // publishes whatever is left
+    drain();
+  }
+
+  const TransportIface *transport;
+  const size_t ring_size;
+  const uint64_t id;
+  std::vector<char> batch{};
+  std::vector<std::shared_ptr<Ring> > rings{};
+  // events dropped by the rings which have been freed
+  uint64_t retired_dropped{0};
+  mutable std::mutex mutex{};
+  std::condition_variable cv{};
+  bool stop{false};
+  // set by the drain thread when it waits for events, cleared by the producer
+  // which wakes it up
+  std::atomic<bool> sleeping{false};
+  std::thread drain_thread{};
+
+  static std::atomic<uint64_t> next_id;
+};
+
+constexpr size_t EventLogger::AsyncWriter::max_msg_size;
+constexpr size_t EventLogger::AsyncWriter::max_batch_size;
+constexpr std::chrono::milliseconds EventLogger::AsyncWriter::max_sleep;
+
+std::atomic<uint64_t> EventLogger::AsyncWriter::next_id{1};
+
+EventLogger::EventLogger(std::unique_ptr<TransportIface> transport,
+                         device_id_t device_id)
+    : transport_instance(std::move(transport)), device_id(device_id) { }
+
+EventLogger::~EventLogger() = default;
+
+void
+EventLogger::set_async(size_t ring_size) {
+  async_writer.reset();
+  if (ring_size > 0)
+    async_writer.reset(new AsyncWriter(transport_instance.get(), ring_size));
+}
+
+uint64_t
+EventLogger::get_dropped_events() const {
+  return async_writer ? async_writer->get_dropped() : 0;
+}
+
+void
+EventLogger::send(const void *msg, size_t len) {
+  if (async_writer) {
+    async_writer->push(msg, len);
+    return;
+  }
+  transport_instance->send(static_cast<const char *>(msg),
+                           static_cast<int>(len));
+}
+
 void
 EventLogger::packet_in(const Packet &packet) {
   struct msg_t : msg_hdr_t {
@@ -76,7 +369,7 @@ EventLogger::packet_in(const Packet &packet) {
   msg_t msg;
   fill_msg_hdr(EventType::PACKET_IN, device_id, packet, &msg);
   msg.port_in = packet.get_ingress_port();
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 void
@@ -88,7 +381,7 @@ EventLogger::packet_out(const Packet &packet) {
   msg_t msg;
   fill_msg_hdr(EventType::PACKET_OUT, device_id, packet, &msg);
   msg.port_out = packet.get_egress_port();
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 void
@@ -100,7 +393,7 @@ EventLogger::parser_start(const Packet &packet, const Parser &parser) {
   msg_t msg;
   fill_msg_hdr(EventType::PARSER_START, device_id, packet, &msg);
   msg.parser_id = parser.get_id();
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 void
@@ -112,7 +405,7 @@ EventLogger::parser_done(const Packet &packet, const Parser &parser) {
   msg_t msg;
   fill_msg_hdr(EventType::PARSER_DONE, device_id, packet, &msg);
   msg.parser_id = parser.get_id();
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 void
@@ -124,7 +417,7 @@ EventLogger::parser_extract(const Packet &packet, header_id_t header) {
   msg_t msg;
   fill_msg_hdr(EventType::PARSER_EXTRACT, device_id, packet, &msg);
   msg.header_id = header;
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 void
@@ -136,7 +429,7 @@ EventLogger::deparser_start(const Packet &packet, const Deparser &deparser) {
   msg_t msg;
   fill_msg_hdr(EventType::DEPARSER_START, device_id, packet, &msg);
   msg.deparser_id = deparser.get_id();
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 void
@@ -148,7 +441,7 @@ EventLogger::deparser_done(const Packet &packet, const Deparser &deparser) {
   msg_t msg;
   fill_msg_hdr(EventType::DEPARSER_DONE, device_id, packet, &msg);
   msg.deparser_id = deparser.get_id();
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 void
@@ -160,7 +453,7 @@ EventLogger::deparser_emit(const Packet &packet, header_id_t header) {
   msg_t msg;
   fill_msg_hdr(EventType::DEPARSER_EMIT, device_id, packet, &msg);
   msg.header_id = header;
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 void
@@ -172,7 +465,7 @@ EventLogger::checksum_update(const Packet &packet, const Checksum &checksum) {
   msg_t msg;
   fill_msg_hdr(EventType::CHECKSUM_UPDATE, device_id, packet, &msg);
   msg.checksum_id = checksum.get_id();
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 void
@@ -184,7 +477,7 @@ EventLogger::pipeline_start(const Packet &packet, const Pipeline &pipeline) {
   msg_t msg;
   fill_msg_hdr(EventType::PIPELINE_START, device_id, packet, &msg);
   msg.pipeline_id = pipeline.get_id();
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 void
@@ -196,7 +489,7 @@ EventLogger::pipeline_done(const Packet &packet, const Pipeline &pipeline) {
   msg_t msg;
   fill_msg_hdr(EventType::PIPELINE_DONE, device_id, packet, &msg);
   msg.pipeline_id = pipeline.get_id();
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 void
@@ -211,7 +504,7 @@ EventLogger::condition_eval(const Packet &packet,
   fill_msg_hdr(EventType::CONDITION_EVAL, device_id, packet, &msg);
   msg.condition_id = cond.get_id();
   msg.result = result;
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 // static inline size_t get_pascal_str_size(const ByteContainer &src) {
@@ -236,7 +529,7 @@ EventLogger::table_hit(const Packet &packet, const MatchTableAbstract &table,
   fill_msg_hdr(EventType::TABLE_HIT, device_id, packet, &msg);
   msg.table_id = table.get_id();
   msg.entry_hdl = static_cast<int>(handle);
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 void
@@ -248,7 +541,7 @@ EventLogger::table_miss(const Packet &packet, const MatchTableAbstract &table) {
   msg_t msg;
   fill_msg_hdr(EventType::TABLE_MISS, device_id, packet, &msg);
   msg.table_id = table.get_id();
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 void
@@ -262,7 +555,7 @@ EventLogger::action_execute(const Packet &packet,
   msg_t msg;
   fill_msg_hdr(EventType::ACTION_EXECUTE, device_id, packet, &msg);
   msg.action_id = action_fn.get_id();
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
   // to costly to send action data?
   (void) action_data;
 }
@@ -273,7 +566,7 @@ EventLogger::config_change() {
   std::memset(&msg, 0, sizeof(msg));
   msg.type = static_cast<int>(EventType::CONFIG_CHANGE);
   msg.switch_id = device_id;
-  transport_instance->send(reinterpret_cast<char *>(&msg), sizeof(msg));
+  send(&msg, sizeof(msg));
 }
 
 // TODO(antonin): move this?
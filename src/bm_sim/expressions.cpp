@@ -19,6 +19,7 @@
  */
 
 #include <bm/bm_sim/expressions.h>
+#include <bm/bm_sim/flow_cache.h>
 #include <bm/bm_sim/stacks.h>
 #include <bm/bm_sim/phv.h>
 #include <bm/bm_sim/stateful.h>
@@ -291,6 +292,105 @@ Expression::grab_register_accesses(RegisterSync *register_sync) const {
   }
 }
 
+bool
+Expression::get_flow_cache_fields(FlowCacheFields *fields) const {
+  for (auto &op : ops) {
+    switch (op.opcode) {
+      case ExprOpcode::LOAD_FIELD:
+        fields->push_back_field(op.field.header, op.field.field_offset);
+        break;
+      case ExprOpcode::LOAD_HEADER:
+        fields->push_back_header(op.header);
+        break;
+      case ExprOpcode::LOAD_HEADER_STACK:
+      case ExprOpcode::LOAD_LAST_HEADER_STACK_FIELD:
+      case ExprOpcode::LOAD_UNION:
+      case ExprOpcode::LOAD_UNION_STACK:
+      case ExprOpcode::LOAD_REGISTER_REF:
+      case ExprOpcode::LOAD_REGISTER_GEN:
+        return false;
+      default:
+        continue;
+    }
+  }
+  return true;
+}
+
+bool
+Expression::get_field_chain(FieldChainExpression *chain) const {
+  // the constant operands are limited to 32 bits, which, along with the checks
+  // in FieldChainExpression::eval, guarantees that we compute the same result
+  // as the bignum-based evaluation
+  auto get_small_const = [this](const Op &op, int64_t *v) {
+    if (op.opcode != ExprOpcode::LOAD_CONST) return false;
+    const Data &c = const_values[op.const_offset];
+    if (c < Data(0) || c > Data(0xffffffffu)) return false;
+    *v = c.get<int64_t>();
+    return true;
+  };
+  if (ops.empty() || ops[0].opcode != ExprOpcode::LOAD_FIELD) return false;
+  chain->header = ops[0].field.header;
+  chain->field_offset = ops[0].field.field_offset;
+  chain->steps.clear();
+  // ops is in reverse Polish notation: after the field, we expect a sequence of
+  // (LOAD_CONST, operator) pairs
+  for (size_t i = 1; i < ops.size(); i += 2) {
+    int64_t v;
+    if (i + 1 >= ops.size() || !get_small_const(ops[i], &v)) return false;
+    switch (ops[i + 1].opcode) {
+      case ExprOpcode::ADD:
+      case ExprOpcode::SUB:
+      case ExprOpcode::MUL:
+      case ExprOpcode::SHIFT_LEFT:
+      case ExprOpcode::BIT_AND:
+        chain->steps.push_back({ops[i + 1].opcode, v});
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+bool
+FieldChainExpression::eval(int64_t field_value, int64_t *res) const {
+  int64_t v = field_value;
+  for (const auto &step : steps) {
+    switch (step.opcode) {
+      case ExprOpcode::ADD:
+        if (__builtin_add_overflow(v, step.value, &v)) return false;
+        break;
+      case ExprOpcode::SUB:
+        if (__builtin_sub_overflow(v, step.value, &v)) return false;
+        break;
+      case ExprOpcode::MUL:
+        if (__builtin_mul_overflow(v, step.value, &v)) return false;
+        break;
+      case ExprOpcode::SHIFT_LEFT:
+        if (step.value >= 62) return false;
+        if (__builtin_mul_overflow(v, static_cast<int64_t>(1) << step.value,
+                                   &v))
+          return false;
+        break;
+      case ExprOpcode::BIT_AND:
+        // same as the two's complement semantics of the bignum AND
+        v &= step.value;
+        break;
+      default:
+        return false;
+    }
+  }
+  *res = v;
+  return true;
+}
+
+bool
+FieldChainExpression::eval(const PHV &phv, int64_t *res) const {
+  const auto &f = phv.get_field(header, field_offset);
+  if (f.get_nbits() > 32) return false;
+  return eval(f.get<int64_t>(), res);
+}
+
 /* I have made this function more efficient by using thread_local variables
    instead of dynamic allocation at each call. Maybe it would be better to just
    try to use a stack allocator */
@@ -23,6 +23,8 @@
 
 #include <algorithm>  // for std::fill, std::copy
 
+#include <cstdint>
+
 namespace bm {
 
 namespace extract {
@@ -66,6 +68,22 @@ static inline void generic_extract(const char *data, int bit_offset,
   }
 }
 
+// Reads a value of at most 64 bits (bitwidth > 0) starting at bit bit_offset
+// of data directly into an integer, without going through a byte array.
+static inline uint64_t extract_uint64(const char *data, int bit_offset,
+                                      int bitwidth) {
+  auto udata = reinterpret_cast<const unsigned char *>(data);
+  const int span = (bit_offset + bitwidth + 7) / 8;
+  // number of bits after the value in the last byte
+  const int trailing = span * 8 - bit_offset - bitwidth;
+  uint64_t v = udata[0] & (0xFF >> bit_offset);
+  if (span == 1) return v >> trailing;
+  for (int i = 1; i < span - 1; i++) v = (v << 8) | udata[i];
+  // we only shift in the bits we need from the last byte, so that values which
+  // straddle 9 bytes do not overflow
+  return (v << (8 - trailing)) | (udata[span - 1] >> trailing);
+}
+
 static inline void generic_deparse(const char *data, int bitwidth,
                                    char *dst, int hdr_offset) {
   if (bitwidth == 0) return;
@@ -54,6 +54,8 @@ Field::reserve_VL(size_t max_bytes) {
 void
 Field::swap_values(Field *other) {
   // do not swap arith!
+  mark_modified();
+  other->mark_modified();
   std::swap(value, other->value);
   std::swap(bytes, other->bytes);
   if (VL) {
@@ -78,6 +80,7 @@ Field::extract(const char *data, int hdr_offset) {
 
 int
 Field::extract_VL(const char *data, int hdr_offset, int computed_nbits) {
+  mark_modified();
   nbits = computed_nbits;
   nbytes = (nbits + 7) / 8;
   mask = 1; mask <<= nbits; mask -= 1;
@@ -119,6 +122,7 @@ Field::assign_VL(const Field &src) {
 void
 Field::reset_VL() {
   assert(VL);
+  mark_modified();
   nbits = 0;
   nbytes = 0;
   mask = 1;
@@ -132,6 +136,7 @@ void
 Field::copy_value(const Field &src) {
   // it's important to have a way of copying a field value without the
   // packet_id pointer. This is used by PHV::copy_headers().
+  mark_modified();
   value = src.value;
   bytes = src.bytes;
   if (VL) {
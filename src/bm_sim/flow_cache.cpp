@@ -0,0 +1,225 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <bm/bm_sim/flow_cache.h>
+#include <bm/bm_sim/actions.h>
+#include <bm/bm_sim/control_flow.h>
+#include <bm/bm_sim/packet.h>
+#include <bm/bm_sim/phv.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <cassert>
+
+namespace bm {
+
+constexpr int FlowCacheFields::VALID;
+constexpr int FlowCacheFields::HEADER;
+
+std::atomic<uint64_t> FlowCache::generation{0};
+
+thread_local FlowCache::Recorder *FlowCache::recorder = nullptr;
+
+FlowCache::Recorder::Recorder(FlowCache *cache, const PHV &phv)
+    : cache(cache), phv(phv),
+      generation(FlowCache::generation.load(std::memory_order_seq_cst)) {
+  assert(!FlowCache::recorder);
+  FlowCache::recorder = this;
+}
+
+FlowCache::Recorder::~Recorder() {
+  FlowCache::recorder = nullptr;
+}
+
+void
+FlowCache::Recorder::visit_node(const ControlFlowNode &node) {
+  if (!cacheable) return;
+  FlowCacheFields fields;
+  if (!node.get_flow_cache_fields(&fields)) {
+    cacheable = false;
+    return;
+  }
+  capture(fields);
+}
+
+void
+FlowCache::Recorder::visit_action(const ActionFn &action_fn) {
+  if (!cacheable) return;
+  FlowCacheFields fields;
+  if (!action_fn.get_flow_cache_fields(&fields)) {
+    cacheable = false;
+    return;
+  }
+  capture(fields);
+}
+
+void
+FlowCache::Recorder::capture(const FlowCacheFields &fields) {
+  for (const auto &ref : fields.get_refs()) {
+    if (ref.second == FlowCacheFields::HEADER) {
+      const Header &hdr = phv.get_header(ref.first);
+      capture_one({ref.first, FlowCacheFields::VALID});
+      for (size_t i = 0; i < hdr.size(); i++)
+        capture_one({ref.first, static_cast<int>(i)});
+    } else {
+      capture_one(ref);
+    }
+  }
+}
+
+void
+FlowCache::Recorder::capture_one(const FieldRef &ref) {
+  if (values.find(ref) != values.end()) return;
+  // the width of a VL field can change from one packet to the other, which
+  // would make the flow key ambiguous
+  if (ref.second != FlowCacheFields::VALID &&
+      phv.get_field(ref.first, ref.second).is_VL()) {
+    cacheable = false;
+    return;
+  }
+  FlowCache::append_value(phv, ref, &values[ref]);
+}
+
+void
+FlowCache::Recorder::commit() {
+  if (!cacheable) return;
+  std::vector<FieldRef> refs;
+  std::vector<Write> writes;
+  ByteContainer key;
+  ByteContainer new_value;
+  refs.reserve(values.size());
+  for (const auto &p : values) {
+    refs.push_back(p.first);
+    key.append(p.second);
+    new_value.clear();
+    FlowCache::append_value(phv, p.first, &new_value);
+    if (new_value != p.second) writes.push_back({p.first, new_value});
+  }
+  cache->insert(std::move(refs), key, std::move(writes), generation);
+}
+
+FlowCache::FlowCache(size_t max_entries)
+    : max_entries(max_entries),
+      cache_generation(generation.load(std::memory_order_seq_cst)) { }
+
+bool
+FlowCache::lookup(Packet *pkt) {
+  const auto current_generation = generation.load(std::memory_order_seq_cst);
+  if (cache_generation.load(std::memory_order_acquire) != current_generation) {
+    WriteLock lock(mutex);
+    clear_();
+    cache_generation.store(current_generation, std::memory_order_release);
+    return false;
+  }
+
+  static thread_local ByteContainer key;
+  PHV *phv = pkt->get_phv();
+  ReadLock lock(mutex);
+  for (const auto &mask : masks) {
+    key.clear();
+    for (const auto &ref : mask.refs) append_value(*phv, ref, &key);
+    auto it = mask.flows.find(key);
+    if (it == mask.flows.end()) continue;
+    for (const auto &write : it->second) apply_write(write, phv);
+    return true;
+  }
+  return false;
+}
+
+size_t
+FlowCache::get_num_entries() const {
+  ReadLock lock(mutex);
+  return num_entries;
+}
+
+void
+FlowCache::clear() {
+  WriteLock lock(mutex);
+  clear_();
+}
+
+void
+FlowCache::clear_() {
+  masks.clear();
+  num_entries = 0;
+}
+
+void
+FlowCache::insert(std::vector<FieldRef> refs, const ByteContainer &key,
+                  std::vector<Write> writes, uint64_t recorded_generation) {
+  WriteLock lock(mutex);
+  // tables may have been modified while the packet was in the pipeline
+  if (recorded_generation != generation.load(std::memory_order_seq_cst))
+    return;
+  if (cache_generation.load(std::memory_order_acquire) != recorded_generation) {
+    clear_();
+    cache_generation.store(recorded_generation, std::memory_order_release);
+  }
+  // we are being very conservative and flushing the whole cache when it is
+  // full; entries will be re-created quickly for the active flows
+  if (num_entries >= max_entries) clear_();
+  auto mask_it = std::find_if(
+      masks.begin(), masks.end(),
+      [&refs](const Mask &mask) { return mask.refs == refs; });
+  if (mask_it == masks.end()) {
+    masks.push_back({std::move(refs), {}});
+    mask_it = masks.end() - 1;
+  }
+  if (mask_it->flows.emplace(key, std::move(writes)).second) num_entries++;
+}
+
+// the validity of the header comes first, which means that the value of a field
+// is well-defined even when its header is not valid
+void
+FlowCache::append_value(const PHV &phv, const FieldRef &ref,
+                        ByteContainer *key) {
+  const Header &hdr = phv.get_header(ref.first);
+  key->push_back(hdr.is_valid() ? 1 : 0);
+  if (ref.second == FlowCacheFields::VALID) return;
+  key->append(hdr.get_field(ref.second).get_bytes());
+}
+
+void
+FlowCache::apply_write(const Write &write, PHV *phv) {
+  Header &hdr = phv->get_header(write.ref.first);
+  if (write.ref.second == FlowCacheFields::VALID) {
+    if (write.value[0])
+      hdr.mark_valid();
+    else
+      hdr.mark_invalid();
+    return;
+  }
+  Field &f = hdr.get_field(write.ref.second);
+  f.set_bytes(write.value.data() + 1, f.get_nbytes());
+}
+
+bool
+FlowCache::is_cacheable_primitive(const std::string &name) {
+  // core primitives and the standard target primitives which only access the
+  // PHV through their parameters; primitives like "drop" (which access fields
+  // by name) or "add_header" (which updates a packet register) are excluded
+  static const std::unordered_set<std::string> primitives = {
+    "assign", "assign_header", "_jump", "_jump_if_zero", "no_op",
+    "modify_field", "add_to_field", "subtract_from_field", "add", "subtract",
+    "bit_and", "bit_or", "bit_xor", "shift_left", "shift_right",
+    "add_header_fast", "copy_header"};
+  return primitives.find(name) != primitives.end();
+}
+
+}  // namespace bm
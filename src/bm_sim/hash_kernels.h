@@ -0,0 +1,232 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// CRC and one's complement sum implementations shared by calculations.cpp and
+// checksums.cpp.
+
+#ifndef BM_SIM_HASH_KERNELS_H_
+#define BM_SIM_HASH_KERNELS_H_
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BM_HASH_KERNELS_SSE42
+#include <nmmintrin.h>
+#endif
+
+namespace bm {
+
+namespace hash_kernels {
+
+static inline uint64_t load_le64(const unsigned char *p) {
+  uint64_t x;
+  std::memcpy(&x, p, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  x = __builtin_bswap64(x);
+#endif
+  return x;
+}
+
+static inline uint64_t load_be64(const unsigned char *p) {
+  uint64_t x;
+  std::memcpy(&x, p, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  x = __builtin_bswap64(x);
+#endif
+  return x;
+}
+
+template <typename T>
+static inline T reflect(T data, int nbits) {
+  T reflection = 0;
+  for (int bit = 0; bit < nbits; bit++) {
+    if (data & 0x01) reflection |= (static_cast<T>(1) << (nbits - 1 - bit));
+    data >>= 1;
+  }
+  return reflection;
+}
+
+#ifdef BM_HASH_KERNELS_SSE42
+__attribute__((target("sse4.2")))
+static inline uint32_t crc32c_sse42(uint32_t remainder, const unsigned char *p,
+                                    size_t len) {
+  uint64_t r = remainder;
+  for (; len >= 8; p += 8, len -= 8) {
+    uint64_t x;
+    std::memcpy(&x, p, sizeof(x));
+    r = _mm_crc32_u64(r, x);
+  }
+  auto r32 = static_cast<uint32_t>(r);
+  for (; len > 0; p++, len--) r32 = _mm_crc32_u8(r32, *p);
+  return r32;
+}
+#endif
+
+// Table-driven CRC which processes 8 bytes per iteration ("slicing-by-8"): the
+// k-th table gives the contribution of a byte followed by k zero bytes, so the
+// 8 table lookups for a 64-bit word are independent of each other. Works for
+// the usual case where data and remainder are either both reflected or both
+// not reflected; the remainder given to and returned by update() is then in
+// the same (reflected or not) domain. The initial remainder and the final XOR
+// are left to the caller. For CRC-32C, the SSE4.2 crc32 instruction is used
+// instead if the CPU supports it.
+template <typename T>
+class CrcSlicing8 {
+ public:
+  static constexpr int width = sizeof(T) * 8;
+
+  CrcSlicing8(T polynomial, bool reflected)
+      : reflected(reflected) {
+    for (int b = 0; b < 256; b++) {
+      T r;
+      if (reflected) {
+        const T poly = reflect<T>(polynomial, width);
+        r = static_cast<T>(b);
+        for (int bit = 0; bit < 8; bit++)
+          r = (r & 1) ? static_cast<T>((r >> 1) ^ poly) : (r >> 1);
+      } else {
+        r = static_cast<T>(static_cast<T>(b) << (width - 8));
+        for (int bit = 0; bit < 8; bit++) {
+          r = (r & (static_cast<T>(1) << (width - 1))) ?
+              static_cast<T>((r << 1) ^ polynomial) : static_cast<T>(r << 1);
+        }
+      }
+      tables[0][b] = r;
+    }
+    for (int k = 1; k < 8; k++) {
+      for (int b = 0; b < 256; b++)
+        tables[k][b] = advance(tables[k - 1][b]);
+    }
+#ifdef BM_HASH_KERNELS_SSE42
+    // this may run before the CPU model is initialized (static constructors)
+    __builtin_cpu_init();
+    use_sse42 = (width == 32) && reflected && (polynomial == 0x1edc6f41) &&
+        __builtin_cpu_supports("sse4.2");
+#endif
+  }
+
+  T update(T remainder, const char *buf, size_t len) const {
+    auto p = reinterpret_cast<const unsigned char *>(buf);
+#ifdef BM_HASH_KERNELS_SSE42
+    if (use_sse42) {
+      return static_cast<T>(
+          crc32c_sse42(static_cast<uint32_t>(remainder), p, len));
+    }
+#endif
+    return reflected ? update_reflected(remainder, p, len)
+                     : update_normal(remainder, p, len);
+  }
+
+  // table for byte-at-a-time processing of a non-reflected remainder, only
+  // meaningful if the object was built with reflected == false
+  const T *get_byte_table() const { return tables[0]; }
+
+ private:
+  // the remainder after processing one more zero byte
+  T advance(T r) const {
+    if (reflected)
+      return static_cast<T>(shift_right_8(r) ^ tables[0][r & 0xff]);
+    return static_cast<T>(shift_left_8(r) ^ tables[0][top_byte(r)]);
+  }
+
+  // these helpers are needed because shifting by width bits is undefined
+  static T shift_right_8(T r) {
+    return static_cast<T>(static_cast<uint64_t>(r) >> 8);
+  }
+
+  static T shift_left_8(T r) {
+    return static_cast<T>(static_cast<uint64_t>(r) << 8);
+  }
+
+  static unsigned int top_byte(T r) {
+    return static_cast<unsigned int>(r >> (width - 8)) & 0xff;
+  }
+
+  T update_reflected(T r, const unsigned char *p, size_t len) const {
+    for (; len >= 8; p += 8, len -= 8) {
+      const uint64_t x = load_le64(p) ^ static_cast<uint64_t>(r);
+      r = tables[7][x & 0xff] ^ tables[6][(x >> 8) & 0xff] ^
+          tables[5][(x >> 16) & 0xff] ^ tables[4][(x >> 24) & 0xff] ^
+          tables[3][(x >> 32) & 0xff] ^ tables[2][(x >> 40) & 0xff] ^
+          tables[1][(x >> 48) & 0xff] ^ tables[0][x >> 56];
+    }
+    for (; len > 0; p++, len--)
+      r = static_cast<T>(shift_right_8(r) ^ tables[0][(r ^ *p) & 0xff]);
+    return r;
+  }
+
+  T update_normal(T r, const unsigned char *p, size_t len) const {
+    for (; len >= 8; p += 8, len -= 8) {
+      const uint64_t x =
+          load_be64(p) ^ (static_cast<uint64_t>(r) << (64 - width));
+      r = tables[7][x >> 56] ^ tables[6][(x >> 48) & 0xff] ^
+          tables[5][(x >> 40) & 0xff] ^ tables[4][(x >> 32) & 0xff] ^
+          tables[3][(x >> 24) & 0xff] ^ tables[2][(x >> 16) & 0xff] ^
+          tables[1][(x >> 8) & 0xff] ^ tables[0][x & 0xff];
+    }
+    for (; len > 0; p++, len--)
+      r = static_cast<T>(shift_left_8(r) ^ tables[0][top_byte(r) ^ *p]);
+    return r;
+  }
+
+  T tables[8][256];
+  bool reflected;
+  bool use_sse42{false};
+};
+
+// One's complement sum of buf (RFC 1071), folded to 16 bits. The sum is
+// computed on native-endian words, which means that it needs to be interpreted
+// in network byte order, like the packet data: its 2 bytes, in memory order,
+// are the big-endian sum. 32-bit words are accumulated in a 64-bit integer,
+// which cannot overflow for any realistic buffer size, so carries are only
+// folded at the end.
+static inline uint16_t ones_complement_sum(const char *buf, size_t len) {
+  auto p = reinterpret_cast<const unsigned char *>(buf);
+  uint64_t sum = 0;
+  for (; len >= 8; p += 8, len -= 8) {
+    uint64_t x;
+    std::memcpy(&x, p, sizeof(x));
+    sum += (x & 0xffffffff);
+    sum += (x >> 32);
+  }
+  if (len & 4) {
+    uint32_t x;
+    std::memcpy(&x, p, sizeof(x));
+    sum += x;
+    p += 4;
+  }
+  if (len & 2) {
+    uint16_t x;
+    std::memcpy(&x, p, sizeof(x));
+    sum += x;
+    p += 2;
+  }
+  if (len & 1) {
+    // the last byte is padded with zero
+    unsigned char last[2] = {*p, 0};
+    uint16_t x;
+    std::memcpy(&x, last, sizeof(x));
+    sum += x;
+  }
+  while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+  return static_cast<uint16_t>(sum);
+}
+
+}  // namespace hash_kernels
+
+}  // namespace bm
+
+#endif  // BM_SIM_HASH_KERNELS_H_
@@ -87,9 +87,26 @@ HeaderType::push_back_field(const std::string &field_name, int field_bit_width,
   fields_info.insert(
       pos,
       {field_name, field_bit_width, is_signed, is_saturating, is_VL, false});
+  build_extract_plan();
   return offset;
 }
 
+void
+HeaderType::build_extract_plan() {
+  extract_plan.clear();
+  int nbits = 0;
+  for (size_t i = 0; i < fields_info.size(); i++) {
+    const auto &f_info = fields_info[i];
+    if (f_info.is_hidden) break;  // all hidden fields are at the end
+    if (f_info.is_VL) {
+      extract_plan.clear();
+      return;
+    }
+    extract_plan.push_back({static_cast<int>(i), nbits / 8, nbits % 8});
+    nbits += f_info.bitwidth;
+  }
+}
+
 int
 HeaderType::push_back_VL_field(
     const std::string &field_name,
@@ -150,6 +167,8 @@ Header::Header(const std::string &name, p4object_id_t id,
     field_unique_id <<= 32;
     field_unique_id |= i;
     fields.back().set_id(field_unique_id);
+    if (!finfo.is_hidden)
+      fields.back().set_modification_tracker(&unmodified_packet_bytes);
     if (!finfo.is_hidden) nbytes_packet += fields.back().get_nbits();
   }
   assert(nbytes_packet % 8 == 0);
@@ -181,6 +200,8 @@ Header::recompute_nbytes_packet() {
 
 void
 Header::mark_valid() {
+  unmodified_packet_bytes = nullptr;
+  packet_bytes = nullptr;
   valid = true;
   valid_field->set(1);
   if (union_membership) union_membership->make_valid();
@@ -188,6 +209,8 @@ Header::mark_valid() {
 
 void
 Header::mark_invalid() {
+  unmodified_packet_bytes = nullptr;
+  packet_bytes = nullptr;
   valid = false;
   valid_field->set(0);
   if (union_membership) union_membership->make_invalid();
@@ -195,6 +218,7 @@ Header::mark_invalid() {
 
 void
 Header::reset() {
+  packet_bytes = nullptr;
   for (Field &f : fields)
     f.set(0);
 }
@@ -204,6 +228,7 @@ Header::reset_VL_header() {
   if (!is_VL_header()) return;
   int VL_offset = header_type.get_VL_offset();
   auto &VL_f = fields[VL_offset];
+  packet_bytes = nullptr;
   // this works because we only support VL fields whose bitwidth is a multiple
   // of 8
   nbytes_packet -= VL_f.get_nbytes();
@@ -219,19 +244,18 @@ Header::set_written_to(bool written_to_value) {
 void
 Header::extract(const char *data, const PHV &phv) {
   if (is_VL_header()) return extract_VL(data, phv);
-  int hdr_offset = 0;
-  for (Field &f : fields) {
-    if (f.is_hidden()) break;  // all hidden fields are at the end
-    hdr_offset += f.extract(data, hdr_offset);
-    data += hdr_offset / 8;
-    hdr_offset = hdr_offset % 8;
-  }
+  // for byte-aligned fields, this is a memcpy of the field bytes
+  for (const auto &p : header_type.get_extract_plan())
+    fields[p.field_offset].extract(data + p.byte_offset, p.bit_offset);
   mark_valid();
+  unmodified_packet_bytes = data;
+  packet_bytes = data;
 }
 
 template <typename Fn>
 void
 Header::extract_VL_common(const char *data, const Fn &VL_fn) {
+  const char *header_bytes = data;
   int VL_offset = header_type.get_VL_offset();
   int hdr_offset = 0;
   nbytes_packet = 0;
@@ -250,6 +274,8 @@ Header::extract_VL_common(const char *data, const Fn &VL_fn) {
   assert(nbytes_packet % 8 == 0);
   nbytes_packet /= 8;
   mark_valid();
+  unmodified_packet_bytes = header_bytes;
+  packet_bytes = header_bytes;
 }
 
 void
@@ -261,6 +287,9 @@ void
 Header::extract_VL(const char *data, const PHV &phv) {
   static thread_local Data computed_nbits;
   auto VL_fn = [&phv, this]() {
+    int64_t nbits;
+    if (VL_chain && VL_chain->eval(phv, &nbits))
+      return static_cast<int>(nbits);
     VL_expr->eval(phv, &computed_nbits);
     return computed_nbits.get<int>();
   };
@@ -269,7 +298,11 @@ Header::extract_VL(const char *data, const PHV &phv) {
 
 void
 Header::deparse(char *data) const {
-  // TODO(antonin): special case for VL header ?
+  if (!is_VL_header()) {
+    for (const auto &p : header_type.get_extract_plan())
+      fields[p.field_offset].deparse(data + p.byte_offset, p.bit_offset);
+    return;
+  }
   int hdr_offset = 0;
   for (const Field &f : fields) {
     if (f.is_hidden()) break;  // all hidden fields are at the end
@@ -279,6 +312,15 @@ Header::deparse(char *data) const {
   }
 }
 
+bool
+Header::deparse_to_packet(char *data) {
+  if (unmodified_packet_bytes == data) return false;
+  deparse(data);
+  unmodified_packet_bytes = data;
+  packet_bytes = data;
+  return true;
+}
+
 #ifdef BMDEBUG_ON
 void
 Header::set_packet_id(const Debugger::PacketId *id) {
@@ -299,6 +341,8 @@ Header::get_field_full_name(int field_offset) const {
 void
 Header::swap_values(Header *other) {
   std::swap(valid, other->valid);
+  packet_bytes = nullptr;
+  other->packet_bytes = nullptr;
   // cannot do that, would invalidate references
   // std::swap(fields, other.fields);
   for (size_t i = 0; i < fields.size(); i++)
@@ -309,6 +353,7 @@ Header::swap_values(Header *other) {
 
 void
 Header::copy_fields(const Header &src) {
+  packet_bytes = nullptr;
   for (size_t f = 0; f < fields.size(); f++)
     fields[f].copy_value(src.fields[f]);
   // in case header has a VL field
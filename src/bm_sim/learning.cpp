@@ -24,7 +24,11 @@
 #include <bm/bm_sim/phv.h>
 #include <bm/bm_sim/bytecontainer.h>
 #include <bm/bm_sim/transport.h>
+#include <bm/bm_sim/thread_index.h>
 
+#include <array>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 #include <algorithm>
@@ -36,12 +40,32 @@
 #include <condition_variable>
 
 #include <cassert>
+#include <cstring>
 
 namespace bm {
 
 static_assert(sizeof(LearnEngineIface::msg_hdr_t) == 32u,
               "Invalid size for learning notification header");
 
+namespace {
+
+size_t dedup_cache_size = 256;
+
+size_t nb_sample_words(size_t sample_size) {
+  return (sample_size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+}
+
+// the i-th word of the sample, the last word is padded with zeros
+uint64_t sample_word(const ByteContainer &sample, size_t i) {
+  uint64_t word = 0;
+  const size_t offset = i * sizeof(word);
+  memcpy(&word, sample.data() + offset,
+         std::min(sizeof(word), sample.size() - offset));
+  return word;
+}
+
+}  // namespace
+
 class LearnEngine final : public LearnEngineIface {
  public:
   using LearnEngineIface::list_id_t;
@@ -159,6 +183,22 @@ class LearnEngine final : public LearnEngineIface {
 
     void reset_state();
 
+    // each ingress thread stages its samples in one of these slots (several
+    // threads may share the same slot), the transmit thread is in charge of
+    // moving the staged samples to the shared filter and buffer
+    static constexpr size_t nb_staging_slots = 16;
+    // an ingress thread blocks when its slot reaches this size, until the
+    // transmit thread catches up
+    static constexpr size_t max_staged_samples = 1024;
+    // number of generation counters used to invalidate the recent-key caches
+    // when samples are acked, see StagingSlot
+    static constexpr size_t nb_ack_buckets = 1024;
+
+    // uses different bits of the hash than the ones used to index the caches
+    static size_t ack_bucket(size_t hash) {
+      return (hash >> 16) & (nb_ack_buckets - 1);
+    }
+
     LearnList(const LearnList &other) = delete;
     LearnList &operator=(const LearnList &other) = delete;
     LearnList(LearnList &&other) = delete;
@@ -168,7 +208,56 @@ class LearnEngine final : public LearnEngineIface {
     using MutexType = std::mutex;
     using LockType = std::unique_lock<MutexType>;
 
+    // A direct-mapped cache of the samples recently staged in a slot. Once
+    // staged, a sample is either still staged or present in the filter, until
+    // it is acked. Acking a sample bumps the generation of the sample's ack
+    // bucket (and clearing the whole filter bumps ack_epoch), so a cache entry
+    // is valid for as long as both values are unchanged; a valid entry
+    // matching a new sample means that the sample can be dropped right away.
+    // Entries are written with the slot mutex held, but probed without it:
+    // each entry has a sequence number, which is odd while the entry is being
+    // written, and the sample is stored as atomic words, so a probe which
+    // races with a write is simply a miss.
+    struct RecentEntry {
+      // 0 if the entry was never written
+      std::atomic<uint32_t> seq{0};
+      std::atomic<uint32_t> generation{0};
+      std::atomic<uint64_t> epoch{0};
+      std::atomic<size_t> sample_size{0};
+    };
+
+    struct RecentCache {
+      RecentCache(size_t nb_entries, size_t nb_words);
+
+      bool hit(size_t idx, const ByteContainer &sample, uint64_t epoch,
+               uint32_t generation) const;
+      void store(size_t idx, const ByteContainer &sample, uint64_t epoch,
+                 uint32_t generation);
+
+      std::unique_ptr<RecentEntry[]> entries;
+      // nb_words words for each entry
+      std::unique_ptr<std::atomic<uint64_t>[]> words;
+      size_t nb_words;
+    };
+
+    struct StagingSlot {
+      MutexType mutex{};
+      std::condition_variable can_stage{};
+      // the staged samples, stored back to back, and the end offset of each
+      // of them; the storage is reused once the samples have been collected
+      std::vector<char> staged_bytes{};
+      std::vector<size_t> staged_ends{};
+      clock::time_point first_staged{};
+      // allocated on first use (the size of the samples is not known before),
+      // null if the cache is disabled
+      std::atomic<RecentCache *> recent{nullptr};
+      std::unique_ptr<RecentCache> recent_owner{};
+    };
+
    private:
+    void erase_from_filter(LearnFilter::iterator it);
+    bool has_staged_samples() const;
+    void merge_staged_samples();
     void swap_buffers();
     void process_full_buffer(LockType &lock);  // NOLINT(runtime/references)
     void buffer_transmit_loop();
@@ -196,6 +285,22 @@ class LearnEngine final : public LearnEngineIface {
     LearnFilter filter{};
     std::unordered_map<buffer_id_t, FilterPtrs> old_buffers{};
 
+    std::array<StagingSlot, nb_staging_slots> staging_slots{};
+    // set by ingress threads when they stage a sample, reset by the transmit
+    // thread when it collects the staged samples
+    std::atomic<bool> staged_pending{false};
+    std::unique_ptr<std::atomic<uint32_t>[]> ack_generations;
+    std::atomic<uint64_t> ack_epoch{0};
+    // number of RecentEntry per staging slot, a power of 2
+    size_t recent_cache_size;
+    // samples collected from the staging slots but not yet added to the
+    // buffer, because the buffer became full; same layout as in StagingSlot
+    std::vector<char> unmerged_bytes{};
+    std::vector<size_t> unmerged_ends{};
+    size_t unmerged_idx{0};
+    clock::time_point unmerged_since{};
+    ByteContainer merged_sample{};
+
     std::vector<char> buffer_tmp{};
     size_t num_samples_tmp{0};
     mutable std::condition_variable b_can_swap{};
@@ -267,7 +372,15 @@ LearnEngine::LearnList::LearnList(list_id_t list_id, device_id_t device_id,
                                   cxt_id_t cxt_id, size_t max_samples,
                                   unsigned int timeout)
     : list_id(list_id), device_id(device_id), cxt_id(cxt_id),
-      max_samples(max_samples), timeout(timeout), with_timeout(timeout > 0) { }
+      max_samples(max_samples), timeout(timeout), with_timeout(timeout > 0),
+      ack_generations(new std::atomic<uint32_t>[nb_ack_buckets]) {
+  for (size_t i = 0; i < nb_ack_buckets; i++) ack_generations[i] = 0;
+  recent_cache_size = 0;
+  if (dedup_cache_size > 0) {
+    recent_cache_size = 1;
+    while (recent_cache_size < dedup_cache_size) recent_cache_size <<= 1;
+  }
+}
 
 void
 LearnEngine::LearnList::init() {
@@ -351,6 +464,59 @@ LearnEngine::LearnList::process_full_buffer(LockType &lock) {
   b_can_send.notify_one();
 }
 
+LearnEngine::LearnList::RecentCache::RecentCache(size_t nb_entries,
+                                                 size_t nb_words)
+    : entries(new RecentEntry[nb_entries]),
+      words(new std::atomic<uint64_t>[nb_entries * nb_words]()),
+      nb_words(nb_words) { }
+
+bool
+LearnEngine::LearnList::RecentCache::hit(size_t idx,
+                                         const ByteContainer &sample,
+                                         uint64_t epoch,
+                                         uint32_t generation) const {
+  const RecentEntry &entry = entries[idx];
+  const uint32_t seq = entry.seq.load(std::memory_order_acquire);
+  if (seq == 0 || (seq & 1)) return false;
+  bool match = entry.epoch.load(std::memory_order_relaxed) == epoch &&
+      entry.generation.load(std::memory_order_relaxed) == generation &&
+      entry.sample_size.load(std::memory_order_relaxed) == sample.size();
+  const std::atomic<uint64_t> *entry_words = &words[idx * nb_words];
+  for (size_t i = 0; match && i < nb_sample_words(sample.size()); i++) {
+    match = entry_words[i].load(std::memory_order_relaxed) ==
+        sample_word(sample, i);
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return match && entry.seq.load(std::memory_order_relaxed) == seq;
+}
+
+// must be called with the slot mutex held
+void
+LearnEngine::LearnList::RecentCache::store(size_t idx,
+                                           const ByteContainer &sample,
+                                           uint64_t epoch,
+                                           uint32_t generation) {
+  if (nb_sample_words(sample.size()) > nb_words) return;
+  RecentEntry &entry = entries[idx];
+  const uint32_t seq = entry.seq.load(std::memory_order_relaxed);
+  entry.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  entry.epoch.store(epoch, std::memory_order_relaxed);
+  entry.generation.store(generation, std::memory_order_relaxed);
+  entry.sample_size.store(sample.size(), std::memory_order_relaxed);
+  std::atomic<uint64_t> *entry_words = &words[idx * nb_words];
+  for (size_t i = 0; i < nb_sample_words(sample.size()); i++)
+    entry_words[i].store(sample_word(sample, i), std::memory_order_relaxed);
+  entry.seq.store(seq + 2, std::memory_order_release);
+}
+
+// The ingress thread only stages the sample, using a slot which is (almost
+// always) private to the thread. Checking the filter, appending to the buffer
+// and enforcing max_samples is done by the transmit thread, in
+// merge_staged_samples(). The list mutex is only taken (to wake up the
+// transmit thread) when no other sample is waiting to be collected. Samples
+// found in the slot's recent-key cache are duplicates and are dropped without
+// taking the slot mutex.
 void
 LearnEngine::LearnList::add_sample(const PHV &phv) {
   static thread_local ByteContainer sample;
@@ -359,24 +525,107 @@ LearnEngine::LearnList::add_sample(const PHV &phv) {
 
   BMLOG_TRACE("Learning sample for list id {}", list_id);
 
-  LockType lock(mutex);
-
-  const auto it = filter.find(sample);
-  if (it != filter.end()) return;
+  StagingSlot &slot = staging_slots[thread_index() % nb_staging_slots];
+  size_t idx = 0;
+  uint64_t epoch = 0;
+  uint32_t generation = 0;
+  if (recent_cache_size > 0) {
+    const size_t hash = ByteContainerKeyHash()(sample);
+    idx = hash & (recent_cache_size - 1);
+    epoch = ack_epoch.load(std::memory_order_acquire);
+    generation = ack_generations[ack_bucket(hash)].load(
+        std::memory_order_acquire);
+    const RecentCache *cache = slot.recent.load(std::memory_order_acquire);
+    if (cache && cache->hit(idx, sample, epoch, generation)) return;
+  }
 
-  buffer.insert(buffer.end(), sample.begin(), sample.end());
-  num_samples++;
-  auto filter_it = filter.insert(filter.end(), std::move(sample));
-  FilterPtrs &filter_ptrs = old_buffers[buffer_id];
-  filter_ptrs.unacked_count++;
-  filter_ptrs.buffer.push_back(filter_it);
+  {
+    LockType slot_lock(slot.mutex);
+    while (slot.staged_ends.size() >= max_staged_samples)
+      slot.can_stage.wait(slot_lock);
+    if (slot.staged_ends.empty()) slot.first_staged = clock::now();
+    slot.staged_bytes.insert(slot.staged_bytes.end(),
+                             sample.begin(), sample.end());
+    slot.staged_ends.push_back(slot.staged_bytes.size());
+    if (recent_cache_size > 0) {
+      if (!slot.recent_owner) {
+        slot.recent_owner.reset(new RecentCache(
+            recent_cache_size, nb_sample_words(sample.size())));
+        slot.recent.store(slot.recent_owner.get(), std::memory_order_release);
+      }
+      slot.recent_owner->store(idx, sample, epoch, generation);
+    }
+  }
 
-  if (num_samples == 1 && max_samples > 1) {
-    buffer_started = clock::now();
-    // wake transmit thread to update cond var wait time
+  if (!staged_pending.exchange(true, std::memory_order_acq_rel)) {
+    LockType lock(mutex);
     b_can_send.notify_one();
-  } else if (num_samples >= max_samples) {
-    process_full_buffer(lock);
+  }
+}
+
+// the generation is bumped after the sample is removed from the filter, so
+// that an ingress thread cannot validate a cache entry for a sample which is no
+// longer in the filter
+void
+LearnEngine::LearnList::erase_from_filter(LearnFilter::iterator it) {
+  const size_t hash = ByteContainerKeyHash()(*it);
+  filter.erase(it);
+  ack_generations[ack_bucket(hash)].fetch_add(1, std::memory_order_acq_rel);
+}
+
+bool
+LearnEngine::LearnList::has_staged_samples() const {
+  return unmerged_idx < unmerged_ends.size() ||
+      staged_pending.load(std::memory_order_acquire);
+}
+
+// Must be called with the list mutex held. Collects the staged samples if the
+// previous batch has been fully merged, then moves as many samples as possible
+// to the buffer, stopping when the buffer becomes full.
+void
+LearnEngine::LearnList::merge_staged_samples() {
+  if (unmerged_idx == unmerged_ends.size() &&
+      staged_pending.exchange(false, std::memory_order_acq_rel)) {
+    unmerged_bytes.clear();
+    unmerged_ends.clear();
+    unmerged_idx = 0;
+    bool first = true;
+    for (auto &slot : staging_slots) {
+      LockType slot_lock(slot.mutex);
+      if (slot.staged_ends.empty()) continue;
+      if (first || slot.first_staged < unmerged_since)
+        unmerged_since = slot.first_staged;
+      first = false;
+      const size_t base = unmerged_bytes.size();
+      unmerged_bytes.insert(unmerged_bytes.end(), slot.staged_bytes.begin(),
+                            slot.staged_bytes.end());
+      for (size_t end : slot.staged_ends) unmerged_ends.push_back(base + end);
+      slot.staged_bytes.clear();
+      slot.staged_ends.clear();
+      slot.can_stage.notify_all();
+    }
+  }
+
+  while (unmerged_idx < unmerged_ends.size()) {
+    const size_t begin =
+        (unmerged_idx == 0) ? 0 : unmerged_ends[unmerged_idx - 1];
+    const size_t end = unmerged_ends[unmerged_idx++];
+    merged_sample.clear();
+    merged_sample.append(unmerged_bytes.data() + begin, end - begin);
+    if (filter.find(merged_sample) != filter.end()) continue;
+
+    buffer.insert(buffer.end(), merged_sample.begin(), merged_sample.end());
+    num_samples++;
+    auto filter_it = filter.insert(filter.end(), merged_sample);
+    FilterPtrs &filter_ptrs = old_buffers[buffer_id];
+    filter_ptrs.unacked_count++;
+    filter_ptrs.buffer.push_back(filter_it);
+
+    if (num_samples == 1) buffer_started = unmerged_since;
+    if (num_samples >= max_samples) {
+      swap_buffers();
+      break;
+    }
   }
 }
 
@@ -387,6 +636,7 @@ LearnEngine::LearnList::buffer_transmit() {
   clock::time_point now = clock::now();
   while (!stop_transmit_thread &&
          buffer_tmp.size() == 0 &&
+         !has_staged_samples() &&
          (!with_timeout ||
           num_samples == 0 ||
           now < (buffer_started + timeout))) {
@@ -400,6 +650,16 @@ LearnEngine::LearnList::buffer_transmit() {
 
   if (stop_transmit_thread) return;
 
+  if (buffer_tmp.size() == 0 && has_staged_samples()) {
+    merge_staged_samples();
+    now = clock::now();
+    if (buffer_tmp.size() == 0 &&
+        (!with_timeout || num_samples == 0 ||
+         now < (buffer_started + timeout))) {
+      return;  // nothing to send yet
+    }
+  }
+
   if (buffer_tmp.size() == 0) {  // timeout -> we need to swap here
     num_samples_to_send = num_samples;
     swap_buffers();
@@ -475,7 +735,7 @@ LearnEngine::LearnList::ack(buffer_id_t buffer_id,
   FilterPtrs &filter_ptrs = it->second;
   for (int sample_id : sample_ids) {
     // what happens if bad input :(
-    filter.erase(filter_ptrs.buffer[sample_id]);
+    erase_from_filter(filter_ptrs.buffer[sample_id]);
     if (--filter_ptrs.unacked_count == 0) {
       old_buffers.erase(it);
     }
@@ -495,9 +755,10 @@ LearnEngine::LearnList::ack_buffer(buffer_id_t buffer_id) {
   // and the ack clears out the filter
   if (filter_ptrs.unacked_count == filter.size()) {
     filter.clear();
+    ack_epoch.fetch_add(1, std::memory_order_acq_rel);
   } else {  // slow: linear in the number of elements acked
     for (const auto &sample_it : filter_ptrs.buffer) {
-      filter.erase(sample_it);
+      erase_from_filter(sample_it);
     }
   }
   old_buffers.erase(it);
@@ -513,8 +774,23 @@ LearnEngine::LearnList::reset_state() {
   filter.clear();
   old_buffers.clear();
   buffer_tmp.clear();
+  for (auto &slot : staging_slots) {
+    LockType slot_lock(slot.mutex);
+    slot.staged_bytes.clear();
+    slot.staged_ends.clear();
+    slot.can_stage.notify_all();
+  }
+  staged_pending = false;
+  unmerged_bytes.clear();
+  unmerged_ends.clear();
+  unmerged_idx = 0;
+  ack_epoch.fetch_add(1, std::memory_order_acq_rel);
 }
 
+constexpr size_t LearnEngine::LearnList::nb_staging_slots;
+constexpr size_t LearnEngine::LearnList::max_staged_samples;
+constexpr size_t LearnEngine::LearnList::nb_ack_buckets;
+
 LearnEngine::LearnEngine(device_id_t device_id, cxt_id_t cxt_id)
     : device_id(device_id), cxt_id(cxt_id) { }
 
@@ -656,6 +932,16 @@ LearnEngine::reset_state() {
     p.second->reset_state();
 }
 
+void
+LearnEngineIface::set_dedup_cache_size(size_t cache_size) {
+  dedup_cache_size = cache_size;
+}
+
+size_t
+LearnEngineIface::get_dedup_cache_size() {
+  return dedup_cache_size;
+}
+
 std::unique_ptr<LearnEngineIface>
 LearnEngineIface::make(device_id_t device_id, cxt_id_t cxt_id) {
   return std::unique_ptr<LearnEngineIface>(new LearnEngine(device_id, cxt_id));
@@ -23,12 +23,34 @@
 #include <bm/spdlog/sinks/null_sink.h>
 
 #include <memory>
+#include <mutex>
 #include <string>
 
 namespace bm {
 
 spdlog::logger *Logger::logger = nullptr;
 
+std::atomic<uint32_t> Logger::debug_mask{0};
+std::atomic<uint32_t> Logger::trace_mask{0};
+
+namespace {
+
+constexpr const char *subsystem_names[] = {
+  "general", "parser", "deparser", "pipeline", "tables", "actions",
+  "checksums", "target"};
+
+static_assert(sizeof(subsystem_names) / sizeof(subsystem_names[0]) ==
+              static_cast<size_t>(Logger::Subsystem::NUM_SUBSYSTEMS),
+              "Missing subsystem name");
+
+// protects the variables below and the update of the masks
+std::mutex config_mutex;
+uint32_t enabled_subsystems = ~static_cast<uint32_t>(0);
+// false as long as messages go to the null sink
+bool has_sink = false;
+
+}  // namespace
+
 void
 Logger::set_logger_console() {
   unset_logger();
@@ -36,6 +58,11 @@ Logger::set_logger_console() {
   logger = logger_.get();
   set_pattern();
   logger_->set_level(to_spd_level(LogLevel::DEBUG));
+  {
+    std::unique_lock<std::mutex> lock(config_mutex);
+    has_sink = true;
+  }
+  update_masks();
 }
 
 void
@@ -46,6 +73,11 @@ Logger::set_logger_file(const std::string &filename, bool force_flush) {
   logger = logger_.get();
   set_pattern();
   logger_->set_level(to_spd_level(LogLevel::DEBUG));
+  {
+    std::unique_lock<std::mutex> lock(config_mutex);
+    has_sink = true;
+  }
+  update_masks();
 }
 
 void
@@ -55,6 +87,12 @@ Logger::set_pattern() {
 
 void
 Logger::unset_logger() {
+  // the logging macros must stop using the logger before it is dropped
+  {
+    std::unique_lock<std::mutex> lock(config_mutex);
+    has_sink = false;
+  }
+  update_masks();
   spdlog::drop("bmv2");
 }
 
@@ -72,6 +110,58 @@ void
 Logger::set_log_level(LogLevel level) {
   spdlog::logger *logger = get();
   logger->set_level(to_spd_level(level));
+  update_masks();
+}
+
+void
+Logger::set_async(size_t queue_size) {
+  spdlog::set_async_mode(queue_size);
+}
+
+void
+Logger::set_subsystem_enabled(Subsystem subsystem, bool enabled) {
+  {
+    std::unique_lock<std::mutex> lock(config_mutex);
+    if (enabled)
+      enabled_subsystems |= bit(subsystem);
+    else
+      enabled_subsystems &= ~bit(subsystem);
+  }
+  update_masks();
+}
+
+bool
+Logger::is_subsystem_enabled(Subsystem subsystem) {
+  std::unique_lock<std::mutex> lock(config_mutex);
+  return enabled_subsystems & bit(subsystem);
+}
+
+const char *
+Logger::subsystem_name(Subsystem subsystem) {
+  return subsystem_names[static_cast<int>(subsystem)];
+}
+
+bool
+Logger::subsystem_from_name(const std::string &name, Subsystem *subsystem) {
+  for (int i = 0; i < static_cast<int>(Subsystem::NUM_SUBSYSTEMS); i++) {
+    if (name == subsystem_names[i]) {
+      *subsystem = static_cast<Subsystem>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+Logger::update_masks() {
+  namespace spdL = spdlog::level;
+  std::unique_lock<std::mutex> lock(config_mutex);
+  const auto level = get()->level();
+  const uint32_t enabled = has_sink ? enabled_subsystems : 0;
+  debug_mask.store((level <= spdL::debug) ? enabled : 0,
+                   std::memory_order_relaxed);
+  trace_mask.store((level <= spdL::trace) ? enabled : 0,
+                   std::memory_order_relaxed);
 }
 
 spdlog::level::level_enum
@@ -23,7 +23,8 @@
 #include <bm/bm_sim/lookup_structures.h>
 #include <bm/bm_sim/match_key_types.h>
 
-#include <algorithm>  // for std::swap
+#include <algorithm>  // for std::swap, std::upper_bound
+#include <cstring>
 #include <unordered_map>
 #include <vector>
 #include <tuple>
@@ -432,6 +433,159 @@ class TernaryMap : public TernaryLookupStructure {
   size_t nbytes_key;
 };
 
+// Used instead of TernaryMap for small ternary tables. Entries are kept in a
+// contiguous array sorted by (priority, handle), so that a lookup can return
+// as soon as it finds a match. Value and mask are stored as 64-bit words to
+// avoid per-byte comparisons. We do not use the TernaryCache here: for tables
+// this small, the cache mutex costs more than it saves.
+class TernarySortedArray : public TernaryLookupStructure {
+ public:
+  // keys larger than this are handled by TernaryMap
+  static constexpr size_t max_nwords = 8;
+
+  TernarySortedArray(size_t size, size_t nbytes_key)
+      : nbytes_key(nbytes_key), nwords((nbytes_key + 7) / 8) {
+    assert(nwords <= max_nwords);
+    entries.reserve(size);
+    words.reserve(size * nwords * 2);
+  }
+
+  bool lookup(const ByteContainer &key_data,
+              internal_handle_t *handle) const override {
+    uint64_t key_words[max_nwords];
+    load_words(key_data.data(), key_words);
+
+    const uint64_t *w = words.data();
+    for (const auto &entry : entries) {
+      size_t i = 0;
+      // w[i] is the (already masked) value, w[nwords + i] is the mask
+      for (; i < nwords; i++) {
+        if (w[i] != (key_words[i] & w[nwords + i])) break;
+      }
+      if (i == nwords) {
+        *handle = entry.handle;
+        return true;
+      }
+      w += 2 * nwords;
+    }
+    return false;
+  }
+
+  // the entries are scanned once for the whole batch, instead of once per key
+  void lookup_batch(const std::vector<ByteContainer> &keys,
+                    std::vector<internal_handle_t> *handles,
+                    std::vector<bool> *hits) const override {
+    static thread_local std::vector<uint64_t> key_words;
+    static thread_local std::vector<size_t> pending;
+    const size_t nkeys = keys.size();
+    handles->resize(nkeys);
+    hits->assign(nkeys, false);
+    key_words.resize(nkeys * nwords);
+    pending.resize(nkeys);
+    for (size_t k = 0; k < nkeys; k++) {
+      load_words(keys[k].data(), &key_words[k * nwords]);
+      pending[k] = k;
+    }
+
+    const uint64_t *w = words.data();
+    for (const auto &entry : entries) {
+      if (pending.empty()) break;
+      for (size_t p = 0; p < pending.size();) {
+        const size_t k = pending[p];
+        const uint64_t *kw = &key_words[k * nwords];
+        size_t i = 0;
+        for (; i < nwords; i++) {
+          if (w[i] != (kw[i] & w[nwords + i])) break;
+        }
+        if (i == nwords) {
+          (*handles)[k] = entry.handle;
+          (*hits)[k] = true;
+          pending[p] = pending.back();
+          pending.pop_back();
+        } else {
+          p++;
+        }
+      }
+      w += 2 * nwords;
+    }
+  }
+
+  bool entry_exists(const TernaryMatchKey &key) const override {
+    return find_entry(key) >= 0;
+  }
+
+  bool retrieve_handle(const TernaryMatchKey &key,
+                       internal_handle_t *handle) const override {
+    auto idx = find_entry(key);
+    if (idx < 0) return false;
+    *handle = entries[idx].handle;
+    return true;
+  }
+
+  void add_entry(const TernaryMatchKey &key,
+                 internal_handle_t handle) override {
+    Entry entry{key.priority, handle};
+    auto it = std::upper_bound(entries.begin(), entries.end(), entry);
+    auto idx = std::distance(entries.begin(), it);
+    entries.insert(it, entry);
+
+    uint64_t entry_words[2 * max_nwords];
+    load_words(key.data.data(), &entry_words[0]);
+    load_words(key.mask.data(), &entry_words[nwords]);
+    words.insert(words.begin() + idx * 2 * nwords,
+                 &entry_words[0], &entry_words[2 * nwords]);
+  }
+
+  void delete_entry(const TernaryMatchKey &key) override {
+    auto idx = find_entry(key);
+    assert(idx >= 0);
+    entries.erase(entries.begin() + idx);
+    auto first = words.begin() + idx * 2 * nwords;
+    words.erase(first, first + 2 * nwords);
+  }
+
+  void clear() override {
+    entries.clear();
+    words.clear();
+  }
+
+ private:
+  struct Entry {
+    int priority;
+    internal_handle_t handle;
+
+    bool operator<(const Entry &other) const {
+      return std::tie(priority, handle) <
+          std::tie(other.priority, other.handle);
+    }
+  };
+
+  // the last word is zero-padded
+  void load_words(const char *bytes, uint64_t *dst) const {
+    dst[nwords - 1] = 0;
+    std::memcpy(dst, bytes, nbytes_key);
+  }
+
+  int find_entry(const TernaryMatchKey &key) const {
+    uint64_t entry_words[2 * max_nwords];
+    load_words(key.data.data(), &entry_words[0]);
+    load_words(key.mask.data(), &entry_words[nwords]);
+    const size_t entry_size = 2 * nwords * sizeof(uint64_t);
+    for (size_t idx = 0; idx < entries.size(); idx++) {
+      if (entries[idx].priority != key.priority) continue;
+      if (!std::memcmp(&words[idx * 2 * nwords], entry_words, entry_size))
+        return static_cast<int>(idx);
+    }
+    return -1;
+  }
+
+  size_t nbytes_key;
+  size_t nwords;
+  std::vector<Entry> entries{};
+  // value and mask words for entries[i] start at words[2 * nwords * i]
+  std::vector<uint64_t> words{};
+};
+
 class RangeMap : public RangeLookupStructure {
  public:
   RangeMap(size_t size, size_t nbytes_key, bool enable_cache = true)
@@ -537,6 +691,11 @@ LookupStructureFactory::create_for_LPM(size_t size, size_t nbytes_key) {
 
 std::unique_ptr<TernaryLookupStructure>
 LookupStructureFactory::create_for_ternary(size_t size, size_t nbytes_key) {
+  if (size <= small_ternary_max_size && nbytes_key > 0 &&
+      nbytes_key <= TernarySortedArray::max_nwords * 8) {
+    return std::unique_ptr<TernaryLookupStructure>(
+        new TernarySortedArray(size, nbytes_key));
+  }
   return std::unique_ptr<TernaryLookupStructure>(
       new TernaryMap(size, nbytes_key, enable_ternary_cache));
 }
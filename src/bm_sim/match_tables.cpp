@@ -18,6 +18,8 @@
  *
  */
 
+#define BMLOG_SUBSYSTEM TABLES
+
 #include <bm/bm_sim/_assert.h>
 #include <bm/bm_sim/match_tables.h>
 #include <bm/bm_sim/logger.h>
@@ -89,7 +91,9 @@ MatchTableAbstract::MatchTableAbstract(
     MatchUnitAbstract_ *mu)
     : NamedP4Object(name, id),
       with_counters(with_counters), with_ageing(with_ageing),
-      match_unit_(mu) { }
+      match_unit_(mu) {
+  if (with_counters) match_unit_->enable_counter_sharding();
+}
 
 const ControlFlowNode *
 MatchTableAbstract::apply_action(Packet *pkt) {
@@ -101,7 +105,42 @@ MatchTableAbstract::apply_action(Packet *pkt) {
   auto lock_impl = lock_impl_read();
 
   const ActionEntry &action_entry = lookup(*pkt, &hit, &handle, &next_node);
+  execute_action(pkt, action_entry, hit, handle);
+  return next_node;
+}
+
+void
+MatchTableAbstract::apply_action_batch(
+    const std::vector<Packet *> &pkts,
+    std::vector<const ControlFlowNode *> *next_nodes) {
+  static thread_local std::vector<LookupResult> results;
+  results.clear();
+
+  auto lock = lock_read();
+  auto lock_impl = lock_impl_read();
+
+  lookup_batch(pkts, &results);
+  for (size_t i = 0; i < pkts.size(); i++) {
+    const auto &res = results[i];
+    execute_action(pkts[i], *res.action_entry, res.hit, res.handle);
+    next_nodes->push_back(res.next_node);
+  }
+}
+
+void
+MatchTableAbstract::lookup_batch(const std::vector<Packet *> &pkts,
+                                 std::vector<LookupResult> *results) {
+  for (auto pkt : pkts) {
+    LookupResult res;
+    res.action_entry = &lookup(*pkt, &res.hit, &res.handle, &res.next_node);
+    results->push_back(res);
+  }
+}
 
+void
+MatchTableAbstract::execute_action(Packet *pkt,
+                                   const ActionEntry &action_entry, bool hit,
+                                   entry_handle_t handle) {
   // TODO(antonin): I hate this part, which requires this class to know that the
   // lower 24 bits of the handle are used as an index. Is is expected that few
   // people will ever use this index, but it is required for the implementation
@@ -136,8 +175,6 @@ MatchTableAbstract::apply_action(Packet *pkt) {
   BMLOG_DEBUG_PKT(*pkt, "Action entry is {}", action_entry);
 
   action_entry.action_fn(pkt);
-
-  return next_node;
 }
 
 void
@@ -299,6 +336,31 @@ MatchTableAbstract::sweep_entries(std::vector<entry_handle_t> *entries) const {
   match_unit_->sweep_entries(entries);
 }
 
+void
+MatchTableAbstract::take_ttl_updates(std::vector<entry_handle_t> *handles) {
+  // does not need the table lock (and must not take it in write mode, which
+  // would invalidate the flow caches), the match unit protects the updates
+  match_unit_->take_ttl_updates(handles);
+}
+
+void
+MatchTableAbstract::get_entries_expiry(
+    const std::vector<entry_handle_t> &handles,
+    std::vector<uint64_t> *expiry_ms) const {
+  auto lock = lock_read();
+  match_unit_->get_entries_expiry(handles, expiry_ms);
+}
+
+bool
+MatchTableAbstract::get_flow_cache_fields(FlowCacheFields *fields) const {
+  // counters, meters and ageing are updated for every lookup, and the choice
+  // of an action selector member depends on its hash inputs
+  if (with_counters || with_meters || with_ageing) return false;
+  if (get_table_type() == MatchTableType::INDIRECT_WS) return false;
+  match_unit_->get_match_key_builder().get_flow_cache_fields(fields);
+  return true;
+}
+
 MatchTableAbstract::handle_iterator
 MatchTableAbstract::handles_begin() const {
   auto lock = lock_read();
@@ -328,15 +390,13 @@ MatchTableAbstract::get_next_node_default(p4object_id_t action_id) const {
 void
 MatchTableAbstract::set_entry_common_info(EntryCommon *entry) const {
   if (!with_ageing) return;
-  using std::chrono::duration_cast;
-  using std::chrono::milliseconds;
   // when retrieving many entries, the clock is read many times; but this is the
   // most readable solution IMO
-  auto tp = Packet::clock::now();
-  auto now_ms = duration_cast<milliseconds>(tp.time_since_epoch()).count();
+  auto now_ms = Clock::get_millis(Clock::Consumer::AGEING);
   MatchUnit::EntryMeta &meta = match_unit_->get_entry_meta(entry->handle);
   entry->timeout_ms = meta.timeout_ms;
-  entry->time_since_hit_ms = now_ms - meta.ts.get_ms();
+  const auto ts_ms = meta.ts.get_ms();
+  entry->time_since_hit_ms = (now_ms > ts_ms) ? (now_ms - ts_ms) : 0;
 }
 
 std::string
@@ -367,6 +427,20 @@ MatchTable::lookup(const Packet &pkt, bool *hit, entry_handle_t *handle,
   return entry;
 }
 
+void
+MatchTable::lookup_batch(const std::vector<Packet *> &pkts,
+                         std::vector<LookupResult> *results) {
+  static thread_local
+      std::vector<MatchUnitAbstract<ActionEntry>::MatchUnitLookup> mu_results;
+  mu_results.clear();
+  match_unit->lookup_batch(pkts, &mu_results);
+  for (const auto &mu_res : mu_results) {
+    const bool hit = mu_res.found();
+    const auto &entry = hit ? (*mu_res.value) : default_entry;
+    results->push_back({&entry, mu_res.handle, hit, entry.next_node});
+  }
+}
+
 MatchErrorCode
 MatchTable::add_entry(const std::vector<MatchKeyParam> &match_key,
                       const ActionFn *action_fn,
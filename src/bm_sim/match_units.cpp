@@ -18,9 +18,12 @@
  *
  */
 
+#define BMLOG_SUBSYSTEM TABLES
+
 #include <bm/bm_sim/_assert.h>
 #include <bm/bm_sim/action_entry.h>
 #include <bm/bm_sim/action_profile.h>
+#include <bm/bm_sim/flow_cache.h>
 #include <bm/bm_sim/match_units.h>
 #include <bm/bm_sim/match_key_types.h>
 #include <bm/bm_sim/logger.h>
@@ -125,14 +128,13 @@ MatchKeyBuilder::build() {
   }
   key_input.swap(new_input);
 
-  std::vector<size_t> offsets;
   size_t curr_offset = 0;
   for (const auto &f_info : key_input) {
-    offsets.push_back(curr_offset);
+    imp_offsets.push_back(curr_offset);
     curr_offset += nbits_to_nbytes(f_info.nbits);
   }
   for (size_t i = 0; i < key_mapping.size(); i++)
-    key_offsets.push_back(offsets[key_mapping[i]]);
+    key_offsets.push_back(imp_offsets[key_mapping[i]]);
 
   big_mask = ByteContainer(nbytes_key);
   for (size_t i = 0; i < key_offsets.size(); i++)
@@ -189,27 +191,34 @@ MatchKeyBuilder::apply_big_mask(ByteContainer *key) const {
     key->apply_mask(big_mask);
 }
 
+// The key is written in place, at the offsets computed in build(), which
+// avoids growing the container one field at a time. Callers are expected to
+// re-use the same container across lookups, in which case the resize is a
+// no-op.
 void
 MatchKeyBuilder::operator()(const PHV &phv, ByteContainer *key) const {
-  for (const auto &in : key_input) {
+  assert(built);
+  key->resize(nbytes_key);
+  char *dst = key->data();
+  for (size_t i = 0; i < key_input.size(); i++) {
+    const auto &in = key_input[i];
+    char *f_dst = dst + imp_offsets[i];
     const Header &header = phv.get_header(in.header);
-    // if speed is an issue here, I can probably come up with something faster
-    // (with a switch statement maybe)
     if (in.mtype == MatchKeyParam::Type::VALID) {
-      key->push_back(header.is_valid() ? '\x01' : '\x00');
-    } else {
-      // we do not reset all fields to 0 in between packets
-      // so I need this hack if the P4 programmer assumed that:
-      // field not valid => field set to 0
-      // for hidden fields, we want the actual value, even though for $valid$,
-      // it does not make a difference
-      const Field &field = header[in.f_offset];
-      if (header.is_valid() || field.is_hidden()) {
-        key->append(field.get_bytes());
-      } else {
-        key->append(std::string(field.get_nbytes(), '\x00'));
-      }
+      *f_dst = header.is_valid() ? '\x01' : '\x00';
+      continue;
     }
+    // we do not reset all fields to 0 in between packets
+    // so I need this hack if the P4 programmer assumed that:
+    // field not valid => field set to 0
+    // for hidden fields, we want the actual value, even though for $valid$,
+    // it does not make a difference
+    const Field &field = header[in.f_offset];
+    const size_t f_nbytes = nbits_to_nbytes(in.nbits);
+    if (header.is_valid() || field.is_hidden())
+      std::memcpy(f_dst, field.get_bytes().data(), f_nbytes);
+    else
+      std::memset(f_dst, 0, f_nbytes);
   }
   if (has_big_mask)
     key->apply_mask(big_mask);
@@ -231,6 +240,16 @@ MatchKeyBuilder::key_to_fields(const ByteContainer &key) const {
   return fields;
 }
 
+void
+MatchKeyBuilder::get_flow_cache_fields(FlowCacheFields *fields) const {
+  for (const auto &in : key_input) {
+    if (in.mtype == MatchKeyParam::Type::VALID)
+      fields->push_back_valid(in.header);
+    else
+      fields->push_back_field(in.header, in.f_offset);
+  }
+}
+
 // TODO(antonin): re-use above function instead?
 std::string
 MatchKeyBuilder::key_to_string(const ByteContainer &key, std::string separator,
@@ -700,6 +719,12 @@ MatchUnitAbstract_::reset_counters() {
   }
 }
 
+void
+MatchUnitAbstract_::enable_counter_sharding() {
+  shard_counters = true;
+  for (EntryMeta &meta : entry_meta) meta.counter.enable_sharding();
+}
+
 void
 MatchUnitAbstract_::set_direct_meters(MeterArray *meter_array) {
   assert(meter_array);
@@ -720,20 +745,47 @@ MatchUnitAbstract_::set_entry_ttl(entry_handle_t handle, unsigned int ttl_ms) {
   meta.timeout_ms = ttl_ms;
   // reset timestamp so that entries are not aged right away even if they have
   // not been hit in a while (i.e. timeout starts now)
-  meta.ts.set(Packet::clock::now());
+  meta.ts.set(Clock::get_millis(Clock::Consumer::AGEING));
+  std::unique_lock<std::mutex> lock(ttl_updates_mutex);
+  ttl_updates.push_back(handle);
   return MatchErrorCode::SUCCESS;
 }
 
 void
-MatchUnitAbstract_::sweep_entries(std::vector<entry_handle_t> *entries) const {
-  using std::chrono::duration_cast;
-  using std::chrono::milliseconds;
+MatchUnitAbstract_::take_ttl_updates(std::vector<entry_handle_t> *handles) {
+  handles->clear();
+  std::unique_lock<std::mutex> lock(ttl_updates_mutex);
+  handles->swap(ttl_updates);
+}
+
+void
+MatchUnitAbstract_::get_entries_expiry(
+    const std::vector<entry_handle_t> &handles,
+    std::vector<uint64_t> *expiry_ms) const {
+  expiry_ms->clear();
+  expiry_ms->reserve(handles.size());
+  for (auto handle : handles) {
+    internal_handle_t handle_ = HANDLE_INTERNAL(handle);
+    if (!this->valid_handle_(handle_)) {
+      expiry_ms->push_back(0);
+      continue;
+    }
+    const EntryMeta &meta = entry_meta[handle_];
+    if (meta.version != HANDLE_VERSION(handle) || meta.timeout_ms == 0) {
+      expiry_ms->push_back(0);
+      continue;
+    }
+    expiry_ms->push_back(meta.ts.get_ms() + meta.timeout_ms);
+  }
+}
 
-  auto tp = Packet::clock::now();
-  uint64_t now_ms = duration_cast<milliseconds>(tp.time_since_epoch()).count();
+void
+MatchUnitAbstract_::sweep_entries(std::vector<entry_handle_t> *entries) const {
+  uint64_t now_ms = Clock::get_millis(Clock::Consumer::AGEING);
   for (auto it = handles.begin(); it != handles.end(); ++it) {
     const EntryMeta &meta = entry_meta[*it];
-    assert(now_ms >= meta.ts.get_ms());
+    // with a coarse clock, the entry may have been hit "after" now_ms
+    if (now_ms < meta.ts.get_ms()) continue;
     if (meta.timeout_ms > 0 && (now_ms - meta.ts.get_ms() >= meta.timeout_ms)) {
       entries->push_back(HANDLE_SET(meta.version, *it));
     }
@@ -785,7 +837,6 @@ template<typename V>
 typename MatchUnitAbstract<V>::MatchUnitLookup
 MatchUnitAbstract<V>::lookup(const Packet &pkt) {
   static thread_local ByteContainer key;
-  key.clear();
   build_key(*pkt.get_phv(), &key);
 
   // BMLOG_DEBUG_PKT(pkt, "Looking up key {}", key_to_string(key));
@@ -800,6 +851,29 @@ MatchUnitAbstract<V>::lookup(const Packet &pkt) {
   return res;
 }
 
+template<typename V>
+void
+MatchUnitAbstract<V>::lookup_batch(const std::vector<Packet *> &pkts,
+                                   std::vector<MatchUnitLookup> *results) {
+  static thread_local std::vector<ByteContainer> keys;
+  keys.resize(pkts.size());
+  for (size_t i = 0; i < pkts.size(); i++) {
+    build_key(*pkts[i]->get_phv(), &keys[i]);
+    BMLOG_DEBUG_PKT(*pkts[i], "Looking up key:\n{}",
+                    key_to_string_with_names(keys[i]));
+  }
+
+  const size_t first = results->size();
+  lookup_key_batch(keys, results);
+  for (size_t i = 0; i < pkts.size(); i++) {
+    const auto &res = (*results)[first + i];
+    if (!res.found()) continue;
+    EntryMeta &meta = entry_meta[HANDLE_INTERNAL(res.handle)];
+    update_counters(&meta.counter, *pkts[i]);
+    update_ts(&meta.ts, *pkts[i]);
+  }
+}
+
 template<typename V>
 MatchErrorCode
 MatchUnitAbstract<V>::add_entry(const std::vector<MatchKeyParam> &match_key,
@@ -873,6 +947,11 @@ MatchUnitAbstract<V>::reset_state() {
   this->num_entries = 0;
   this->handles.clear();
   this->entry_meta = std::vector<EntryMeta>(size);
+  if (this->shard_counters) this->enable_counter_sharding();
+  {
+    std::unique_lock<std::mutex> lock(this->ttl_updates_mutex);
+    this->ttl_updates.clear();
+  }
   reset_state_();
 }
 
@@ -916,6 +995,28 @@ MatchUnitGeneric<K, V>::lookup_key(const ByteContainer &key) const {
   return MatchUnitLookup::empty_entry();
 }
 
+// The values are only accessed once all the keys have been looked up, when the
+// actions are executed, so we prefetch them here.
+template <typename K, typename V>
+void
+MatchUnitGeneric<K, V>::lookup_key_batch(
+    const std::vector<ByteContainer> &keys,
+    std::vector<MatchUnitLookup> *results) const {
+  static thread_local std::vector<internal_handle_t> handles;
+  static thread_local std::vector<bool> hits;
+  lookup_structure->lookup_batch(keys, &handles, &hits);
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (!hits[i]) {
+      results->push_back(MatchUnitLookup::empty_entry());
+      continue;
+    }
+    const Entry &entry = entries[handles[i]];
+    __builtin_prefetch(&entry.value);
+    results->push_back(MatchUnitLookup(
+        HANDLE_SET(entry.key.version, handles[i]), &entry.value));
+  }
+}
+
 // used by add_entry_ and retrieve_handle_
 template <typename K, typename V>
 MatchErrorCode
@@ -1160,6 +1261,10 @@ MatchUnitGeneric<K, V>::deserialize_(std::istream *in, const P4Objects &objs) {
     meta.reset();
     meta.version = version;
     (*in) >> meta.timeout_ms;
+    if (meta.timeout_ms > 0) {
+      std::unique_lock<std::mutex> lock(this->ttl_updates_mutex);
+      this->ttl_updates.push_back(HANDLE_SET(version, handle_));
+    }
     // meta.counter.deserialize(in);
   }
   if (this->direct_meters) this->direct_meters->deserialize(in);
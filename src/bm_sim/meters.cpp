@@ -19,12 +19,14 @@
  */
 
 #include <bm/bm_sim/meters.h>
+#include <bm/bm_sim/clock.h>
 #include <bm/bm_sim/logger.h>
 #include <bm/bm_sim/packet.h>
 
 #include <algorithm>
-#include <vector>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace bm {
 
@@ -35,21 +37,53 @@ using std::chrono::duration_cast;
 
 namespace {
 
-Meter::clock::time_point time_init = Meter::clock::now();
+int64_t
+clock_micros() {
+  return static_cast<int64_t>(Clock::get_micros(Clock::Consumer::METERS));
+}
+
+std::atomic<int64_t> time_init{clock_micros()};
+
+int64_t
+micros_since_init() {
+  return clock_micros() - time_init.load(std::memory_order_relaxed);
+}
 
 }  // namespace
 
+Meter::Meter(MeterType type, size_t rate_count)
+    : type(type), rates(rate_count) {
+  // the highest rate is checked first and gives the "busiest" color
+  for (size_t idx = 0; idx < rate_count; idx++)
+    rates[idx].color = rate_count - idx;
+}
+
+Meter::Meter(Meter &&other) noexcept
+    : type(other.type), m_mutex(std::move(other.m_mutex)),
+      rates(std::move(other.rates)),
+      configured(other.configured.load()) { }
+
+Meter &
+Meter::operator=(Meter &&other) noexcept {
+  type = other.type;
+  m_mutex = std::move(other.m_mutex);
+  rates = std::move(other.rates);
+  configured = other.configured.load();
+  return *this;
+}
+
 MeterErrorCode
 Meter::set_rate(size_t idx, const rate_config_t &config) {
-  MeterRate &rate = rates[idx];
+  const size_t rate_count = rates.size();
+  MeterRate &rate = rates[rate_count - 1 - idx];
   rate.valid = true;
-  rate.info_rate = config.info_rate;
-  rate.burst_size = config.burst_size;
-  rate.tokens = config.burst_size;
-  rate.tokens_last = 0u;
-  rate.color = (idx + 1);
+  rate.info_rate.store(config.info_rate, std::memory_order_relaxed);
+  rate.burst_size.store(config.burst_size, std::memory_order_relaxed);
+  // full bucket
+  rate.tokens_base.store(-static_cast<int64_t>(config.burst_size),
+                         std::memory_order_relaxed);
   if (idx > 0) {
-    MeterRate &prev_rate = rates[idx - 1];
+    MeterRate &prev_rate = rates[rate_count - idx];
     if (prev_rate.info_rate > rate.info_rate) return INVALID_INFO_RATE_VALUE;
   }
   return SUCCESS;
@@ -65,45 +99,51 @@ Meter::reset_rates() {
   return SUCCESS;
 }
 
+/* I tried to make this as accurate as I could. Everything is computed compared
+   to a single time point (init). I do not use the interval since last update,
+   because it would require multiple consecutive approximations. Maybe this is
+   an overkill or I am underestimating the code I wrote for BMv1.
+   The only thing that could go wrong is if the number of tokens generated
+   since init grew too large, but I think it would take years even at high
+   throughput */
+bool
+Meter::MeterRate::consume(int64_t micros_since_init, int64_t input) {
+  const auto tokens_since_init = static_cast<int64_t>(
+      micros_since_init * info_rate.load(std::memory_order_relaxed));
+  const auto burst = static_cast<int64_t>(
+      burst_size.load(std::memory_order_relaxed));
+  int64_t base = tokens_base.load(std::memory_order_relaxed);
+  while (true) {
+    // tokens generated while the bucket was full are lost
+    const int64_t start = std::max(base, tokens_since_init - burst);
+    if (tokens_since_init - start < input) return false;
+    if (tokens_base.compare_exchange_weak(base, start + input,
+                                          std::memory_order_relaxed))
+      return true;
+  }
+}
+
 Meter::color_t
 Meter::execute(const Packet &pkt, color_t pre_color) {
   color_t packet_color = 0;
 
-  if (!configured) return packet_color;
+  if (!configured.load(std::memory_order_acquire)) return packet_color;
 
-  clock::time_point now = clock::now();
-  int64_t micros_since_init = duration_cast<ticks>(now - time_init).count();
+  const int64_t micros = micros_since_init();
+  const int64_t input = (type == MeterType::PACKETS) ?
+      1 : pkt.get_ingress_length();
 
-  auto lock = unique_lock();
-
-  /* I tried to make this as accurate as I could. Everything is computed
-     compared to a single time point (init). I do not use the interval since
-     last update, because it would require multiple consecutive
-     approximations. Maybe this is an overkill or I am underestimating the code
-     I wrote for BMv1.
-     The only thing that could go wrong is if tokens_since_init grew too large,
-     but I think it would take years even at high throughput */
   for (MeterRate &rate : rates) {
-    uint64_t tokens_since_init =
-      static_cast<uint64_t>(micros_since_init * rate.info_rate);
-    assert(tokens_since_init >= rate.tokens_last);
-    size_t new_tokens = tokens_since_init - rate.tokens_last;
-    rate.tokens_last = tokens_since_init;
-    rate.tokens = std::min(rate.tokens + new_tokens, rate.burst_size);
-
-    size_t input = (type == MeterType::PACKETS) ? 1u : pkt.get_ingress_length();
-
-    if (rate.tokens < input) {
+    if (!rate.consume(micros, input)) {
       packet_color = rate.color;
       break;
-    } else {
-      rate.tokens -= input;
     }
   }
 
   return std::max(pre_color, packet_color);
 }
 
+// rates are serialized from higher to smaller rate
 void
 Meter::serialize(std::ostream *out) const {
   auto lock = unique_lock();
@@ -117,20 +157,27 @@ Meter::serialize(std::ostream *out) const {
 void
 Meter::deserialize(std::istream *in) {
   auto lock = unique_lock();
-  (*in) >> configured;
-  if (configured) {
+  bool is_configured;
+  (*in) >> is_configured;
+  if (is_configured) {
     for (size_t i = 0; i < rates.size(); i++) {
       rate_config_t config;
       (*in) >> config.info_rate;
       (*in) >> config.burst_size;
-      set_rate(i, config);
+      set_rate(rates.size() - 1 - i, config);
     }
   }
+  configured = is_configured;
+}
+
+void
+Meter::set_time_resolution(std::chrono::microseconds resolution) {
+  Clock::set_resolution(Clock::Consumer::METERS, resolution);
 }
 
 void
 Meter::reset_global_clock() {
-  time_init = Meter::clock::now();
+  time_init = clock_micros();
 }
 
 std::vector<Meter::rate_config_t>
@@ -138,10 +185,8 @@ Meter::get_rates() const {
   std::vector<rate_config_t> configs;
   auto lock = unique_lock();
   if (!configured) return configs;
-  // elegant but probably not the most efficient
-  for (const MeterRate &rate : rates)
-    configs.push_back(rate_config_t::make(rate.info_rate, rate.burst_size));
-  std::reverse(configs.begin(), configs.end());
+  for (auto it = rates.rbegin(); it != rates.rend(); ++it)
+    configs.push_back(rate_config_t::make(it->info_rate, it->burst_size));
   return configs;
 }
 
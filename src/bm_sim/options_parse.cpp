@@ -19,9 +19,11 @@
  */
 
 #include <bm/bm_sim/options_parse.h>
+#include <bm/bm_sim/clock.h>
 #include <bm/bm_sim/event_logger.h>
 #include <bm/bm_sim/logger.h>
 #include <bm/bm_sim/P4Objects.h>
+#include <bm/bm_sim/shm_ring.h>
 
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
@@ -30,6 +32,7 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <unordered_map>
 
 #include <cassert>
@@ -114,8 +117,14 @@ OptionsParser::parse(int argc, char *argv[], TargetParserIface *tp,
       ("device-id", po::value<device_id_t>(),
        "Device ID, used to identify the device in IPC messages (default 0)")
       ("nanolog", po::value<std::string>(),
-       "IPC socket to use for nanomsg pub/sub logs "
+       "IPC socket to use for nanomsg pub/sub logs, or shm://<name> to use "
+       "a shared memory ring in /dev/shm/<name> instead "
        "(default: no nanomsg logging")
+      ("nanolog-ring-size", po::value<size_t>(),
+       "If non-zero, the event logger is asynchronous: each thread writes "
+       "events to its own ring, which can hold this many events, and several "
+       "events are published in each message; events are dropped when a ring "
+       "is full; default is 0 (one synchronous message per event)")
       ("log-console",
        "Enable logging on stdout")
       ("log-file", po::value<std::string>(),
@@ -125,12 +134,30 @@ OptionsParser::parse(int argc, char *argv[], TargetParserIface *tp,
        "'trace', 'debug', 'info', 'warn', 'error', off'; default is 'trace'")
       ("log-flush", "If used with '--log-file', the logger will flush to disk "
        "after every log message")
+      ("log-async", po::value<size_t>(),
+       "Format and write log messages in a background thread, which receives "
+       "them through a queue of this many messages (must be a power of 2)")
+      ("log-disable-subsystem",
+       po::value<std::vector<std::string> >()->composing(),
+       "Disable debug and trace messages for this subsystem, one of "
+       "'general', 'parser', 'deparser', 'pipeline', 'tables', 'actions', "
+       "'checksums' and 'target'; can be repeated; subsystems can also be "
+       "enabled and disabled at runtime through the Thrift runtime")
 #ifdef BMNANOMSG_ON
       ("notifications-addr", po::value<std::string>(),
        "Specify the nanomsg address to use for notifications "
-       "(e.g. learning, ageing, ...); "
+       "(e.g. learning, ageing, ...), or shm://<name> to use a shared memory "
+       "ring in /dev/shm/<name>, for a single consumer on the same host; "
        "default is ipc:///tmp/bmv2-<device-id>-notifications.ipc")
 #endif
+      ("shm-replace", "Replace the shared memory rings used for shm:// "
+       "addresses even if they were not closed, i.e. if they are still in "
+       "use by another switch or if their switch crashed; without this "
+       "option, the switch exits in this case")
+      ("shm-mode", po::value<std::string>(),
+       "Permissions (in octal) of the shared memory rings used for shm:// "
+       "addresses, which determine which users can read the notifications "
+       "and events; default is 0600 (only the user running the switch)")
 #ifdef BMDEBUG_ON
       ("debugger", "Activate debugger")
       ("debugger-addr", po::value<std::string>(),
@@ -150,6 +177,38 @@ OptionsParser::parse(int argc, char *argv[], TargetParserIface *tp,
        "<major>.<minor>; all bmv2 JSON versions with the same <major> version "
        "number are also supported.")
       ("no-p4", "Enable the switch to start without an inout configuration")
+      ("incremental-checksums", "Update 16-bit one's complement checksums "
+       "incrementally (RFC 1624) instead of recomputing them when deparsing, "
+       "when all the fields they cover come from packet headers (e.g. IPv4 "
+       "and UDP checksums, but not TCP checksums, which use a TCP length "
+       "computed into metadata); this assumes that the checksums of incoming "
+       "packets are correct")
+      ("counter-shards", po::value<size_t>(),
+       "Number of per-thread cells used by each counter of counter arrays "
+       "and of tables with counters, which are added together when the "
+       "counter is read; using more than one cell avoids contention when "
+       "several packet processing threads update the same counters; default "
+       "is 1")
+      ("meter-time-resolution", po::value<unsigned int>(),
+       "If non-zero, meters read the current time from a shared timestamp "
+       "refreshed every <value> microseconds instead of reading the system "
+       "clock for every packet, which means that colors may be computed "
+       "with up to <value> microseconds of delay; default is 0")
+      ("learn-dedup-cache-size", po::value<size_t>(),
+       "Number of recently learned samples remembered by each packet "
+       "processing thread for each learn list, used to drop duplicate learn "
+       "samples without locking; 0 disables the cache; default is 256")
+      ("flow-cache-size", po::value<size_t>(),
+       "If non-zero, each pipeline caches, for up to <value> flows, the result "
+       "of sending a packet through its match-action tables, and replays it "
+       "for the next packets of the same flow; packets which hit the cache do "
+       "not generate per-table log messages or events; default is 0")
+      ("clock-resolution", po::value<std::vector<std::string> >()->composing(),
+       "<consumer>=<value>: if <value> is non-zero, <consumer> reads the "
+       "current time from a shared timestamp refreshed every <value> "
+       "microseconds instead of reading the system clock; <consumer> is one "
+       "of 'ageing', 'meters', 'queueing' and 'timestamps'; can be repeated; "
+       "'meters' takes precedence over --meter-time-resolution")
       ;  // NOLINT(whitespace/semicolon)
 
   po::options_description hidden;
@@ -213,6 +272,45 @@ OptionsParser::parse(int argc, char *argv[], TargetParserIface *tp,
   }
 
   no_p4 = vm.count("no-p4");
+  incremental_checksums = vm.count("incremental-checksums");
+  if (vm.count("meter-time-resolution"))
+    meter_time_resolution_us = vm["meter-time-resolution"].as<unsigned int>();
+  if (vm.count("clock-resolution")) {
+    for (const auto &spec :
+             vm["clock-resolution"].as<std::vector<std::string> >()) {
+      auto pos = spec.find('=');
+      std::string consumer = spec.substr(0, pos);
+      unsigned int resolution = 0;
+      bool valid = (pos != std::string::npos) &&
+          (Clock::consumer_from_name(consumer) !=
+           Clock::Consumer::NUM_CONSUMERS);
+      if (valid) {
+        try {
+          resolution = static_cast<unsigned int>(
+              std::stoul(spec.substr(pos + 1)));
+        } catch (const std::exception &) {
+          valid = false;
+        }
+      }
+      if (!valid) {
+        outstream << "Error: invalid --clock-resolution '" << spec
+                  << "', expected <consumer>=<microseconds>\n";
+        exit(1);
+      }
+      clock_resolution_us[consumer] = resolution;
+    }
+  }
+  if (vm.count("learn-dedup-cache-size"))
+    learn_dedup_cache_size = vm["learn-dedup-cache-size"].as<size_t>();
+  if (vm.count("flow-cache-size"))
+    flow_cache_size = vm["flow-cache-size"].as<size_t>();
+  if (vm.count("counter-shards")) {
+    counter_shards = vm["counter-shards"].as<size_t>();
+    if (counter_shards == 0) {
+      outstream << "Error: --counter-shards must be at least 1\n";
+      exit(1);
+    }
+  }
   if (!no_p4 && !vm.count("input-config")) {
     outstream << "Error: please specify an input JSON configuration file\n";
     outstream << "Usage: SWITCH_NAME [options] <path to JSON config file>\n";
@@ -250,6 +348,25 @@ OptionsParser::parse(int argc, char *argv[], TargetParserIface *tp,
   }
 #endif
 
+  shm_replace = vm.count("shm-replace");
+
+  if (vm.count("shm-mode")) {
+    const std::string mode_str = vm["shm-mode"].as<std::string>();
+    size_t pos = 0;
+    unsigned long mode = 0;  // NOLINT(runtime/int)
+    try {
+      mode = std::stoul(mode_str, &pos, 8);
+    } catch (const std::exception &) {
+      pos = 0;
+    }
+    if (pos == 0 || pos != mode_str.size() || mode > 0777) {
+      outstream << "Error: invalid value for --shm-mode: '" << mode_str
+                << "', expected octal permissions such as 0600\n";
+      exit(1);
+    }
+    shm_mode = static_cast<unsigned int>(mode);
+  }
+
   if (vm.count("nanolog")) {
 #ifndef BMELOG_ON
     outstream << "Warning: you requested the nanomsg event logger, but bmv2 "
@@ -257,9 +374,16 @@ OptionsParser::parse(int argc, char *argv[], TargetParserIface *tp,
               << "be activated\n";
 #else
     event_logger_addr = vm["nanolog"].as<std::string>();
-    auto event_transport = TransportIface::make_nanomsg(event_logger_addr);
+    if (vm.count("nanolog-ring-size"))
+      nanolog_ring_size = vm["nanolog-ring-size"].as<size_t>();
+    std::string shm_name;
+    auto event_transport = ShmRing::parse_addr(event_logger_addr, &shm_name) ?
+        TransportIface::make_shm(shm_name, TransportIface::default_shm_capacity,
+                                 shm_replace, shm_mode) :
+        TransportIface::make_nanomsg(event_logger_addr);
     event_transport->open();
-    EventLogger::init(std::move(event_transport), device_id);
+    EventLogger::init(std::move(event_transport), device_id,
+                      nanolog_ring_size);
 #endif
   }
 
@@ -308,6 +432,29 @@ OptionsParser::parse(int argc, char *argv[], TargetParserIface *tp,
               << "missing most messages\n";
   }
 
+  if (vm.count("log-async")) {
+    log_async_queue_size = vm["log-async"].as<size_t>();
+    if (log_async_queue_size == 0 ||
+        (log_async_queue_size & (log_async_queue_size - 1)) != 0) {
+      outstream << "Error: --log-async must be a power of 2\n";
+      exit(1);
+    }
+  }
+
+  if (vm.count("log-disable-subsystem")) {
+    for (const auto &name :
+             vm["log-disable-subsystem"].as<std::vector<std::string> >()) {
+      Logger::Subsystem subsystem;
+      if (!Logger::subsystem_from_name(name, &subsystem)) {
+        outstream << "Invalid value " << name
+                  << " for --log-disable-subsystem\n"
+                  << "Run with -h to see possible values\n";
+        exit(1);
+      }
+      log_disabled_subsystems.push_back(subsystem);
+    }
+  }
+
   if (vm.count("log-flush")) {
     if (!vm.count("log-file")) {
       outstream << "Ignoring --log-flush option because --log-file "
@@ -19,6 +19,7 @@
  */
 
 #include <bm/bm_sim/packet.h>
+#include <bm/bm_sim/clock.h>
 #include <bm/bm_sim/phv.h>
 
 #include <algorithm>  // for swap
@@ -84,9 +85,7 @@ Packet::update_signature(uint64_t seed) {
 
 void
 Packet::set_ingress_ts() {
-  ingress_ts = clock::now();
-  ingress_ts_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-    ingress_ts.time_since_epoch()).count();
+  ingress_ts_ms = Clock::get_millis(Clock::Consumer::AGEING);
 }
 
 Packet::Packet(cxt_id_t cxt_id, port_t ingress_port, packet_id_t id,
@@ -215,7 +214,7 @@ Packet::Packet(Packet &&other) noexcept
       egress_port(other.egress_port), packet_id(other.packet_id),
       copy_id(other.copy_id), ingress_length(other.ingress_length),
       signature(other.signature), payload_size(other.payload_size),
-      ingress_ts(other.ingress_ts), ingress_ts_ms(other.ingress_ts_ms),
+      ingress_ts_ms(other.ingress_ts_ms),
   phv_source(other.phv_source), registers(other.registers) {
   buffer = std::move(other.buffer);
   phv = std::move(other.phv);
@@ -231,7 +230,6 @@ Packet::operator=(Packet &&other) noexcept {
   ingress_length = other.ingress_length;
   signature = other.signature;
   payload_size = other.payload_size;
-  ingress_ts = other.ingress_ts;
   ingress_ts_ms = other.ingress_ts_ms;
   phv_source = other.phv_source;
   registers = other.registers;
@@ -18,6 +18,8 @@
  *
  */
 
+#define BMLOG_SUBSYSTEM PARSER
+
 #include <bm/bm_sim/parser.h>
 #include <bm/bm_sim/debugger.h>
 #include <bm/bm_sim/packet.h>
@@ -29,9 +31,14 @@
 #include <bm/bm_sim/checksums.h>
 #include <bm/bm_sim/core/primitives.h>
 
+#include <algorithm>
+#include <array>
+#include <bitset>
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <mutex>
 
 #include "extract.h"
@@ -107,6 +114,9 @@ ParserOpSet<ParserLookAhead>::operator()(Packet *pkt, const char *data,
   if (src.bitwidth == f_bits) {
     data += src.byte_offset;
     f_dst.extract(data, src.bit_offset);
+  } else if (src.bitwidth <= 64) {
+    f_dst.set(extract::extract_uint64(data + src.byte_offset, src.bit_offset,
+                                      src.bitwidth));
   } else {
     bc.clear();
     src.peek(data, &bc);
@@ -249,15 +259,38 @@ void extract_fixed(Header *hdr,
   *bytes_parsed += hdr->get_nbytes_packet();
 }
 
+// Computes the bitwidth of the VL field for extract_VL. The length expression
+// is usually a scaled field (e.g. (ihl - 5) * 32 for IPv4 options), in which
+// case we compute it with integer arithmetic instead of going through the
+// generic expression evaluator.
+class VLLengthExpression {
+ public:
+  VLLengthExpression() = default;
+
+  explicit VLLengthExpression(const ArithExpression &expr)
+      : expr(expr), is_chain(expr.get_field_chain(&chain)) { }
+
+  int eval(const PHV &phv) const {
+    static thread_local Data computed_nbits;
+    int64_t nbits;
+    if (is_chain && chain.eval(phv, &nbits)) return static_cast<int>(nbits);
+    expr.eval(phv, &computed_nbits);
+    return computed_nbits.get<int>();
+  }
+
+ private:
+  ArithExpression expr{};
+  FieldChainExpression chain{};
+  bool is_chain{false};
+};
+
 void extract_VL(Header *hdr,
-                const ArithExpression &VL_expr, size_t max_header_bytes,
+                const VLLengthExpression &VL_expr, size_t max_header_bytes,
                 Packet *pkt, const char *data, size_t *bytes_parsed) {
-  static thread_local Data computed_nbits;
   auto phv = pkt->get_phv();
   BMELOG(parser_extract, *pkt, hdr->get_id());
 
-  VL_expr.eval(*phv, &computed_nbits);
-  auto nbits = computed_nbits.get<int>();
+  auto nbits = VL_expr.eval(*phv);
   // TODO(antonin): temporary limitation?
   assert(nbits % 8 == 0 && "VL field bitwidth needs to be a multiple of 8");
   // get_nbytes_packet counts the VL field in the header as 0 bits
@@ -295,7 +328,7 @@ struct ParserOpExtract : ParserOp {
 // stack extracts below.
 struct ParserOpExtractVL : ParserOp {
   header_id_t header;
-  ArithExpression field_length_expr;
+  VLLengthExpression field_length_expr;
   size_t max_header_bytes;
 
   explicit ParserOpExtractVL(header_id_t header,
@@ -318,7 +351,7 @@ struct ParserOpExtractVL : ParserOp {
 // push back a header on a tag stack
 struct ParserOpExtractStack : ParserOp {
   header_stack_id_t header_stack;
-  ArithExpression field_length_expr;
+  VLLengthExpression field_length_expr;
   // varbit<0> is not allowed in P4_16; we therefore use max_header_bytes > 0
   // as a signal that extract_VL was used.
   size_t max_header_bytes;
@@ -356,7 +389,7 @@ struct ParserOpExtractStack : ParserOp {
 struct ParserOpExtractUnionStack : ParserOp {
   header_union_stack_id_t header_union_stack;
   size_t header_offset;
-  ArithExpression field_length_expr;
+  VLLengthExpression field_length_expr;
   // varbit<0> is not allowed in P4_16; we therefore use max_header_bytes > 0
   // as a signal that extract_VL was used.
   size_t max_header_bytes;
@@ -639,6 +672,13 @@ class ParseSwitchCase : public ParseSwitchCaseIface {
   bool match(const ByteContainer &input,
              const ParseState **state) const override;
 
+  bool get_exact_cases(
+      std::vector<std::pair<ByteContainer, const ParseState *> > *cases)
+      const override {
+    cases->emplace_back(key, next_state);
+    return true;
+  }
+
  private:
   ByteContainer key;
   const ParseState *next_state; /* NULL if end */
@@ -700,6 +740,94 @@ ParseSwitchCaseWithMask::mask_key() {
     key[byte_index] = key[byte_index] & mask[byte_index];
 }
 
+// A run of consecutive exact cases, which we can look up with a single hash
+// table (or direct-index table for 1-byte keys) access instead of trying each
+// case in turn. Since no other case is interleaved with the ones in the run,
+// this preserves first-match semantics as long as the first case added for a
+// given key is the one we keep.
+class ParseSwitchCaseExactTable : public ParseSwitchCaseIface {
+ public:
+  explicit ParseSwitchCaseExactTable(size_t key_size)
+      : key_size(key_size) { }
+
+  size_t get_key_size() const { return key_size; }
+
+  void add_case(const ByteContainer &key, const ParseState *next_state) {
+    assert(key.size() == key_size);
+    if (key_size == 1) {
+      const auto idx = static_cast<unsigned char>(key[0]);
+      if (direct_valid[idx]) return;
+      direct_valid[idx] = true;
+      direct[idx] = next_state;
+    } else if (key_size <= sizeof(uint64_t)) {
+      // emplace does not overwrite existing keys
+      packed.emplace(pack(key), next_state);
+    } else {
+      cases.emplace(key, next_state);
+    }
+  }
+
+  bool match(const ByteContainer &input,
+             const ParseState **state) const override {
+    if (input.size() != key_size) return false;
+    if (key_size == 1) {
+      const auto idx = static_cast<unsigned char>(input[0]);
+      if (!direct_valid[idx]) return false;
+      *state = direct[idx];
+      return true;
+    } else if (key_size <= sizeof(uint64_t)) {
+      const auto it = packed.find(pack(input));
+      if (it == packed.end()) return false;
+      *state = it->second;
+      return true;
+    }
+    const auto it = cases.find(input);
+    if (it == cases.end()) return false;
+    *state = it->second;
+    return true;
+  }
+
+  // keys are unique within the table, so the order does not matter
+  bool get_exact_cases(
+      std::vector<std::pair<ByteContainer, const ParseState *> > *cases_out)
+      const override {
+    if (key_size == 1) {
+      for (size_t idx = 0; idx < direct.size(); idx++) {
+        if (!direct_valid[idx]) continue;
+        const char c = static_cast<char>(idx);
+        cases_out->emplace_back(ByteContainer(&c, 1), direct[idx]);
+      }
+    } else if (key_size <= sizeof(uint64_t)) {
+      for (const auto &p : packed)
+        cases_out->emplace_back(unpack(p.first), p.second);
+    } else {
+      for (const auto &p : cases) cases_out->push_back(p);
+    }
+    return true;
+  }
+
+ private:
+  static uint64_t pack(const ByteContainer &key) {
+    uint64_t v = 0;
+    for (auto c : key) v = (v << 8) | static_cast<unsigned char>(c);
+    return v;
+  }
+
+  ByteContainer unpack(uint64_t v) const {
+    ByteContainer key(key_size);
+    for (size_t i = key_size; i > 0; i--, v >>= 8)
+      key[i - 1] = static_cast<char>(v & 0xff);
+    return key;
+  }
+
+  size_t key_size;
+  std::array<const ParseState *, 256> direct{};
+  std::bitset<256> direct_valid{};
+  std::unordered_map<uint64_t, const ParseState *> packed{};
+  std::unordered_map<ByteContainer, const ParseState *, ByteContainerKeyHash>
+      cases{};
+};
+
 template <typename P>
 class ParseSwitchCaseVSet : public ParseSwitchCaseIface {
  public:
@@ -876,20 +1004,30 @@ ParseState::set_key_builder(const ParseSwitchKeyBuilder &builder) {
 void
 ParseState::add_switch_case(const ByteContainer &key,
                             const ParseState *next_state) {
-  parser_switch.push_back(ParseSwitchCaseIface::make_case(key, next_state));
+  if (!exact_table_tail || exact_table_tail->get_key_size() != key.size()) {
+    exact_table_tail = new ParseSwitchCaseExactTable(key.size());
+    parser_switch.emplace_back(exact_table_tail);
+  }
+  exact_table_tail->add_case(key, next_state);
 }
 
 void
 ParseState::add_switch_case(int nbytes_key, const char *key,
                             const ParseState *next_state) {
-  parser_switch.push_back(ParseSwitchCaseIface::make_case(
-      ByteContainer(key, nbytes_key), next_state));
+  add_switch_case(ByteContainer(key, nbytes_key), next_state);
 }
 
 void
 ParseState::add_switch_case_with_mask(const ByteContainer &key,
                                       const ByteContainer &mask,
                                       const ParseState *next_state) {
+  // a case with a full mask is an exact case
+  auto is_full = [](char c) { return static_cast<unsigned char>(c) == 0xff; };
+  if (std::all_of(mask.begin(), mask.end(), is_full)) {
+    add_switch_case(key, next_state);
+    return;
+  }
+  exact_table_tail = nullptr;
   parser_switch.push_back(ParseSwitchCaseIface::make_case_with_mask(
       key, mask, next_state));
 }
@@ -898,14 +1036,14 @@ void
 ParseState::add_switch_case_with_mask(int nbytes_key, const char *key,
                                       const char *mask,
                                       const ParseState *next_state) {
-  parser_switch.push_back(ParseSwitchCaseIface::make_case_with_mask(
-      ByteContainer(key, nbytes_key), ByteContainer(mask, nbytes_key),
-      next_state));
+  add_switch_case_with_mask(ByteContainer(key, nbytes_key),
+                            ByteContainer(mask, nbytes_key), next_state);
 }
 
 void
 ParseState::add_switch_case_vset(ParseVSet *vset,
                                  const ParseState *next_state) {
+  exact_table_tail = nullptr;
   parser_switch.push_back(ParseSwitchCaseIface::make_case_vset(
       vset, key_builder.get_bitwidths(), next_state));
 }
@@ -914,6 +1052,7 @@ void
 ParseState::add_switch_case_vset_with_mask(ParseVSet *vset,
                                            const ByteContainer &mask,
                                            const ParseState *next_state) {
+  exact_table_tail = nullptr;
   parser_switch.push_back(ParseSwitchCaseIface::make_case_vset_with_mask(
       vset, mask, key_builder.get_bitwidths(), next_state));
 }
@@ -987,6 +1126,262 @@ ParseState::operator()(Packet *pkt, const char *data,
   return next_state;
 }
 
+// The parse graph lowered to a flat array of states by Parser::compile(), with
+// transitions given as indices in that array. See Parser::compile() for which
+// states are compiled; the other ones are kept as is and run by the
+// interpreter. The successors of an interpreted state are only known at run
+// time: if the interpreter returns a state which is not part of the automaton
+// (i.e. a state only reachable through a value set or masked case), we hand
+// over to the interpreter for the rest of the packet.
+class ParserAutomaton {
+ public:
+  ParserAutomaton(const ParseState *init_state, const PHVFactory &phv_factory);
+
+  // returns nullptr if the packet was accepted, or the next state to be run
+  // by the interpreter
+  const ParseState *run(const Parser &parser, Packet *pkt, const char *data,
+                        size_t *bytes_parsed) const;
+
+ private:
+  static constexpr int kAccept = -1;
+
+  struct Extract {
+    header_id_t header;
+    // offset of the header from the start of the state
+    size_t offset;
+  };
+
+  // a key entry is read from the packet data (lookahead, or a field of a
+  // header extracted in this state) when from_packet is true, from the PHV
+  // otherwise
+  struct KeyPart {
+    bool from_packet;
+    size_t byte_offset;
+    int bit_offset;
+    int bitwidth;
+    field_t field;
+    size_t nbytes;
+  };
+
+  struct State {
+    const ParseState *parse_state{nullptr};
+    bool compiled{false};
+    std::vector<Extract> extracts{};
+    size_t extract_nbytes{0};
+    bool has_switch{false};
+    std::vector<KeyPart> key{};
+    size_t key_nbytes{0};
+    std::unordered_map<uint64_t, int> transitions{};
+    int default_next{kAccept};
+  };
+
+  int get_index(const ParseState *parse_state);
+  bool lower(const ParseState &parse_state, const PHVFactory &phv_factory,
+             State *state);
+  int run_compiled(const State &state, Packet *pkt, const char *data,
+                   size_t *bytes_parsed) const;
+
+  static uint64_t pack(const char *key, size_t nbytes) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < nbytes; i++)
+      v = (v << 8) | static_cast<unsigned char>(key[i]);
+    return v;
+  }
+
+  std::vector<State> states{};
+  std::unordered_map<const ParseState *, int> index{};
+  // states which have been added but not lowered yet
+  std::vector<int> worklist{};
+};
+
+constexpr int ParserAutomaton::kAccept;
+
+ParserAutomaton::ParserAutomaton(const ParseState *init_state,
+                                 const PHVFactory &phv_factory) {
+  get_index(init_state);
+  while (!worklist.empty()) {
+    const int i = worklist.back();
+    worklist.pop_back();
+    // lower() can add states, so we cannot pass a reference to states[i]
+    State state;
+    state.parse_state = states[i].parse_state;
+    if (lower(*state.parse_state, phv_factory, &state))
+      states[i] = std::move(state);
+  }
+}
+
+int
+ParserAutomaton::get_index(const ParseState *parse_state) {
+  if (!parse_state) return kAccept;
+  auto it = index.find(parse_state);
+  if (it != index.end()) return it->second;
+  const int i = static_cast<int>(states.size());
+  states.emplace_back();
+  states.back().parse_state = parse_state;
+  index.emplace(parse_state, i);
+  worklist.push_back(i);
+  return i;
+}
+
+bool
+ParserAutomaton::lower(const ParseState &parse_state,
+                       const PHVFactory &phv_factory, State *state) {
+  for (const auto &parser_op : parse_state.parser_ops) {
+    auto extract = dynamic_cast<const ParserOpExtract *>(parser_op.get());
+    if (!extract) return false;
+    const auto &header_type = phv_factory.get_header_type(extract->header);
+    if (header_type.is_VL_header()) return false;
+    size_t nbits = 0;
+    for (const auto &placement : header_type.get_extract_plan())
+      nbits += header_type.get_bit_width(placement.field_offset);
+    state->extracts.push_back({extract->header, state->extract_nbytes});
+    state->extract_nbytes += nbits / 8;
+  }
+
+  state->has_switch = parse_state.has_switch;
+  if (state->has_switch) {
+    using Entry = ParseSwitchKeyBuilder::Entry;
+    for (const auto &e : parse_state.key_builder.entries) {
+      KeyPart part{};
+      if (e.tag == Entry::LOOKAHEAD) {
+        part.from_packet = true;
+        part.byte_offset = state->extract_nbytes + e.lookahead.byte_offset;
+        part.bit_offset = e.lookahead.bit_offset;
+        part.bitwidth = e.lookahead.bitwidth;
+      } else if (e.tag == Entry::FIELD) {
+        const auto &header_type = phv_factory.get_header_type(e.field.header);
+        const auto &finfo = header_type.get_finfo(e.field.offset);
+        if (finfo.is_VL) return false;
+        part.bitwidth = finfo.bitwidth;
+        part.field = e.field;
+        const auto &plan = header_type.get_extract_plan();
+        // the last extract wins if a header is extracted more than once
+        auto extract_it = std::find_if(
+            state->extracts.rbegin(), state->extracts.rend(),
+            [&e](const Extract &x) { return x.header == e.field.header; });
+        if (extract_it != state->extracts.rend() &&
+            static_cast<size_t>(e.field.offset) < plan.size()) {
+          const auto &placement = plan[e.field.offset];
+          part.from_packet = true;
+          part.byte_offset = extract_it->offset + placement.byte_offset;
+          part.bit_offset = placement.bit_offset;
+        }
+      } else {
+        return false;
+      }
+      part.nbytes = static_cast<size_t>((part.bitwidth + 7) / 8);
+      state->key_nbytes += part.nbytes;
+      state->key.push_back(part);
+    }
+    if (state->key_nbytes > sizeof(uint64_t)) return false;
+
+    std::vector<std::pair<ByteContainer, const ParseState *> > cases;
+    for (const auto &switch_case : parse_state.parser_switch)
+      if (!switch_case->get_exact_cases(&cases)) return false;
+    for (const auto &p : cases) {
+      // such a case can never match
+      if (p.first.size() != state->key_nbytes) continue;
+      // emplace does not overwrite existing keys, which preserves first-match
+      // semantics
+      state->transitions.emplace(pack(p.first.data(), p.first.size()),
+                                 get_index(p.second));
+    }
+  }
+
+  state->default_next = get_index(parse_state.default_next_state);
+  state->compiled = true;
+  return true;
+}
+
+int
+ParserAutomaton::run_compiled(const State &state, Packet *pkt,
+                              const char *data, size_t *bytes_parsed) const {
+  const ParseState &parse_state = *state.parse_state;
+  // TODO(antonin)
+  // this is temporary while we experiment with the debugger
+  DEBUGGER_NOTIFY_CTR(
+      Debugger::PacketId::make(pkt->get_packet_id(), pkt->get_copy_id()),
+      DBG_CTR_PARSE_STATE | parse_state.get_id());
+
+  auto phv = pkt->get_phv();
+  const char *state_data = data + *bytes_parsed;
+  if (pkt->get_data_size() - *bytes_parsed >= state.extract_nbytes) {
+    for (const auto &extract : state.extracts) {
+      auto &hdr = phv->get_header(extract.header);
+      BMLOG_DEBUG_PKT(*pkt, "Extracting header '{}'", hdr.get_name());
+      BMELOG(parser_extract, *pkt, hdr.get_id());
+      hdr.extract(state_data + extract.offset, *phv);
+    }
+    *bytes_parsed += state.extract_nbytes;
+  } else {
+    // we will run out of data: extract the headers one at a time so that the
+    // exception is thrown at the same point as with the interpreter
+    for (const auto &extract : state.extracts) {
+      auto &hdr = phv->get_header(extract.header);
+      BMLOG_DEBUG_PKT(*pkt, "Extracting header '{}'", hdr.get_name());
+      extract_fixed(&hdr, pkt, data + *bytes_parsed, bytes_parsed);
+    }
+  }
+
+  int next = state.default_next;
+  if (!state.has_switch) {
+    BMLOG_DEBUG_PKT(
+      *pkt,
+      "Parser state '{}' has no switch, going to default next state",
+      parse_state.get_name());
+  } else {
+    char key[sizeof(uint64_t)];
+    size_t key_offset = 0;
+    for (const auto &part : state.key) {
+      if (part.from_packet) {
+        extract::generic_extract(state_data + part.byte_offset,
+                                 part.bit_offset, part.bitwidth,
+                                 key + key_offset);
+      } else {
+        const auto &bytes = phv->get_field(
+            part.field.header, part.field.offset).get_bytes();
+        std::copy(bytes.begin(), bytes.end(), key + key_offset);
+      }
+      key_offset += part.nbytes;
+    }
+    BMLOG_DEBUG_PKT(*pkt, "Parser state '{}': key is {}",
+                    parse_state.get_name(),
+                    ByteContainer(key, state.key_nbytes).to_hex());
+    auto it = state.transitions.find(pack(key, state.key_nbytes));
+    if (it != state.transitions.end()) next = it->second;
+  }
+
+  DEBUGGER_NOTIFY_CTR(
+      Debugger::PacketId::make(pkt->get_packet_id(), pkt->get_copy_id()),
+      DBG_CTR_EXIT(DBG_CTR_PARSE_STATE) | parse_state.get_id());
+
+  return next;
+}
+
+const ParseState *
+ParserAutomaton::run(const Parser &parser, Packet *pkt, const char *data,
+                     size_t *bytes_parsed) const {
+  int next = 0;
+  while (next != kAccept) {
+    const State &state = states[next];
+    BMLOG_DEBUG_PKT(*pkt, "Parser '{}' entering state '{}'",
+                    parser.get_name(), state.parse_state->get_name());
+    if (state.compiled) {
+      next = run_compiled(state, pkt, data, bytes_parsed);
+    } else {
+      auto next_state = (*state.parse_state)(pkt, data, bytes_parsed);
+      auto it = index.find(next_state);
+      if (next_state && it == index.end()) {
+        BMLOG_TRACE_PKT(*pkt, "Bytes parsed: {}", *bytes_parsed);
+        return next_state;
+      }
+      next = next_state ? it->second : kAccept;
+    }
+    BMLOG_TRACE_PKT(*pkt, "Bytes parsed: {}", *bytes_parsed);
+  }
+  return nullptr;
+}
+
 Parser::Parser(const std::string &name, p4object_id_t id,
                const ErrorCodeMap *error_codes)
     : NamedP4Object(name, id), init_state(nullptr), error_codes(error_codes),
@@ -1002,6 +1397,17 @@ Parser::add_checksum(const Checksum *checksum) {
   checksums.push_back(checksum);
 }
 
+void
+Parser::compile(const PHVFactory &phv_factory) {
+  if (!init_state) return;
+  automaton = std::make_shared<ParserAutomaton>(init_state, phv_factory);
+}
+
+bool
+Parser::is_compiled() const {
+  return automaton != nullptr;
+}
+
 void
 Parser::verify_checksums(const Packet &pkt) const {
   for (auto checksum : checksums) {
@@ -1028,19 +1434,19 @@ Parser::parse(Packet *pkt) const {
   if (!init_state) return;
   const ParseState *next_state = init_state;
   size_t bytes_parsed = 0;
-  while (next_state) {
-    BMLOG_DEBUG_PKT(*pkt, "Parser '{}' entering state '{}'",
-                    get_name(), next_state->get_name());
-    try {
+  try {
+    if (automaton) next_state = automaton->run(*this, pkt, data, &bytes_parsed);
+    while (next_state) {
+      BMLOG_DEBUG_PKT(*pkt, "Parser '{}' entering state '{}'",
+                      get_name(), next_state->get_name());
       next_state = (*next_state)(pkt, data, &bytes_parsed);
-    } catch (const parser_exception &e) {
-      auto error_code = e.get(*error_codes);
-      BMLOG_ERROR_PKT(*pkt, "Exception while parsing: {}",
-                      error_codes->to_name(error_code));
-      pkt->set_error_code(error_code);
-      break;
+      BMLOG_TRACE_PKT(*pkt, "Bytes parsed: {}", bytes_parsed);
     }
-    BMLOG_TRACE_PKT(*pkt, "Bytes parsed: {}", bytes_parsed);
+  } catch (const parser_exception &e) {
+    auto error_code = e.get(*error_codes);
+    BMLOG_ERROR_PKT(*pkt, "Exception while parsing: {}",
+                    error_codes->to_name(error_code));
+    pkt->set_error_code(error_code);
   }
   pkt->remove(bytes_parsed);
   verify_checksums(*pkt);
@@ -1051,4 +1457,9 @@ Parser::parse(Packet *pkt) const {
   BMLOG_DEBUG_PKT(*pkt, "Parser '{}': end", get_name());
 }
 
+void
+Parser::parse_batch(const std::vector<Packet *> &pkts) const {
+  for (auto pkt : pkts) parse(pkt);
+}
+
 }  // namespace bm
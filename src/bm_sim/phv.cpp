@@ -20,10 +20,12 @@
 
 #include <bm/bm_sim/phv.h>
 #include <bm/bm_sim/logger.h>
+#include <bm/bm_sim/expressions.h>
 
 #include <string>
 #include <vector>
 #include <set>
+#include <utility>
 
 namespace bm {
 
@@ -126,6 +128,11 @@ PHV::push_back_header(const std::string &header_name,
     if (headers.back().VL_expr != nullptr) {
       for (const int offset : header_type.get_VL_input_offsets())
         headers.back()[offset].set_arith(true);
+      FieldChainExpression chain;
+      if (headers.back().VL_expr->get_field_chain(&chain)) {
+        headers.back().VL_chain.reset(
+            new FieldChainExpression(std::move(chain)));
+      }
     }
   }
 }
@@ -18,14 +18,27 @@
  *
  */
 
+#define BMLOG_SUBSYSTEM PIPELINE
+
 #include <bm/bm_sim/pipeline.h>
 #include <bm/bm_sim/event_logger.h>
 #include <bm/bm_sim/logger.h>
 #include <bm/bm_sim/debugger.h>
 #include <bm/bm_sim/packet.h>
 
+#include <string>
+#include <vector>
+
 namespace bm {
 
+size_t Pipeline::default_flow_cache_size = 0;
+
+Pipeline::Pipeline(const std::string &name, p4object_id_t id,
+                   ControlFlowNode *first_node)
+    : NamedP4Object(name, id), first_node(first_node) {
+  if (default_flow_cache_size > 0) enable_flow_cache(default_flow_cache_size);
+}
+
 void
 Pipeline::apply(Packet *pkt) {
   BMELOG(pipeline_start, *pkt, *this);
@@ -35,19 +48,101 @@ Pipeline::apply(Packet *pkt) {
       Debugger::PacketId::make(pkt->get_packet_id(), pkt->get_copy_id()),
       DBG_CTR_CONTROL | get_id());
   BMLOG_DEBUG_PKT(*pkt, "Pipeline '{}': start", get_name());
+  if (!flow_cache || pkt->is_marked_for_exit()) {
+    apply_nodes(pkt, nullptr);
+  } else if (flow_cache->lookup(pkt)) {
+    BMLOG_DEBUG_PKT(*pkt, "Pipeline '{}': flow cache hit", get_name());
+  } else {
+    FlowCache::Recorder recorder(flow_cache.get(), *pkt->get_phv());
+    apply_nodes(pkt, &recorder);
+    recorder.commit();
+  }
+  BMELOG(pipeline_done, *pkt, *this);
+  DEBUGGER_NOTIFY_CTR(
+      Debugger::PacketId::make(pkt->get_packet_id(), pkt->get_copy_id()),
+      DBG_CTR_EXIT(DBG_CTR_CONTROL) | get_id());
+  BMLOG_DEBUG_PKT(*pkt, "Pipeline '{}': end", get_name());
+}
+
+void
+Pipeline::apply_batch(const std::vector<Packet *> &pkts) {
+  if (flow_cache) {
+    for (auto pkt : pkts) apply(pkt);
+    return;
+  }
+
+  for (auto pkt : pkts) {
+    BMELOG(pipeline_start, *pkt, *this);
+    DEBUGGER_NOTIFY_CTR(
+        Debugger::PacketId::make(pkt->get_packet_id(), pkt->get_copy_id()),
+        DBG_CTR_CONTROL | get_id());
+    BMLOG_DEBUG_PKT(*pkt, "Pipeline '{}': start", get_name());
+  }
+
+  // next node for each packet, nullptr once the packet is done
+  std::vector<const ControlFlowNode *> nodes(pkts.size(), first_node);
+  std::vector<Packet *> group;
+  std::vector<size_t> group_idx;
+  std::vector<const ControlFlowNode *> next_nodes;
+  size_t first_pending = 0;
+  while (true) {
+    for (; first_pending < pkts.size(); first_pending++) {
+      if (nodes[first_pending]) break;
+    }
+    if (first_pending == pkts.size()) break;
+    // we follow the first pending packet and bring along all the packets which
+    // are at the same node
+    const ControlFlowNode *node = nodes[first_pending];
+    group.clear();
+    group_idx.clear();
+    for (size_t i = first_pending; i < pkts.size(); i++) {
+      if (nodes[i] != node) continue;
+      if (pkts[i]->is_marked_for_exit()) {
+        BMLOG_DEBUG_PKT(*pkts[i],
+                        "Packet is marked for exit, interrupting pipeline");
+        nodes[i] = nullptr;
+        continue;
+      }
+      group.push_back(pkts[i]);
+      group_idx.push_back(i);
+    }
+    if (group.empty()) continue;
+    next_nodes.clear();
+    node->apply_batch(group, &next_nodes);
+    for (size_t j = 0; j < group.size(); j++)
+      nodes[group_idx[j]] = next_nodes[j];
+  }
+
+  for (auto pkt : pkts) {
+    BMELOG(pipeline_done, *pkt, *this);
+    DEBUGGER_NOTIFY_CTR(
+        Debugger::PacketId::make(pkt->get_packet_id(), pkt->get_copy_id()),
+        DBG_CTR_EXIT(DBG_CTR_CONTROL) | get_id());
+    BMLOG_DEBUG_PKT(*pkt, "Pipeline '{}': end", get_name());
+  }
+}
+
+void
+Pipeline::apply_nodes(Packet *pkt, FlowCache::Recorder *recorder) {
   const ControlFlowNode *node = first_node;
   while (node) {
     if (pkt->is_marked_for_exit()) {
       BMLOG_DEBUG_PKT(*pkt, "Packet is marked for exit, interrupting pipeline");
       break;
     }
+    if (recorder) recorder->visit_node(*node);
     node = (*node)(pkt);
   }
-  BMELOG(pipeline_done, *pkt, *this);
-  DEBUGGER_NOTIFY_CTR(
-      Debugger::PacketId::make(pkt->get_packet_id(), pkt->get_copy_id()),
-      DBG_CTR_EXIT(DBG_CTR_CONTROL) | get_id());
-  BMLOG_DEBUG_PKT(*pkt, "Pipeline '{}': end", get_name());
+}
+
+void
+Pipeline::enable_flow_cache(size_t max_entries) {
+  flow_cache = std::unique_ptr<FlowCache>(new FlowCache(max_entries));
+}
+
+void
+Pipeline::set_default_flow_cache_size(size_t max_entries) {
+  default_flow_cache_size = max_entries;
 }
 
 }  // namespace bm
@@ -0,0 +1,74 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <bm/bm_sim/sharded_shared_mutex.h>
+
+#include <thread>
+
+namespace bm {
+
+constexpr size_t ShardedSharedMutex::nb_slots;
+constexpr int ShardedSharedMutex::reader_spin_iterations;
+
+void
+ShardedSharedMutex::lock() {
+  w_mutex.lock();
+  writer.store(true, std::memory_order_seq_cst);
+  wait_for_readers();
+}
+
+bool
+ShardedSharedMutex::try_lock() {
+  if (!w_mutex.try_lock()) return false;
+  writer.store(true, std::memory_order_seq_cst);
+  for (const auto &slot : slots) {
+    if (slot.readers.load(std::memory_order_seq_cst) != 0) {
+      writer.store(false, std::memory_order_release);
+      w_mutex.unlock();
+      return false;
+    }
+  }
+  return true;
+}
+
+void
+ShardedSharedMutex::unlock() {
+  writer.store(false, std::memory_order_release);
+  w_mutex.unlock();
+}
+
+// Writers are rare and critical sections are usually short, so we start by
+// yielding. But a writer may also block for a long time (e.g. a large table
+// update from the control plane), in which case we wait on w_mutex, which the
+// writer releases in unlock(), rather than keep every packet processing thread
+// busy.
+void
+ShardedSharedMutex::wait_for_writer() {
+  for (int i = 0; i < reader_spin_iterations; i++) {
+    if (!writer.load(std::memory_order_acquire)) return;
+    std::this_thread::yield();
+  }
+  std::lock_guard<std::mutex> lock(w_mutex);
+}
+
+void
+ShardedSharedMutex::wait_for_readers() const {
+  for (const auto &slot : slots) {
+    while (slot.readers.load(std::memory_order_seq_cst) != 0)
+      std::this_thread::yield();
+  }
+}
+
+}  // namespace bm
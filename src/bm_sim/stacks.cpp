@@ -29,6 +29,35 @@ namespace bm {
 
 namespace detail {
 
+namespace {
+
+void invalidate(Header *hdr) {
+  hdr->mark_invalid();
+}
+
+void invalidate(HeaderUnion *header_union) {
+  // HeaderUnion::mark_invalid is a no-op
+  auto hdr = header_union->get_valid_header();
+  if (hdr) hdr->mark_invalid();
+}
+
+// Moves the contents of src to dst as part of a shift, after which src is
+// either overwritten by another element or invalidated. Elements are bound to
+// PHV headers (which are accessed directly by id by the rest of the program),
+// so we cannot shift the stack by rotating an index; however only valid
+// elements carry data that needs to be preserved. When src is invalid, we just
+// invalidate dst instead of swapping all the fields, which means that the cost
+// of a shift is proportional to the number of valid elements.
+template <typename T>
+void shift_element(T *dst, T *src) {
+  if (src->is_valid())
+    dst->swap_values(src);
+  else if (dst->is_valid())
+    invalidate(dst);
+}
+
+}  // namespace
+
 // legacy implementation of push_front and pop_front
 
 template <typename T>
@@ -41,7 +70,7 @@ StackLegacy<T>::pop_front() {
   if (this->next == 0) return 0u;
   this->next--;
   for (size_t i = 0; i < this->next; i++) {
-    this->elements[i].get().swap_values(&this->elements[i + 1].get());
+    shift_element(&this->elements[i].get(), &this->elements[i + 1].get());
   }
   this->elements[this->next].get().mark_invalid();
   return 1u;
@@ -54,7 +83,7 @@ StackLegacy<T>::pop_front(size_t num) {
   size_t popped = std::min(this->next, num);
   this->next -= popped;
   for (size_t i = 0; i < this->next; i++) {
-    this->elements[i].get().swap_values(&this->elements[i + num].get());
+    shift_element(&this->elements[i].get(), &this->elements[i + num].get());
   }
   for (size_t i = this->next; i < this->next + popped; i++) {
     this->elements[i].get().mark_invalid();
@@ -67,7 +96,7 @@ size_t
 StackLegacy<T>::push_front() {
   if (this->next < this->elements.size()) this->next++;
   for (size_t i = this->next - 1; i > 0; i--) {
-    this->elements[i].get().swap_values(&this->elements[i - 1].get());
+    shift_element(&this->elements[i].get(), &this->elements[i - 1].get());
   }
   this->elements[0].get().mark_valid();
   return 1u;
@@ -79,7 +108,7 @@ StackLegacy<T>::push_front(size_t num) {
   if (num == 0) return 0;
   this->next = std::min(this->elements.size(), this->next + num);
   for (size_t i = this->next - 1; i > num - 1; i--) {
-    this->elements[i].get().swap_values(&this->elements[i - num].get());
+    shift_element(&this->elements[i].get(), &this->elements[i - num].get());
   }
   size_t pushed = std::min(this->elements.size(), num);
   for (size_t i = 0; i < pushed; i++) {
@@ -100,7 +129,7 @@ StackP4_16<T>::pop_front() {
   if (this->next > 0) this->next--;
   auto size = this->elements.size();
   for (size_t i = 0; i < size - 1; i++) {
-    this->elements[i].get().swap_values(&this->elements[i + 1].get());
+    shift_element(&this->elements[i].get(), &this->elements[i + 1].get());
   }
   this->elements[size - 1].get().mark_invalid();
   return 1u;
@@ -114,7 +143,7 @@ StackP4_16<T>::pop_front(size_t num) {
   this->next -= std::min(this->next, num);
   size_t i = 0;
   for (; i < size - num; i++) {
-    this->elements[i].get().swap_values(&this->elements[i + num].get());
+    shift_element(&this->elements[i].get(), &this->elements[i + num].get());
   }
   for (; i < size; i++) {
     this->elements[i].get().mark_invalid();
@@ -128,7 +157,7 @@ StackP4_16<T>::push_front() {
   auto size = this->elements.size();
   if (this->next < size) this->next++;
   for (size_t i = size - 1; i > 0; i--) {
-    this->elements[i].get().swap_values(&this->elements[i - 1].get());
+    shift_element(&this->elements[i].get(), &this->elements[i - 1].get());
   }
   this->elements[0].get().mark_invalid();
   return 1u;
@@ -141,7 +170,7 @@ StackP4_16<T>::push_front(size_t num) {
   auto size = this->elements.size();
   this->next = std::min(size, this->next + num);
   for (size_t i = size - 1; i > num - 1; i--) {
-    this->elements[i].get().swap_values(&this->elements[i - num].get());
+    shift_element(&this->elements[i].get(), &this->elements[i - num].get());
   }
   size_t pushed = std::min(size, num);
   for (size_t i = 0; i < pushed; i++) {
@@ -20,10 +20,13 @@
 
 #include <bm/bm_sim/stateful.h>
 
+#include <algorithm>  // std::find, std::min
 #include <iterator>  // std::distance
 #include <string>
 #include <vector>
 
+#include <cassert>
+
 namespace bm {
 
 Register::Register(int nbits, const RegisterArray *register_array)
@@ -43,6 +46,38 @@ RegisterArray::RegisterArray(const std::string &name, p4object_id_t id,
   registers.reserve(size);
   for (size_t i = 0; i < size; i++)
     registers.emplace_back(bitwidth, this);
+  // power of 2, so that the stripe can be obtained by masking the index
+  while (nb_stripes < std::min(size, max_stripes)) nb_stripes <<= 1;
+  stripes.reset(new Stripe[nb_stripes]);
+}
+
+// when the array has no striped accesses, exclusive access only takes m_mutex,
+// so we need to take it as well
+std::mutex &
+RegisterArray::get_access_mutex(size_t idx) const {
+  return striped_accesses ? get_stripe(idx) : m_mutex;
+}
+
+void
+RegisterArray::read(size_t idx, Data *dst) const {
+  assert(idx < size());
+  if (RegisterSync::is_locked_by_thread(this)) {
+    dst->set(registers[idx]);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(get_access_mutex(idx));
+  dst->set(registers[idx]);
+}
+
+void
+RegisterArray::write(size_t idx, const Data &src) {
+  assert(idx < size());
+  if (RegisterSync::is_locked_by_thread(this)) {
+    registers[idx].set(src);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(get_access_mutex(idx));
+  registers[idx].set(src);
 }
 
 void
@@ -56,10 +91,15 @@ RegisterArray::reset_state() {
   registers_new.reserve(s);
   for (size_t i = 0; i < s; i++)
     registers_new.emplace_back(bitwidth, this);
-  auto lock = UniqueLock();
+  auto lock = unique_lock();
   registers.swap(registers_new);
 }
 
+void
+RegisterArray::enable_striped_accesses() {
+  striped_accesses = true;
+}
+
 void
 RegisterArray::register_notifier(Notifier notifier) {
   notifiers.push_back(std::move(notifier));
@@ -71,10 +111,26 @@ RegisterArray::notify(const Register &reg) const {
     notifier(std::distance(&registers[0], &reg));
 }
 
+constexpr size_t RegisterArray::max_stripes;
+
+thread_local RegisterSync::RegisterLocks *RegisterSync::current = nullptr;
+
 void
 RegisterSync::add_register_array(const RegisterArray *register_array) {
   if (register_arrays.insert(register_array).second)
-    mutexes.push_back(&register_array->m_mutex);
+    mutexes.push_back(&register_array->x_mutex);
+}
+
+void
+RegisterSync::remove_register_array(const RegisterArray *register_array) {
+  if (register_arrays.erase(register_array) == 0) return;
+  mutexes.erase(std::find(mutexes.begin(), mutexes.end(),
+                          &register_array->x_mutex));
+}
+
+bool
+RegisterSync::has_register_array(const RegisterArray *register_array) const {
+  return register_arrays.find(register_array) != register_arrays.end();
 }
 
 void
@@ -83,4 +139,21 @@ RegisterSync::merge_from(const RegisterSync &other) {
     add_register_array(register_array);  // takes care of duplicates
 }
 
+void
+RegisterSync::lock_stripe(const RegisterArray *register_array, size_t idx,
+                          RegisterLocks *RL) {
+  RL->striped_array = register_array;
+  RL->stripe_lock = std::unique_lock<std::mutex>(
+      register_array->get_access_mutex(idx));
+}
+
+bool
+RegisterSync::is_locked_by_thread(const RegisterArray *register_array) {
+  for (auto RL = current; RL != nullptr; RL = RL->prev) {
+    if (RL->sync && RL->sync->has_register_array(register_array)) return true;
+    if (RL->striped_array == register_array) return true;
+  }
+  return false;
+}
+
 }  // namespace bm
@@ -23,11 +23,17 @@
 #include <bm/bm_sim/_assert.h>
 #include <bm/bm_sim/switch.h>
 #include <bm/bm_sim/P4Objects.h>
+#include <bm/bm_sim/checksums.h>
+#include <bm/bm_sim/clock.h>
+#include <bm/bm_sim/counters.h>
+#include <bm/bm_sim/meters.h>
 #include <bm/bm_sim/options_parse.h>
 #include <bm/bm_sim/logger.h>
 #include <bm/bm_sim/debugger.h>
 #include <bm/bm_sim/event_logger.h>
 #include <bm/bm_sim/packet.h>
+#include <bm/bm_sim/pipeline.h>
+#include <bm/bm_sim/shm_ring.h>
 
 #include <cassert>
 #include <fstream>
@@ -210,8 +216,16 @@ SwitchWContexts::init_from_options_parser(
   if (transport == nullptr) {
 #ifdef BMNANOMSG_ON
     notifications_addr = parser.notifications_addr;
-    transport = std::shared_ptr<TransportIface>(
-        TransportIface::make_nanomsg(notifications_addr));
+    std::string shm_name;
+    if (ShmRing::parse_addr(notifications_addr, &shm_name)) {
+      transport = std::shared_ptr<TransportIface>(
+          TransportIface::make_shm(shm_name,
+                                   TransportIface::default_shm_capacity,
+                                   parser.shm_replace, parser.shm_mode));
+    } else {
+      transport = std::shared_ptr<TransportIface>(
+          TransportIface::make_nanomsg(notifications_addr));
+    }
 #else
     notifications_addr = "";
     transport = std::shared_ptr<TransportIface>(TransportIface::make_dummy());
@@ -231,6 +245,10 @@ SwitchWContexts::init_from_options_parser(
 
   event_logger_addr = parser.event_logger_addr;
 
+  // has to be before the logger is created
+  if (parser.log_async_queue_size > 0)
+    Logger::set_async(parser.log_async_queue_size);
+
   if (parser.console_logging)
     Logger::set_logger_console();
 
@@ -238,6 +256,16 @@ SwitchWContexts::init_from_options_parser(
     Logger::set_logger_file(parser.file_logger, parser.log_flush);
 
   Logger::set_log_level(parser.log_level);
+  for (auto subsystem : parser.log_disabled_subsystems)
+    Logger::set_subsystem_enabled(subsystem, false);
+
+  // has to be before init_objects, the layout of a counter is decided when it
+  // is created
+  Counter::set_num_shards(parser.counter_shards);
+  // same for learn lists
+  LearnEngineIface::set_dedup_cache_size(parser.learn_dedup_cache_size);
+  // and for pipelines
+  Pipeline::set_default_flow_cache_size(parser.flow_cache_size);
 
   if (parser.no_p4)
     status = init_objects_empty(parser.device_id, transport);
@@ -301,6 +329,15 @@ SwitchWContexts::init_from_options_parser(
 
   dump_packet_data = parser.dump_packet_data;
 
+  Checksum::set_incremental_updates(parser.incremental_checksums);
+
+  Meter::set_time_resolution(
+      std::chrono::microseconds(parser.meter_time_resolution_us));
+  for (const auto &p : parser.clock_resolution_us) {
+    Clock::set_resolution(Clock::consumer_from_name(p.first),
+                          std::chrono::microseconds(p.second));
+  }
+
   // TODO(unknown): is this the right place to do this?
   set_packet_handler(packet_handler, static_cast<void *>(this));
 
@@ -18,11 +18,14 @@
  *
  */
 
+#define BMLOG_SUBSYSTEM TABLES
+
 #include <bm/bm_sim/tables.h>
 #include <bm/bm_sim/debugger.h>
 #include <bm/bm_sim/logger.h>
 
 #include <string>
+#include <vector>
 
 namespace bm {
 
@@ -47,4 +50,25 @@ MatchActionTable::operator()(Packet *pkt) const {
   return next;
 }
 
+void
+MatchActionTable::apply_batch(
+    const std::vector<Packet *> &pkts,
+    std::vector<const ControlFlowNode *> *next_nodes) const {
+  for (auto pkt : pkts) {
+    (void) pkt;  // unused if the debugger and the logging macros are disabled
+    DEBUGGER_NOTIFY_CTR(
+        Debugger::PacketId::make(pkt->get_packet_id(), pkt->get_copy_id()),
+        DBG_CTR_TABLE | get_id());
+    BMLOG_TRACE_PKT(*pkt, "Applying table '{}'", get_name());
+  }
+  match_table->apply_action_batch(pkts, next_nodes);
+#ifdef BMDEBUG_ON
+  for (auto pkt : pkts) {
+    DEBUGGER_NOTIFY_CTR(
+        Debugger::PacketId::make(pkt->get_packet_id(), pkt->get_copy_id()),
+        DBG_CTR_EXIT(DBG_CTR_TABLE) | get_id());
+  }
+#endif  // BMDEBUG_ON
+}
+
 }  // namespace bm
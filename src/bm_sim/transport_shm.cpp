@@ -0,0 +1,107 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <bm/bm_sim/transport.h>
+#include <bm/bm_sim/shm_ring.h>
+
+#include <array>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace bm {
+
+// The ring only supports one producer, but notifications can be sent from
+// several threads (learning, ageing, port monitor), so we serialize the sends.
+class TransportShm : public TransportIface {
+ public:
+  TransportShm(const std::string &name, size_t capacity, bool replace_open,
+               unsigned int mode)
+      : name(name), capacity(capacity), replace_open(replace_open),
+        mode(mode) { }
+
+ private:
+  int open_() override {
+    ring = ShmRing::create(name, capacity, replace_open, mode);
+    if (!ring) {
+      std::cerr << "Error when trying to create shared memory ring '"
+                << ShmRing::get_path(name) << "'.\n"
+                << "This may happen if /dev/shm is not available, if you "
+                << "have insufficient permissions or if the ring is still "
+                << "open (use --shm-replace to replace it anyway)\n";
+      std::exit(1);
+    }
+    return 0;
+  }
+
+  int push(const ShmRing::Buf *bufs, size_t nb_bufs) const {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!ring) return -1;
+    return ring->push(bufs, nb_bufs) ? 0 : -1;
+  }
+
+  int send_(const std::string &msg) const override {
+    ShmRing::Buf buf = {msg.data(), msg.size()};
+    return push(&buf, 1);
+  }
+
+  int send_(const char *msg, int len) const override {
+    ShmRing::Buf buf = {msg, static_cast<size_t>(len)};
+    return push(&buf, 1);
+  }
+
+  // like for the nanomsg transport, the buffers are concatenated into a single
+  // message
+  int send_msgs_(const std::initializer_list<std::string> &msgs)
+      const override {
+    if (msgs.size() == 0) return 0;
+    std::string msg;
+    for (const auto &m : msgs) msg.append(m);
+    return send_(msg);
+  }
+
+  int send_msgs_(const std::initializer_list<MsgBuf> &msgs) const override {
+    if (msgs.size() == 0) return 0;
+    std::array<ShmRing::Buf, max_bufs> bufs;
+    if (msgs.size() > max_bufs) {
+      std::string msg;
+      for (const auto &m : msgs) msg.append(m.buf, m.len);
+      return send_(msg);
+    }
+    size_t nb_bufs = 0;
+    for (const auto &m : msgs) bufs[nb_bufs++] = {m.buf, m.len};
+    return push(bufs.data(), nb_bufs);
+  }
+
+  static constexpr size_t max_bufs = 8;
+
+ private:
+  std::string name;
+  size_t capacity;
+  bool replace_open;
+  unsigned int mode;
+  std::unique_ptr<ShmRing> ring{nullptr};
+  mutable std::mutex mutex{};
+};
+
+std::unique_ptr<TransportIface>
+TransportIface::make_shm(const std::string &name, size_t capacity,
+                         bool replace_open, unsigned int mode) {
+  return std::unique_ptr<TransportIface>(
+      new TransportShm(name, capacity, replace_open, mode));
+}
+
+}  // namespace bm
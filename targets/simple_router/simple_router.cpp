@@ -18,6 +18,8 @@
  *
  */
 
+#define BMLOG_SUBSYSTEM TARGET
+
 #include <bm/bm_sim/queue.h>
 #include <bm/bm_sim/packet.h>
 #include <bm/bm_sim/parser.h>
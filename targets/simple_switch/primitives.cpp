@@ -299,8 +299,10 @@ REGISTER_PRIMITIVE(count);
 class register_read
   : public ActionPrimitive<Field &, const RegisterArray &, const Data &> {
   void operator ()(Field &dst, const RegisterArray &src, const Data &idx) {
-    dst.set(src[idx.get_uint()]);
+    src.read(idx.get_uint(), &dst);
   }
+
+  bool uses_striped_register_accesses() const override { return true; }
 };
 
 REGISTER_PRIMITIVE(register_read);
@@ -308,8 +310,10 @@ REGISTER_PRIMITIVE(register_read);
 class register_write
   : public ActionPrimitive<RegisterArray &, const Data &, const Data &> {
   void operator ()(RegisterArray &dst, const Data &idx, const Data &src) {
-    dst[idx.get_uint()].set(src);
+    dst.write(idx.get_uint(), src);
   }
+
+  bool uses_striped_register_accesses() const override { return true; }
 };
 
 REGISTER_PRIMITIVE(register_write);
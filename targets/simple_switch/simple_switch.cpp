@@ -18,6 +18,8 @@
  *
  */
 
+#define BMLOG_SUBSYSTEM TARGET
+
 #include <bm/bm_sim/parser.h>
 #include <bm/bm_sim/tables.h>
 #include <bm/bm_sim/logger.h>
@@ -87,7 +89,7 @@ SimpleSwitch::SimpleSwitch(port_t max_port, bool enable_swap)
         this->transmit_fn(port_num, buffer, len);
     }),
     pre(new McSimplePreLAG()),
-    start(clock::now()) {
+    start(bm::Clock::now(bm::Clock::Consumer::TIMESTAMPS)) {
   add_component<McSimplePreLAG>(pre);
 
   add_required_field("standard_metadata", "ingress_port");
@@ -238,7 +240,8 @@ SimpleSwitch::transmit_thread() {
 
 ts_res
 SimpleSwitch::get_ts() const {
-  return duration_cast<ts_res>(clock::now() - start);
+  return duration_cast<ts_res>(
+      bm::Clock::now(bm::Clock::Consumer::TIMESTAMPS) - start);
 }
 
 void
@@ -21,6 +21,7 @@
 #ifndef SIMPLE_SWITCH_SIMPLE_SWITCH_H_
 #define SIMPLE_SWITCH_SIMPLE_SWITCH_H_
 
+#include <bm/bm_sim/clock.h>
 #include <bm/bm_sim/queue.h>
 #include <bm/bm_sim/queueing.h>
 #include <bm/bm_sim/packet.h>
@@ -183,7 +184,8 @@ class SimpleSwitch : public Switch {
   Queue<std::unique_ptr<Packet> > output_buffer;
   TransmitFn my_transmit_fn;
   std::shared_ptr<McSimplePreLAG> pre;
-  clock::time_point start;
+  // reference for get_ts(), which reads the time through bm::Clock
+  bm::Clock::clock::time_point start;
   std::unordered_map<mirror_id_t, port_t> mirroring_map;
   bool with_queueing_metadata{false};
 };
@@ -90,58 +90,83 @@ NNEventListener::receive_loop() {
     uint64_t copy_id;
   } __attribute__((packed));
 
-  while (true) {
-    std::aligned_storage<128>::type storage;
-    msg_hdr_t *msg_hdr = reinterpret_cast<msg_hdr_t *>(&storage);
-    char *buf = reinterpret_cast<char *>(&storage);
+  // an asynchronous event logger publishes messages of up to 8KB, which can
+  // include several events
+  std::vector<char> buf(8192);
 
-    if (s.recv(buf, sizeof(storage), 0) <= 0) {
+  while (true) {
+    int len = s.recv(buf.data(), buf.size(), 0);
+    if (len <= 0) {
       std::unique_lock<std::mutex> lock(mutex);
       if (stop_receive_thread) return;
       continue;
     }
 
-    int object_id;
-
-    switch (msg_hdr->type) {
-      case TABLE_HIT:
-        {
-          struct msg_t : msg_hdr_t {
-            int table_id;
-            int entry_hdl;
-          } __attribute__((packed));
-          msg_t *msg = reinterpret_cast<msg_t *>(&storage);
-          object_id = msg->table_id;
-        }
-        break;
-      case TABLE_MISS:
-        {
-          struct msg_t : msg_hdr_t {
-            int table_id;
-          } __attribute__((packed));
-          msg_t *msg = reinterpret_cast<msg_t *>(&storage);
-          object_id = msg->table_id;
-        }
-        break;
-      case ACTION_EXECUTE:
-        {
-          struct msg_t : msg_hdr_t {
-            int action_id;
-          } __attribute__((packed));
-          msg_t *msg = reinterpret_cast<msg_t *>(&storage);
-          object_id = msg->action_id;
-        }
-        break;
-      default:
-        continue;
-    }
+    int offset = 0;
+    while (offset + static_cast<int>(sizeof(msg_hdr_t)) <= len) {
+      char *event = buf.data() + offset;
+      msg_hdr_t *msg_hdr = reinterpret_cast<msg_hdr_t *>(event);
+      int object_id = 0;
+      bool record = true;
+
+      switch (msg_hdr->type) {
+        case TABLE_HIT:
+          {
+            struct msg_t : msg_hdr_t {
+              int table_id;
+              int entry_hdl;
+            } __attribute__((packed));
+            msg_t *msg = reinterpret_cast<msg_t *>(event);
+            object_id = msg->table_id;
+            offset += sizeof(msg_t);
+          }
+          break;
+        case TABLE_MISS:
+          {
+            struct msg_t : msg_hdr_t {
+              int table_id;
+            } __attribute__((packed));
+            msg_t *msg = reinterpret_cast<msg_t *>(event);
+            object_id = msg->table_id;
+            offset += sizeof(msg_t);
+          }
+          break;
+        case ACTION_EXECUTE:
+          {
+            struct msg_t : msg_hdr_t {
+              int action_id;
+            } __attribute__((packed));
+            msg_t *msg = reinterpret_cast<msg_t *>(event);
+            object_id = msg->action_id;
+            offset += sizeof(msg_t);
+          }
+          break;
+        // other events are skipped, but we need their size to find the next
+        // event in the message
+        case CONDITION_EVAL:
+          record = false;
+          offset += sizeof(msg_hdr_t) + 2 * sizeof(int);
+          break;
+        case CONFIG_CHANGE:
+          record = false;
+          offset += sizeof(msg_hdr_t);
+          break;
+        default:
+          record = false;
+          offset += sizeof(msg_hdr_t) + sizeof(int);
+          break;
+      }
 
-    std::string pid =
-        std::to_string(msg_hdr->id) + "." + std::to_string(msg_hdr->copy_id);
+      if (!record) continue;
 
-    std::unique_lock<std::mutex> lock(mutex);
-    events[pid].push_back({static_cast<NNEventType>(msg_hdr->type), object_id});
-    cond_new_event.notify_all();
+      std::string pid =
+          std::to_string(msg_hdr->id) + "." + std::to_string(msg_hdr->copy_id);
+
+      std::unique_lock<std::mutex> lock(mutex);
+      events[pid].push_back(
+          {static_cast<NNEventType>(msg_hdr->type), object_id});
+      cond_new_event.notify_all();
+    }
   }
 }
 
@@ -35,9 +35,11 @@
 class NNEventListener {
  public:
   enum NNEventType {
+    CONDITION_EVAL = 11,
     TABLE_HIT = 12,
     TABLE_MISS = 13,
-    ACTION_EXECUTE = 14
+    ACTION_EXECUTE = 14,
+    CONFIG_CHANGE = 999
   };
 
   struct NNEvent {
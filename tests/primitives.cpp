@@ -82,8 +82,10 @@ REGISTER_PRIMITIVE(count);
 class register_write
   : public ActionPrimitive<RegisterArray &, const Data &, const Data &> {
   void operator ()(RegisterArray &dst, const Data &idx, const Data &src) {
-    dst[idx.get_uint()].set(src);
+    dst.write(idx.get_uint(), src);
   }
+
+  bool uses_striped_register_accesses() const override { return true; }
 };
 
 REGISTER_PRIMITIVE(register_write);
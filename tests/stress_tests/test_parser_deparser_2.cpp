@@ -0,0 +1,500 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Parser / deparser benchmark suite. Each benchmark parses and deparses a batch
+// of identical packets for a given header chain, with both the interpreted and
+// the compiled (Parser::compile) parser. Results are printed as one JSON object
+// per line, e.g.:
+// {"benchmark": "ipv4_tcp", "parser": "compiled", "packets": 64000,
+//  "ns_per_packet": 412.3, "allocs_per_packet": 0.00}
+// so that they can easily be compared across builds. The program exits with a
+// non-zero status if a packet fails to parse or is not deparsed identically.
+
+#include <bm/bm_sim/checksums.h>
+#include <bm/bm_sim/deparser.h>
+#include <bm/bm_sim/expressions.h>
+#include <bm/bm_sim/packet.h>
+#include <bm/bm_sim/parser.h>
+#include <bm/bm_sim/phv.h>
+#include <bm/bm_sim/phv_source.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+std::atomic<size_t> num_allocs{0};
+
+}  // namespace
+
+// count every heap allocation made by the program; noinline prevents GCC from
+// incorrectly reporting mismatched malloc / operator delete calls
+__attribute__((noinline)) void *operator new(size_t size) {
+  num_allocs.fetch_add(1, std::memory_order_relaxed);
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+using namespace bm;
+
+using Bytes = std::vector<char>;
+
+void append(Bytes *bytes, std::initializer_list<int> values) {
+  for (auto v : values) bytes->push_back(static_cast<char>(v));
+}
+
+void append_ethernet(Bytes *bytes, int ethertype) {
+  append(bytes, {0x00, 0x18, 0x0a, 0x05, 0x5a, 0x10,
+                 0xa0, 0x88, 0x69, 0x0c, 0xc3, 0x03,
+                 ethertype >> 8, ethertype & 0xff});
+}
+
+void append_vlan(Bytes *bytes, int ethertype) {
+  append(bytes, {0x00, 0x0a, ethertype >> 8, ethertype & 0xff});
+}
+
+void append_mpls(Bytes *bytes, int label, bool bos) {
+  append(bytes, {(label >> 12) & 0xff, (label >> 4) & 0xff,
+                 ((label & 0xf) << 4) | (bos ? 1 : 0), 64});
+}
+
+void append_ipv4(Bytes *bytes, int protocol, int options_words = 0) {
+  const size_t start = bytes->size();
+  const int ihl = 5 + options_words;
+  append(bytes, {0x40 | ihl, 0x00, 0x00, 0x54, 0x70, 0x90, 0x40, 0x00,
+                 0x40, protocol, 0x00, 0x00,
+                 0x0a, 0x36, 0xc1, 0x21, 0x4e, 0x28, 0x7b, 0xac});
+  for (int i = 0; i < options_words; i++)
+    append(bytes, {0x01, 0x01, 0x01, 0x01});
+  // compute a valid checksum
+  uint32_t sum = 0;
+  for (size_t i = start; i < bytes->size(); i += 2) {
+    sum += (static_cast<unsigned char>((*bytes)[i]) << 8) |
+        static_cast<unsigned char>((*bytes)[i + 1]);
+  }
+  while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+  (*bytes)[start + 10] = static_cast<char>((~sum >> 8) & 0xff);
+  (*bytes)[start + 11] = static_cast<char>(~sum & 0xff);
+}
+
+void append_ipv6(Bytes *bytes, int next_header) {
+  append(bytes, {0x60, 0x00, 0x00, 0x00, 0x00, 0x40, next_header, 0x40});
+  for (int i = 0; i < 32; i++) append(bytes, {i});
+}
+
+void append_udp(Bytes *bytes, int dst_port) {
+  append(bytes, {0x1f, 0x5c, dst_port >> 8, dst_port & 0xff,
+                 0x00, 0x30, 0x00, 0x00});
+}
+
+void append_tcp(Bytes *bytes) {
+  append(bytes, {0x9c, 0x5e, 0x01, 0xbb, 0x7d, 0x1b, 0x9a, 0x68,
+                 0xbb, 0xd0, 0x8d, 0x4b, 0x50, 0x10, 0x00, 0xe5,
+                 0xc8, 0x2d, 0x00, 0x00});
+}
+
+void append_vxlan(Bytes *bytes) {
+  append(bytes, {0x08, 0x00, 0x00, 0x00, 0x00, 0x12, 0x34, 0x00});
+}
+
+void append_payload(Bytes *bytes) {
+  for (int i = 0; i < 64; i++) append(bytes, {i});
+}
+
+// All the headers, parse states and deparsers used by the benchmarks. The parse
+// graph is:
+//   ethernet -> (vlan ->) ipv4 / ipv6 / mpls+ -> ipv4
+//   ipv4 -> (ipv4 options ->) tcp / udp, ipv6 -> tcp / udp
+//   udp:4789 -> vxlan -> inner ethernet -> inner ipv4
+class Program {
+ public:
+  enum : header_id_t {
+    ETHERNET, VLAN, MPLS0, MPLS1, MPLS2, IPV4, IPV4_OPTIONS, IPV6, UDP, TCP,
+    VXLAN, INNER_ETHERNET, INNER_IPV4
+  };
+
+  static constexpr header_stack_id_t MPLS_STACK = 0;
+
+  Program()
+      : error_codes(ErrorCodeMap::make_with_core()),
+        phv_source(PHVSourceIface::make_phv_source()) {
+    auto &ethernet_t = add_type("ethernet_t",
+                                {{"dstAddr", 48}, {"srcAddr", 48},
+                                 {"etherType", 16}});
+    auto &vlan_t = add_type("vlan_t", {{"pcp", 3}, {"cfi", 1}, {"vid", 12},
+                                       {"etherType", 16}});
+    auto &mpls_t = add_type("mpls_t", {{"label", 20}, {"tc", 3}, {"bos", 1},
+                                       {"ttl", 8}});
+    auto &ipv4_t = add_type("ipv4_t",
+                            {{"version", 4}, {"ihl", 4}, {"diffserv", 8},
+                             {"totalLen", 16}, {"identification", 16},
+                             {"flags", 3}, {"fragOffset", 13}, {"ttl", 8},
+                             {"protocol", 8}, {"hdrChecksum", 16},
+                             {"srcAddr", 32}, {"dstAddr", 32}});
+    auto &ipv4_options_t = add_type("ipv4_options_t", {});
+    ipv4_options_t.push_back_VL_field("options", 40, nullptr);
+    auto &ipv6_t = add_type("ipv6_t",
+                            {{"version", 4}, {"trafficClass", 8},
+                             {"flowLabel", 20}, {"payloadLen", 16},
+                             {"nextHdr", 8}, {"hopLimit", 8},
+                             {"srcAddr", 128}, {"dstAddr", 128}});
+    auto &udp_t = add_type("udp_t", {{"srcPort", 16}, {"dstPort", 16},
+                                     {"length", 16}, {"checksum", 16}});
+    auto &tcp_t = add_type("tcp_t",
+                           {{"srcPort", 16}, {"dstPort", 16}, {"seqNo", 32},
+                            {"ackNo", 32}, {"dataOffset", 4}, {"res", 4},
+                            {"flags", 8}, {"window", 16}, {"checksum", 16},
+                            {"urgentPtr", 16}});
+    auto &vxlan_t = add_type("vxlan_t", {{"flags", 8}, {"reserved", 24},
+                                         {"vni", 24}, {"reserved2", 8}});
+
+    phv_factory.push_back_header("ethernet", ETHERNET, ethernet_t);
+    phv_factory.push_back_header("vlan", VLAN, vlan_t);
+    phv_factory.push_back_header("mpls[0]", MPLS0, mpls_t);
+    phv_factory.push_back_header("mpls[1]", MPLS1, mpls_t);
+    phv_factory.push_back_header("mpls[2]", MPLS2, mpls_t);
+    phv_factory.push_back_header("ipv4", IPV4, ipv4_t);
+    phv_factory.push_back_header("ipv4_options", IPV4_OPTIONS, ipv4_options_t);
+    phv_factory.push_back_header("ipv6", IPV6, ipv6_t);
+    phv_factory.push_back_header("udp", UDP, udp_t);
+    phv_factory.push_back_header("tcp", TCP, tcp_t);
+    phv_factory.push_back_header("vxlan", VXLAN, vxlan_t);
+    phv_factory.push_back_header("inner_ethernet", INNER_ETHERNET, ethernet_t);
+    phv_factory.push_back_header("inner_ipv4", INNER_IPV4, ipv4_t);
+    phv_factory.push_back_header_stack("mpls", MPLS_STACK, mpls_t,
+                                       {MPLS0, MPLS1, MPLS2});
+    // like in a compiled P4 program, only enable arithmetic for the fields
+    // which need it: ihl (VL length expression), ttl and the MPLS labels
+    phv_factory.enable_field_arith(IPV4, 1);
+    phv_factory.enable_field_arith(IPV4, 7);
+    phv_factory.enable_all_stack_field_arith(MPLS_STACK);
+    phv_source->set_phv_factory(0, &phv_factory);
+
+    build_parse_graph();
+
+    for (auto *deparser : {&deparser_plain, &deparser_csum}) {
+      for (header_id_t h = ETHERNET; h <= INNER_IPV4; h++)
+        deparser->push_back_header(h);
+    }
+    deparser_csum.add_checksum(&ipv4_csum);
+  }
+
+  std::unique_ptr<Parser> make_parser(bool compiled) const {
+    std::unique_ptr<Parser> parser(new Parser("parser", 0, &error_codes));
+    parser->set_init_state(states.front().get());
+    if (compiled) parser->compile(phv_factory);
+    return parser;
+  }
+
+  Packet make_packet(const Bytes &bytes) const {
+    return Packet::make_new(
+        static_cast<int>(bytes.size()),
+        PacketBuffer(bytes.size() + 512, bytes.data(), bytes.size()),
+        phv_source.get());
+  }
+
+  ErrorCode no_error() const {
+    return error_codes.from_core(ErrorCodeMap::Core::NoError);
+  }
+
+  Deparser deparser_plain{"deparser", 0};
+  Deparser deparser_csum{"deparser_csum", 1};
+
+ private:
+  HeaderType &add_type(const std::string &name,
+                       std::vector<std::pair<std::string, int> > fields) {
+    header_types.emplace_back(new HeaderType(name, header_types.size()));
+    for (const auto &f : fields)
+      header_types.back()->push_back_field(f.first, f.second);
+    return *header_types.back();
+  }
+
+  ParseState *add_state(const std::string &name) {
+    states.emplace_back(new ParseState(name, states.size()));
+    return states.back().get();
+  }
+
+  static void add_case(ParseState *state, const std::string &key,
+                       const ParseState *next_state) {
+    state->add_switch_case(ByteContainer(key), next_state);
+  }
+
+  void build_parse_graph() {
+    auto parse_ethernet = add_state("parse_ethernet");
+    auto parse_vlan = add_state("parse_vlan");
+    auto parse_mpls = add_state("parse_mpls");
+    auto parse_ipv4 = add_state("parse_ipv4");
+    auto parse_ipv4_options = add_state("parse_ipv4_options");
+    auto parse_ipv6 = add_state("parse_ipv6");
+    auto parse_udp = add_state("parse_udp");
+    auto parse_tcp = add_state("parse_tcp");
+    auto parse_vxlan = add_state("parse_vxlan");
+    auto parse_inner_ethernet = add_state("parse_inner_ethernet");
+    auto parse_inner_ipv4 = add_state("parse_inner_ipv4");
+
+    parse_ethernet->add_extract(ETHERNET);
+    ParseSwitchKeyBuilder ethernet_key;
+    ethernet_key.push_back_field(ETHERNET, 2, 16);
+    parse_ethernet->set_key_builder(ethernet_key);
+    add_case(parse_ethernet, "0x8100", parse_vlan);
+    add_case(parse_ethernet, "0x8847", parse_mpls);
+    add_case(parse_ethernet, "0x0800", parse_ipv4);
+    add_case(parse_ethernet, "0x86dd", parse_ipv6);
+
+    parse_vlan->add_extract(VLAN);
+    ParseSwitchKeyBuilder vlan_key;
+    vlan_key.push_back_field(VLAN, 3, 16);
+    parse_vlan->set_key_builder(vlan_key);
+    add_case(parse_vlan, "0x0800", parse_ipv4);
+    add_case(parse_vlan, "0x86dd", parse_ipv6);
+
+    parse_mpls->add_extract_to_stack(MPLS_STACK);
+    ParseSwitchKeyBuilder mpls_key;
+    mpls_key.push_back_stack_field(MPLS_STACK, 2, 1);  // bos
+    parse_mpls->set_key_builder(mpls_key);
+    add_case(parse_mpls, "0x00", parse_mpls);
+    add_case(parse_mpls, "0x01", parse_ipv4);
+
+    parse_ipv4->add_extract(IPV4);
+    ParseSwitchKeyBuilder ipv4_key;
+    ipv4_key.push_back_field(IPV4, 1, 4);  // ihl
+    ipv4_key.push_back_field(IPV4, 8, 8);  // protocol
+    parse_ipv4->set_key_builder(ipv4_key);
+    add_case(parse_ipv4, "0x0506", parse_tcp);
+    add_case(parse_ipv4, "0x0511", parse_udp);
+    parse_ipv4->set_default_switch_case(parse_ipv4_options);
+
+    // (ihl - 5) * 32
+    ArithExpression options_len;
+    options_len.push_back_load_field(IPV4, 1);
+    options_len.push_back_load_const(Data(5));
+    options_len.push_back_op(ExprOpcode::SUB);
+    options_len.push_back_load_const(Data(32));
+    options_len.push_back_op(ExprOpcode::MUL);
+    options_len.build();
+    parse_ipv4_options->add_extract_VL(IPV4_OPTIONS, options_len, 40);
+    ParseSwitchKeyBuilder protocol_key;
+    protocol_key.push_back_field(IPV4, 8, 8);
+    parse_ipv4_options->set_key_builder(protocol_key);
+    add_case(parse_ipv4_options, "0x06", parse_tcp);
+    add_case(parse_ipv4_options, "0x11", parse_udp);
+
+    parse_ipv6->add_extract(IPV6);
+    ParseSwitchKeyBuilder ipv6_key;
+    ipv6_key.push_back_field(IPV6, 4, 8);
+    parse_ipv6->set_key_builder(ipv6_key);
+    add_case(parse_ipv6, "0x06", parse_tcp);
+    add_case(parse_ipv6, "0x11", parse_udp);
+
+    parse_udp->add_extract(UDP);
+    ParseSwitchKeyBuilder udp_key;
+    udp_key.push_back_field(UDP, 1, 16);
+    parse_udp->set_key_builder(udp_key);
+    add_case(parse_udp, "0x12b5", parse_vxlan);
+
+    parse_tcp->add_extract(TCP);
+
+    parse_vxlan->add_extract(VXLAN);
+    parse_vxlan->set_default_switch_case(parse_inner_ethernet);
+
+    parse_inner_ethernet->add_extract(INNER_ETHERNET);
+    ParseSwitchKeyBuilder inner_ethernet_key;
+    inner_ethernet_key.push_back_field(INNER_ETHERNET, 2, 16);
+    parse_inner_ethernet->set_key_builder(inner_ethernet_key);
+    add_case(parse_inner_ethernet, "0x0800", parse_inner_ipv4);
+
+    parse_inner_ipv4->add_extract(INNER_IPV4);
+  }
+
+  PHVFactory phv_factory{};
+  ErrorCodeMap error_codes;
+  std::unique_ptr<PHVSourceIface> phv_source;
+  std::vector<std::unique_ptr<HeaderType> > header_types{};
+  std::vector<std::unique_ptr<ParseState> > states{};
+  IPv4Checksum ipv4_csum{"ipv4_csum", 0, IPV4, 9};
+};
+
+constexpr header_stack_id_t Program::MPLS_STACK;
+
+struct Benchmark {
+  std::string name;
+  Bytes packet;
+  // run on each packet between the parser and the deparser, can be empty
+  std::function<void(Packet *)> action;
+  bool update_checksum;
+  bool incremental_checksums;
+  // if true, the deparsed packet is expected to be identical to the input one
+  bool check_output;
+};
+
+void decrement_ttl(Packet *pkt) {
+  auto &ttl = pkt->get_phv()->get_field(Program::IPV4, 7);
+  ttl.set((ttl.get_uint() + 255) & 0xff);
+}
+
+// pops the top label and pushes a new one
+void swap_mpls_label(Packet *pkt) {
+  auto &stack = pkt->get_phv()->get_header_stack(Program::MPLS_STACK);
+  stack.pop_front();
+  stack.push_front();
+  auto &top = stack.at(0);
+  top.mark_valid();
+  top.get_field(0).set(1000);  // label
+  top.get_field(1).set(0);  // tc
+  top.get_field(2).set(0);  // bos
+  top.get_field(3).set(64);  // ttl
+}
+
+std::vector<Benchmark> make_benchmarks() {
+  std::vector<Benchmark> benchmarks;
+  auto add = [&benchmarks](const std::string &name,
+                           std::function<void(Bytes *)> build,
+                           std::function<void(Packet *)> action = nullptr,
+                           bool update_checksum = false,
+                           bool incremental_checksums = false) {
+    Bytes bytes;
+    build(&bytes);
+    append_payload(&bytes);
+    const bool check_output = !action;
+    benchmarks.push_back({name, std::move(bytes), std::move(action),
+                          update_checksum, incremental_checksums,
+                          check_output});
+  };
+
+  add("l2", [](Bytes *b) { append_ethernet(b, 0x88b5); });
+  add("ipv4_tcp", [](Bytes *b) {
+      append_ethernet(b, 0x0800); append_ipv4(b, 6); append_tcp(b); });
+  add("ipv4_udp", [](Bytes *b) {
+      append_ethernet(b, 0x0800); append_ipv4(b, 17); append_udp(b, 53); });
+  add("vlan_ipv4_tcp", [](Bytes *b) {
+      append_ethernet(b, 0x8100); append_vlan(b, 0x0800); append_ipv4(b, 6);
+      append_tcp(b); });
+  add("ipv4_options_tcp", [](Bytes *b) {
+      append_ethernet(b, 0x0800); append_ipv4(b, 6, 3); append_tcp(b); });
+  add("ipv6_tcp", [](Bytes *b) {
+      append_ethernet(b, 0x86dd); append_ipv6(b, 6); append_tcp(b); });
+  add("ipv6_udp", [](Bytes *b) {
+      append_ethernet(b, 0x86dd); append_ipv6(b, 17); append_udp(b, 53); });
+  add("vxlan", [](Bytes *b) {
+      append_ethernet(b, 0x0800); append_ipv4(b, 17); append_udp(b, 4789);
+      append_vxlan(b); append_ethernet(b, 0x0800); append_ipv4(b, 6); });
+  auto mpls = [](Bytes *b) {
+      append_ethernet(b, 0x8847); append_mpls(b, 100, false);
+      append_mpls(b, 200, false); append_mpls(b, 300, true);
+      append_ipv4(b, 6); append_tcp(b); };
+  add("mpls3_ipv4_tcp", mpls);
+  add("mpls3_swap_label", mpls, swap_mpls_label);
+  auto ipv4 = [](Bytes *b) {
+      append_ethernet(b, 0x0800); append_ipv4(b, 6); append_tcp(b); };
+  add("ipv4_ttl_checksum", ipv4, decrement_ttl, true, false);
+  add("ipv4_ttl_checksum_incremental", ipv4, decrement_ttl, true, true);
+  return benchmarks;
+}
+
+// returns false if a packet could not be processed correctly
+bool run(const Program &program, const Benchmark &benchmark, bool compiled,
+         size_t num_repeats) {
+  const size_t batch_size = 64;
+  auto parser = program.make_parser(compiled);
+  const Deparser &deparser = benchmark.update_checksum ?
+      program.deparser_csum : program.deparser_plain;
+  Checksum::set_incremental_updates(benchmark.incremental_checksums);
+
+  std::vector<Packet> packets;
+  for (size_t i = 0; i < batch_size; i++)
+    packets.push_back(program.make_packet(benchmark.packet));
+
+  auto process = [&](Packet *pkt) {
+    parser->parse(pkt);
+    if (benchmark.action) benchmark.action(pkt);
+    deparser.deparse(pkt);
+    // need to reset headers (i.e. mark them invalid) since we are re-using the
+    // same Packet objects
+    pkt->get_phv()->reset();
+    pkt->get_phv()->reset_header_stacks();
+  };
+
+  // warm-up round, also used to check that the program behaves as expected
+  for (auto &pkt : packets) {
+    parser->parse(&pkt);
+    if (pkt.get_error_code() != program.no_error()) {
+      std::cerr << benchmark.name << ": parser error\n";
+      return false;
+    }
+    if (benchmark.action) benchmark.action(&pkt);
+    deparser.deparse(&pkt);
+    if (benchmark.check_output &&
+        Bytes(pkt.data(), pkt.data() + pkt.get_data_size()) !=
+        benchmark.packet) {
+      std::cerr << benchmark.name << ": deparsed packet is different\n";
+      return false;
+    }
+    pkt.get_phv()->reset();
+    pkt.get_phv()->reset_header_stacks();
+  }
+
+  using clock = std::chrono::steady_clock;
+  const size_t allocs_start = num_allocs.load();
+  const auto start = clock::now();
+  for (size_t iter = 0; iter < num_repeats; iter++)
+    for (auto &pkt : packets) process(&pkt);
+  const auto end = clock::now();
+  const size_t allocs = num_allocs.load() - allocs_start;
+
+  const size_t num_packets = num_repeats * batch_size;
+  const double ns = std::chrono::duration<double, std::nano>(end - start)
+      .count();
+  char line[256];
+  std::snprintf(line, sizeof(line),
+                "{\"benchmark\": \"%s\", \"parser\": \"%s\", \"packets\": %zu, "
+                "\"ns_per_packet\": %.1f, \"allocs_per_packet\": %.2f}",
+                benchmark.name.c_str(),
+                compiled ? "compiled" : "interpreted", num_packets,
+                ns / num_packets, static_cast<double>(allocs) / num_packets);
+  std::cout << line << "\n";
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  size_t num_repeats = 1000;
+  if (argc > 1) num_repeats = std::stoul(argv[1]);
+
+  Program program;
+  bool success = true;
+  for (const auto &benchmark : make_benchmarks()) {
+    for (bool compiled : {false, true})
+      success &= run(program, benchmark, compiled, num_repeats);
+  }
+  return success ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the cost of the register array locks when several threads access
+// the same array: exclusive access, which is what actions and parse states use
+// by default, is compared to a plain std::mutex and to striped accesses.
+
+#include <bm/bm_sim/stateful.h>
+
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stress_utils.h"
+
+using ::stress_tests_utils::TestChrono;
+
+namespace {
+
+constexpr size_t register_size = 1024;
+constexpr int register_bw = 32;
+
+void run(const std::string &name, size_t num_threads, size_t num_accesses,
+         const std::function<void(size_t)> &access) {
+  std::cout << name << ":\n";
+  TestChrono chrono(num_threads * num_accesses);
+  chrono.start();
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([t, num_accesses, &access]() {
+      for (size_t i = 0; i < num_accesses; i++)
+        access((t * 17 + i) % register_size);
+    });
+  }
+  for (auto &t : threads) t.join();
+  chrono.end();
+  chrono.print_summary();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  size_t num_threads = 4;
+  size_t num_accesses = 1000000;
+  if (argc > 1) num_threads = std::stoul(argv[1]);
+  if (argc > 2) num_accesses = std::stoul(argv[2]);
+
+  const bm::Data one(1);
+
+  {
+    bm::RegisterArray register_array("baseline", 0, register_size,
+                                     register_bw);
+    std::mutex mutex;
+    run("std::mutex", num_threads, num_accesses,
+        [&register_array, &mutex, &one](size_t idx) {
+          std::lock_guard<std::mutex> lock(mutex);
+          register_array[idx].add(register_array[idx], one);
+        });
+  }
+
+  {
+    bm::RegisterArray register_array("unique_lock", 0, register_size,
+                                     register_bw);
+    run("RegisterArray::unique_lock()", num_threads, num_accesses,
+        [&register_array, &one](size_t idx) {
+          auto lock = register_array.unique_lock();
+          register_array[idx].add(register_array[idx], one);
+        });
+  }
+
+  {
+    bm::RegisterArray register_array("exclusive", 0, register_size,
+                                     register_bw);
+    bm::RegisterSync register_sync;
+    register_sync.add_register_array(&register_array);
+    run("RegisterSync", num_threads, num_accesses,
+        [&register_array, &register_sync, &one](size_t idx) {
+          bm::RegisterSync::RegisterLocks RL;
+          register_sync.lock(&RL);
+          register_array[idx].add(register_array[idx], one);
+        });
+  }
+
+  {
+    bm::RegisterArray register_array("striped", 0, register_size,
+                                     register_bw);
+    register_array.enable_striped_accesses();
+    run("striped", num_threads, num_accesses,
+        [&register_array, &one](size_t idx) {
+          bm::RegisterSync::RegisterLocks RL;
+          bm::RegisterSync::lock_stripe(&register_array, idx, &RL);
+          register_array[idx].add(register_array[idx], one);
+        });
+  }
+}
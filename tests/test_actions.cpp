@@ -953,3 +953,219 @@ TEST_F(ActionsTestRegisterProtection, SequentialAdvanced) {
   ASSERT_LT(expected_timedelta * 0.95, timedelta);
   ASSERT_GT(expected_timedelta * 1.2, timedelta);
 }
+
+class WriteAndSpin
+    : public ActionPrimitive<RegisterArray &, const Data &, const Data &> {
+  void operator ()(RegisterArray &register_array, const Data &idx,
+                   const Data &ts) {
+    register_array.write(idx.get_uint(), ts);
+    std::this_thread::sleep_for(std::chrono::milliseconds(ts.get_uint()));
+  }
+
+  bool uses_striped_register_accesses() const override { return true; }
+};
+
+REGISTER_PRIMITIVE(WriteAndSpin);
+
+// both actions reference the same register, but only through a striped
+// primitive, so parallel execution
+TEST_F(ActionsTestRegisterProtection, ParallelStriped) {
+  WriteAndSpin primitive;
+
+  ActionFn action_fn_1("test_action_striped_1", 2, 0);
+  ActionFnEntry action_fn_entry_1(&action_fn_1);
+  ActionFn action_fn_2("test_action_striped_2", 3, 0);
+  ActionFnEntry action_fn_entry_2(&action_fn_2);
+
+  for (auto action_fn : {&action_fn_1, &action_fn_2}) {
+    action_fn->push_back_primitive(&primitive);
+    action_fn->parameter_push_back_register_array(&register_array_1);
+    action_fn->parameter_push_back_const(
+        Data(action_fn == &action_fn_1 ? 0 : 1));
+    action_fn->parameter_push_back_const(Data(msecs_to_sleep));
+    action_fn->enable_striped_register_accesses();
+  }
+
+  using clock = std::chrono::system_clock;
+  clock::time_point start = clock::now();
+
+  std::thread t(&ActionFnEntry::operator(), &action_fn_entry_1, pkt.get());
+  action_fn_entry_2(pkt.get());
+  t.join();
+
+  clock::time_point end = clock::now();
+
+  auto timedelta = std::chrono::duration_cast<std::chrono::milliseconds>(
+      end - start).count();
+
+  ASSERT_EQ(msecs_to_sleep, register_array_1.at(0).get_uint());
+  ASSERT_EQ(msecs_to_sleep, register_array_1.at(1).get_uint());
+
+  constexpr unsigned int expected_timedelta = msecs_to_sleep;
+
+  ASSERT_LT(expected_timedelta * 0.95, timedelta);
+  ASSERT_GT(expected_timedelta * 1.2, timedelta);
+}
+
+// the second action also locks another register array for its whole duration,
+// so its access to register_array_1 cannot be striped: the array is locked for
+// the action and the striped access made by the first action has to wait
+TEST_F(ActionsTestRegisterProtection, NotStripedWithOtherLock) {
+  WriteAndSpin primitive;
+  RegisterArray register_array_2("register_test_2", 1,
+                                 register_size, register_bw);
+
+  ActionFn action_fn_1("test_action_striped_1", 2, 0);
+  ActionFnEntry action_fn_entry_1(&action_fn_1);
+  action_fn_1.push_back_primitive(&primitive);
+  action_fn_1.parameter_push_back_register_array(&register_array_1);
+  action_fn_1.parameter_push_back_const(Data(0));
+  action_fn_1.parameter_push_back_const(Data(msecs_to_sleep));
+  action_fn_1.enable_striped_register_accesses();
+
+  testActionFn_2.push_back_primitive(&primitive);
+  testActionFn_2.parameter_push_back_register_array(&register_array_1);
+  testActionFn_2.parameter_push_back_const(Data(1));
+  testActionFn_2.parameter_push_back_const(Data(msecs_to_sleep));
+  configure_one_action(&testActionFn_2, &register_array_2);
+  testActionFn_2.enable_striped_register_accesses();
+
+  using clock = std::chrono::system_clock;
+  clock::time_point start = clock::now();
+
+  std::thread t(&ActionFnEntry::operator(), &testActionFnEntry_2, pkt.get());
+  // make sure that the second action locks the arrays first
+  std::this_thread::sleep_for(std::chrono::milliseconds(msecs_to_sleep / 10));
+  action_fn_entry_1(pkt.get());
+  t.join();
+
+  clock::time_point end = clock::now();
+
+  auto timedelta = std::chrono::duration_cast<std::chrono::milliseconds>(
+      end - start).count();
+
+  constexpr unsigned int expected_timedelta = msecs_to_sleep * 3;
+
+  ASSERT_LT(expected_timedelta * 0.95, timedelta);
+  ASSERT_GT(expected_timedelta * 1.2, timedelta);
+}
+
+// the register is also referenced by an expression, so the array is still
+// locked for the action
+TEST_F(ActionsTestRegisterProtection, SequentialNotStriped) {
+  WriteAndSpin primitive;
+
+  std::unique_ptr<ArithExpression> expr_idx(new ArithExpression());
+  expr_idx->push_back_load_register_ref(&register_array_1, 3);
+  expr_idx->build();
+
+  testActionFn_2.push_back_primitive(&primitive);
+  testActionFn_2.parameter_push_back_register_array(&register_array_1);
+  testActionFn_2.parameter_push_back_expression(std::move(expr_idx));
+  testActionFn_2.parameter_push_back_const(Data(msecs_to_sleep));
+  testActionFn_2.enable_striped_register_accesses();
+
+  register_array_1.at(3).set(2);
+
+  auto timedelta = execute_both_actions();
+
+  ASSERT_EQ(msecs_to_sleep, register_array_1.at(2).get_uint());
+
+  constexpr unsigned int expected_timedelta = msecs_to_sleep * 2;
+
+  ASSERT_LT(expected_timedelta * 0.95, timedelta);
+  ASSERT_GT(expected_timedelta * 1.2, timedelta);
+}
+
+class ActionsTestReadModifyWrite : public ActionsTestRegisterProtection {
+ protected:
+  // 2 striped accesses to register_array_1, at indices idx_1 and idx_2; the
+  // action takes msecs_to_sleep in total
+  void configure_rmw_action(ActionFn *action_fn, unsigned int idx_1,
+                            unsigned int idx_2) {
+    for (auto idx : {idx_1, idx_2}) {
+      action_fn->push_back_primitive(&primitive);
+      action_fn->parameter_push_back_register_array(&register_array_1);
+      action_fn->parameter_push_back_const(Data(idx));
+      action_fn->parameter_push_back_const(Data(msecs_to_sleep / 2));
+    }
+    action_fn->enable_striped_register_accesses();
+  }
+
+  std::chrono::milliseconds::rep execute_rmw_actions(unsigned int idx_1,
+                                                     unsigned int idx_2) {
+    ActionFn action_fn_1("test_action_rmw_1", 2, 0);
+    ActionFnEntry action_fn_entry_1(&action_fn_1);
+    ActionFn action_fn_2("test_action_rmw_2", 3, 0);
+    ActionFnEntry action_fn_entry_2(&action_fn_2);
+    configure_rmw_action(&action_fn_1, idx_1, idx_1);
+    configure_rmw_action(&action_fn_2, idx_2, idx_2);
+
+    using clock = std::chrono::system_clock;
+    clock::time_point start = clock::now();
+
+    std::thread t(&ActionFnEntry::operator(), &action_fn_entry_1, pkt.get());
+    // make sure that the first action starts first
+    std::this_thread::sleep_for(std::chrono::milliseconds(msecs_to_sleep / 10));
+    action_fn_entry_2(pkt.get());
+    t.join();
+
+    clock::time_point end = clock::now();
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+        .count();
+  }
+
+  WriteAndSpin primitive{};
+};
+
+// each action accesses one register twice, the actions access registers in
+// different stripes, so parallel execution
+TEST_F(ActionsTestReadModifyWrite, Parallel) {
+  auto timedelta = execute_rmw_actions(0, 1);
+
+  constexpr unsigned int expected_timedelta = msecs_to_sleep;
+
+  ASSERT_LT(expected_timedelta * 0.95, timedelta);
+  ASSERT_GT(expected_timedelta * 1.2, timedelta);
+}
+
+// the actions access the same register, and the stripe is held across both
+// accesses, so sequential execution
+TEST_F(ActionsTestReadModifyWrite, Sequential) {
+  auto timedelta = execute_rmw_actions(0, 0);
+
+  constexpr unsigned int expected_timedelta = msecs_to_sleep * 2;
+
+  ASSERT_LT(expected_timedelta * 0.95, timedelta);
+  ASSERT_GT(expected_timedelta * 1.2, timedelta);
+}
+
+// the second action accesses 2 different registers, so the array is locked for
+// the whole action
+TEST_F(ActionsTestReadModifyWrite, DifferentIndices) {
+  ActionFn action_fn_1("test_action_rmw_1", 2, 0);
+  ActionFnEntry action_fn_entry_1(&action_fn_1);
+  ActionFn action_fn_2("test_action_rmw_2", 3, 0);
+  ActionFnEntry action_fn_entry_2(&action_fn_2);
+  configure_rmw_action(&action_fn_1, 0, 0);
+  configure_rmw_action(&action_fn_2, 1, 2);
+
+  using clock = std::chrono::system_clock;
+  clock::time_point start = clock::now();
+
+  std::thread t(&ActionFnEntry::operator(), &action_fn_entry_2, pkt.get());
+  std::this_thread::sleep_for(std::chrono::milliseconds(msecs_to_sleep / 10));
+  action_fn_entry_1(pkt.get());
+  t.join();
+
+  clock::time_point end = clock::now();
+
+  auto timedelta = std::chrono::duration_cast<std::chrono::milliseconds>(
+      end - start).count();
+
+  constexpr unsigned int expected_timedelta = msecs_to_sleep * 2;
+
+  ASSERT_LT(expected_timedelta * 0.95, timedelta);
+  ASSERT_GT(expected_timedelta * 1.2, timedelta);
+}
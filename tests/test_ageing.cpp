@@ -32,6 +32,7 @@
 #include <vector>
 
 #include <cassert>
+#include <cstring>
 
 #include "utils.h"
 
@@ -196,3 +197,62 @@ TEST_F(AgeingTest, NoDuplicate) {
   elapsed = duration_cast<milliseconds>(tp4 - tp3).count();
   ASSERT_GT(elapsed, (unsigned int) (sweep_int * 1.5));
 }
+
+// the timer of the entry is re-armed every time it fires, as long as the entry
+// keeps being hit
+TEST_F(AgeingTest, HitEntryNotAged) {
+  std::string key_("\x0a\xba");
+  std::string key("0x0aba");
+  entry_handle_t handle_1;
+  entry_handle_t lookup_handle;
+  unsigned int sweep_int = 50u;
+  unsigned int ttl = 200u;
+  init_monitor(sweep_int);
+  ASSERT_EQ(MatchErrorCode::SUCCESS, add_entry(key_, &handle_1, ttl));
+  for (int i = 0; i < 8; i++) {
+    sleep_for(milliseconds(ttl / 2));
+    ASSERT_TRUE(send_pkt(key, &lookup_handle));
+    ASSERT_NE(MemoryAccessor::Status::CAN_READ, ageing_writer->check_status());
+  }
+
+  auto tp1 = clock::now();
+  ageing_writer->read(buffer, sizeof(buffer));
+  auto tp2 = clock::now();
+
+  unsigned int elapsed = duration_cast<milliseconds>(tp2 - tp1).count();
+  ASSERT_GT(elapsed, ttl - 20u);
+  ASSERT_LT(elapsed, ttl + sweep_int + 20u);
+
+  AgeingMonitorIface::msg_hdr_t msg_hdr;
+  std::memcpy(&msg_hdr, buffer, sizeof(msg_hdr));
+  ASSERT_EQ(1u, msg_hdr.num_entries);
+  entry_handle_t handle;
+  std::memcpy(&handle, buffer + sizeof(msg_hdr), sizeof(handle));
+  ASSERT_EQ(handle_1, handle);
+}
+
+// a new TTL takes effect right away, even if it is smaller than the previous
+// one
+TEST_F(AgeingTest, UpdateTTL) {
+  std::string key_("\x0a\xba");
+  entry_handle_t handle_1;
+  unsigned int sweep_int = 50u;
+  init_monitor(sweep_int);
+  ASSERT_EQ(MatchErrorCode::SUCCESS, add_entry(key_, &handle_1, 100000u));
+  sleep_for(milliseconds(2 * sweep_int));
+
+  unsigned int ttl = 200u;
+  auto tp1 = clock::now();
+  ASSERT_EQ(MatchErrorCode::SUCCESS, table->set_entry_ttl(handle_1, ttl));
+  ageing_writer->read(buffer, sizeof(buffer));
+  auto tp2 = clock::now();
+
+  unsigned int elapsed = duration_cast<milliseconds>(tp2 - tp1).count();
+  ASSERT_GT(elapsed, ttl - 20u);
+  ASSERT_LT(elapsed, ttl + sweep_int + 20u);
+
+  // a TTL of 0 disables ageing for the entry
+  ASSERT_EQ(MatchErrorCode::SUCCESS, table->set_entry_ttl(handle_1, 0u));
+  sleep_for(milliseconds(3 * ttl));
+  ASSERT_NE(MemoryAccessor::Status::CAN_READ, ageing_writer->check_status());
+}
@@ -460,6 +460,162 @@ TEST(HashTest, Crc32Custom) {
                 ptr.get(), {0, 0, 0, true, true}));
 }
 
+namespace {
+
+// straightforward bit-at-a-time implementations, used to check that the
+// optimized implementations in calculations.cpp are bit-exact
+template <typename T>
+T reference_crc(const bm::detail::crc_config_t<T> &config,
+                const std::vector<char> &buf) {
+  const int width = sizeof(T) * 8;
+  auto reflect = [](T v, int nbits) {
+    T r = 0;
+    for (int i = 0; i < nbits; i++) {
+      if (v & (static_cast<T>(1) << i))
+        r |= static_cast<T>(1) << (nbits - 1 - i);
+    }
+    return r;
+  };
+  T remainder = config.initial_remainder;
+  for (char c : buf) {
+    T byte = static_cast<unsigned char>(c);
+    if (config.data_reflected) byte = reflect(byte, 8);
+    remainder ^= static_cast<T>(byte << (width - 8));
+    for (int bit = 0; bit < 8; bit++) {
+      const bool msb = remainder & (static_cast<T>(1) << (width - 1));
+      remainder = static_cast<T>(remainder << 1);
+      if (msb) remainder ^= config.polynomial;
+    }
+  }
+  if (config.remainder_reflected) remainder = reflect(remainder, width);
+  return remainder ^ config.final_xor_value;
+}
+
+uint16_t reference_cksum16(const std::vector<char> &buf) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i < buf.size(); i += 2) {
+    uint16_t word = static_cast<unsigned char>(buf[i]) << 8;
+    if (i + 1 < buf.size()) word |= static_cast<unsigned char>(buf[i + 1]);
+    sum += word;
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return ~sum;
+}
+
+// random buffers of all lengths between 0 and 64 bytes, to exercise both the
+// 8-bytes-at-a-time loops and the handling of the remaining bytes
+std::vector<std::vector<char> > random_buffers() {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dis(0, 255);
+  std::vector<std::vector<char> > buffers;
+  for (size_t len = 0; len <= 64; len++) {
+    for (int i = 0; i < 8; i++) {
+      std::vector<char> buf(len);
+      for (auto &c : buf) c = static_cast<char>(dis(gen));
+      buffers.push_back(std::move(buf));
+    }
+  }
+  return buffers;
+}
+
+template <typename T>
+void check_crc_bit_exact(const CalculationsMap::MyC &c,
+                         const bm::detail::crc_config_t<T> &config) {
+  for (const auto &buf : random_buffers()) {
+    ASSERT_EQ(reference_crc<T>(config, buf), c.output(buf.data(), buf.size()))
+        << "for length " << buf.size();
+  }
+}
+
+}  // namespace
+
+TEST(HashTest, BitExact) {
+  auto *map = CalculationsMap::get_instance();
+  check_crc_bit_exact<uint16_t>(*map->get_copy("crc16"),
+                                {0x8005, 0x0000, 0x0000, true, true});
+  check_crc_bit_exact<uint16_t>(*map->get_copy("crcCCITT"),
+                                {0x1021, 0xffff, 0x0000, false, false});
+  check_crc_bit_exact<uint32_t>(*map->get_copy("crc32"),
+                                {0x04c11db7, 0xffffffff, 0xffffffff, true,
+                                 true});
+  for (const char *name : {"cksum16", "csum16"}) {
+    auto ptr = map->get_copy(name);
+    for (const auto &buf : random_buffers())
+      ASSERT_EQ(reference_cksum16(buf), ptr->output(buf.data(), buf.size()));
+  }
+}
+
+TEST(HashTest, CustomCrcBitExact) {
+  auto *map = CalculationsMap::get_instance();
+  const std::vector<bm::detail::crc_config_t<uint8_t> > configs_8 = {
+    {0x07, 0x00, 0x00, false, false}, {0x31, 0x00, 0x00, true, true},
+    {0x9b, 0x12, 0x34, true, false}, {0x1d, 0xfd, 0x00, false, true}};
+  const std::vector<bm::detail::crc_config_t<uint16_t> > configs_16 = {
+    {0x8005, 0x0000, 0x0000, true, true},
+    {0x1021, 0xffff, 0x0000, false, false},
+    {0x3d65, 0x0000, 0xffff, true, false},
+    {0x8bb7, 0x1234, 0x0000, false, true}};
+  // the second one is CRC-32C, which may use the SSE4.2 instruction
+  const std::vector<bm::detail::crc_config_t<uint32_t> > configs_32 = {
+    {0x04c11db7, 0xffffffff, 0xffffffff, true, true},
+    {0x1edc6f41, 0xffffffff, 0xffffffff, true, true},
+    {0x04c11db7, 0xffffffff, 0x00000000, false, false},
+    {0x814141ab, 0x00000000, 0x00000000, true, false}};
+  const std::vector<bm::detail::crc_config_t<uint64_t> > configs_64 = {
+    {0x000000000000001bULL, 0x0ULL, 0x0ULL, true, true},
+    {0x42f0e1eba9ea3693ULL, 0xffffffffffffffffULL, 0xffffffffffffffffULL,
+     false, false},
+    {0xad93d23594c935a9ULL, 0xffffffffffffffffULL, 0x0ULL, false, true}};
+
+  auto ptr_8 = map->get_copy("crc8_custom");
+  for (const auto &config : configs_8) {
+    ASSERT_EQ(CustomCrcErrorCode::SUCCESS,
+              CustomCrcMgr<uint8_t>::update_config(ptr_8.get(), config));
+    check_crc_bit_exact<uint8_t>(*ptr_8, config);
+  }
+  auto ptr_16 = map->get_copy("crc16_custom");
+  for (const auto &config : configs_16) {
+    ASSERT_EQ(CustomCrcErrorCode::SUCCESS,
+              CustomCrcMgr<uint16_t>::update_config(ptr_16.get(), config));
+    check_crc_bit_exact<uint16_t>(*ptr_16, config);
+  }
+  auto ptr_32 = map->get_copy("crc32_custom");
+  for (const auto &config : configs_32) {
+    ASSERT_EQ(CustomCrcErrorCode::SUCCESS,
+              CustomCrcMgr<uint32_t>::update_config(ptr_32.get(), config));
+    check_crc_bit_exact<uint32_t>(*ptr_32, config);
+  }
+  auto ptr_64 = map->get_copy("crc64_custom");
+  for (const auto &config : configs_64) {
+    ASSERT_EQ(CustomCrcErrorCode::SUCCESS,
+              CustomCrcMgr<uint64_t>::update_config(ptr_64.get(), config));
+    check_crc_bit_exact<uint64_t>(*ptr_64, config);
+  }
+}
+
+// computing the hash of fragments must give the same result as computing the
+// hash of their concatenation, whether or not the algorithm supports it
+TEST(HashTest, Fragments) {
+  const std::vector<const char *> names = {
+    "xxh64", "crc16", "crc32", "crcCCITT", "cksum16", "csum16", "identity",
+    "crc8_custom", "crc16_custom", "crc32_custom", "crc64_custom",
+    "Hash"  /* no gather method */};
+  const auto buffers = random_buffers();
+  for (const char *name : names) {
+    auto ptr = CalculationsMap::get_instance()->get_copy(name);
+    ASSERT_NE(nullptr, ptr);
+    for (const auto &buf : buffers) {
+      const auto expected = ptr->output(buf.data(), buf.size());
+      for (size_t split = 0; split <= buf.size(); split++) {
+        const HashFragment fragments[2] = {
+          {buf.data(), split}, {buf.data() + split, buf.size() - split}};
+        ASSERT_EQ(expected, ptr->output(fragments, 2))
+            << name << " for length " << buf.size() << " split at " << split;
+      }
+    }
+  }
+}
+
 class CrcMapTest : public ::testing::TestWithParam<const char *> { };
 
 namespace {
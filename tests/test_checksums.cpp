@@ -317,6 +317,201 @@ TEST_F(ChecksumTest, TCPChecksumUpdate) {
   ASSERT_EQ(cksum, tcp_checksum.get_uint());
 }
 
+class IncrementalChecksumTest : public ChecksumTest {
+ protected:
+  std::unique_ptr<NamedCalculation> tcp_calc{nullptr};
+  std::unique_ptr<CalcBasedChecksum> tcp_engine{nullptr};
+
+  IncrementalChecksumTest() {
+    // same as tcp_cksum_engine, but with a constant for the TCP length, which
+    // means that the original value of all the inputs is known
+    BufBuilder builder;
+    builder.push_back_field(ipv4Header, 10);  // ipv4.srcAddr
+    builder.push_back_field(ipv4Header, 11);  // ipv4.dstAddr
+    builder.push_back_constant(ByteContainer(1, '\x00'), 8);
+    builder.push_back_field(ipv4Header, 8);  // ipv4.protocol
+    builder.push_back_constant(ByteContainer("0x0020"), 16);  // tcpLength
+    for (int f = 0; f < 10; f++) {
+      if (f != 8) builder.push_back_field(tcpHeader, f);  // skip tcp.checksum
+    }
+    builder.append_payload();
+    tcp_calc = std::unique_ptr<NamedCalculation>(
+        new NamedCalculation("tcp_calc", 1, builder, "csum16"));
+    tcp_engine = std::unique_ptr<CalcBasedChecksum>(
+        new CalcBasedChecksum("tcp_engine", 2, tcpHeader, 8, tcp_calc.get()));
+  }
+
+  void SetUp() override {
+    ChecksumTest::SetUp();
+    Checksum::set_incremental_updates(true);
+  }
+
+  void TearDown() override {
+    Checksum::set_incremental_updates(false);
+  }
+
+  // raw_tcp_pkt with an incorrect checksum at byte offset cksum_offset, and
+  // with the given IPv4 protocol
+  Packet get_pkt_with_bad_cksum(size_t cksum_offset, unsigned char protocol) {
+    unsigned char data[sizeof(raw_tcp_pkt)];
+    std::memcpy(data, raw_tcp_pkt, sizeof(data));
+    data[14 + 9] = protocol;
+    data[cksum_offset] ^= 0x01;
+    auto pkt = Packet::make_new(
+        sizeof(data),
+        PacketBuffer(256, reinterpret_cast<const char *>(data), sizeof(data)),
+        phv_source.get());
+    parser.parse(&pkt);
+    return pkt;
+  }
+
+  // an incorrect checksum in the incoming packet remains incorrect with an
+  // incremental update, while a full computation fixes it, which tells us
+  // which path was taken
+  static bool updated_incrementally(const Checksum &engine, Packet *pkt) {
+    engine.update(pkt);
+    return !engine.verify(*pkt);
+  }
+};
+
+TEST_F(IncrementalChecksumTest, IPv4) {
+  uint16_t cksum;
+  auto packet = get_ipv4_pkt(&cksum);
+  auto phv = packet.get_phv();
+  parser.parse(&packet);
+
+  IPv4Checksum cksum_engine("ipv4_checksum", 0, ipv4Header, 9);
+  auto &ipv4_checksum = phv->get_field(ipv4Header, 9);
+
+  // header not modified
+  cksum_engine.update(&packet);
+  ASSERT_EQ(cksum, ipv4_checksum.get_uint());
+
+  for (unsigned int i = 0; i < 1000; i++) {
+    phv->get_field(ipv4Header, 7).set(i % 256);  // ttl
+    phv->get_field(ipv4Header, 4).set(i * 7919);  // id
+    phv->get_field(ipv4Header, 10).set(i * 104729);  // srcAddr
+    cksum_engine.update(&packet);
+    const auto incremental = ipv4_checksum.get_uint();
+    Checksum::set_incremental_updates(false);
+    cksum_engine.update(&packet);
+    Checksum::set_incremental_updates(true);
+    ASSERT_EQ(ipv4_checksum.get_uint(), incremental);
+  }
+}
+
+TEST_F(IncrementalChecksumTest, TCP) {
+  uint16_t cksum;
+  uint16_t tcp_len;
+  auto packet = get_tcp_pkt(&cksum, &tcp_len);
+  auto phv = packet.get_phv();
+  parser.parse(&packet);
+
+  auto &tcp_checksum = phv->get_field(tcpHeader, 8);
+
+  tcp_engine->update(&packet);
+  ASSERT_EQ(cksum, tcp_checksum.get_uint());
+
+  for (unsigned int i = 0; i < 1000; i++) {
+    phv->get_field(ipv4Header, 10).set(i * 104729);  // srcAddr
+    phv->get_field(tcpHeader, 0).set(i * 7919);  // srcPort
+    phv->get_field(tcpHeader, 5).set(i % 16);  // res, not byte-aligned
+    tcp_engine->update(&packet);
+    const auto incremental = tcp_checksum.get_uint();
+    Checksum::set_incremental_updates(false);
+    tcp_engine->update(&packet);
+    Checksum::set_incremental_updates(true);
+    ASSERT_EQ(tcp_checksum.get_uint(), incremental);
+  }
+}
+
+// Which common checksum configurations take the incremental path, e.g. for a
+// NAT rewriting the IPv4 source address and the L4 source port
+TEST_F(IncrementalChecksumTest, Configurations) {
+  // IPv4 header checksum: always incremental
+  {
+    auto packet = get_pkt_with_bad_cksum(14 + 10, 6);
+    auto phv = packet.get_phv();
+    phv->get_field(ipv4Header, 10).set(0x0a000001);  // srcAddr
+    IPv4Checksum cksum_engine("ipv4_checksum", 0, ipv4Header, 9);
+    EXPECT_TRUE(updated_incrementally(cksum_engine, &packet));
+  }
+  // UDP checksum, the pseudo-header uses the udp.length field: incremental
+  {
+    auto packet = get_pkt_with_bad_cksum(14 + 20 + 6, 17);
+    auto phv = packet.get_phv();
+    BufBuilder builder;
+    builder.push_back_field(ipv4Header, 10);  // ipv4.srcAddr
+    builder.push_back_field(ipv4Header, 11);  // ipv4.dstAddr
+    builder.push_back_constant(ByteContainer(1, '\x00'), 8);
+    builder.push_back_field(ipv4Header, 8);  // ipv4.protocol
+    builder.push_back_field(udpHeader, 2);  // udp.length
+    builder.push_back_field(udpHeader, 0);  // udp.srcPort
+    builder.push_back_field(udpHeader, 1);  // udp.dstPort
+    builder.push_back_field(udpHeader, 2);  // udp.length
+    builder.append_payload();
+    NamedCalculation calc("udp_calc", 3, builder, "csum16");
+    CalcBasedChecksum cksum_engine("udp_engine", 4, udpHeader, 3, &calc);
+    phv->get_field(ipv4Header, 10).set(0x0a000001);  // srcAddr
+    phv->get_field(udpHeader, 0).set(0xabcd);  // srcPort
+    EXPECT_TRUE(updated_incrementally(cksum_engine, &packet));
+  }
+  // TCP checksum, the TCP length in the pseudo-header comes from metadata (or
+  // from a compiler temporary, which is also metadata): full computation
+  {
+    uint16_t cksum;
+    uint16_t tcp_len;
+    get_tcp_pkt(&cksum, &tcp_len);
+    auto packet = get_pkt_with_bad_cksum(14 + 20 + 16, 6);
+    auto phv = packet.get_phv();
+    phv->get_field(metaHeader, 0).set(tcp_len);
+    phv->get_field(ipv4Header, 10).set(0x0a000001);  // srcAddr
+    phv->get_field(tcpHeader, 0).set(0xabcd);  // srcPort
+    EXPECT_FALSE(updated_incrementally(*tcp_cksum_engine, &packet));
+  }
+}
+
+// the TCP length comes from metadata in tcp_cksum_engine, we have to fall back
+// to a full computation
+TEST_F(IncrementalChecksumTest, Fallback) {
+  uint16_t cksum;
+  uint16_t tcp_len;
+  auto packet = get_tcp_pkt(&cksum, &tcp_len);
+  auto phv = packet.get_phv();
+  parser.parse(&packet);
+
+  phv->get_field(metaHeader, 0).set(tcp_len);
+  phv->get_field(tcpHeader, 0).set(0xabcd);  // srcPort
+
+  tcp_cksum_engine->update(&packet);
+  ASSERT_TRUE(tcp_cksum_engine->verify(packet));
+}
+
+// hidden fields cannot be read from the packet, we have to fall back to a full
+// computation
+TEST_F(IncrementalChecksumTest, FallbackHiddenField) {
+  uint16_t cksum;
+  uint16_t tcp_len;
+  auto packet = get_tcp_pkt(&cksum, &tcp_len);
+  auto phv = packet.get_phv();
+  parser.parse(&packet);
+
+  const auto valid_offset = static_cast<int>(
+      tcpHeaderType.get_hidden_offset(HeaderType::HiddenF::VALID));
+  BufBuilder builder;
+  for (int f = 0; f < 10; f++) {
+    if (f != 8) builder.push_back_field(tcpHeader, f);  // skip tcp.checksum
+  }
+  builder.push_back_constant(ByteContainer(1, '\x00'), 7);
+  builder.push_back_field(tcpHeader, valid_offset);
+  NamedCalculation calc("calc", 3, builder, "csum16");
+  CalcBasedChecksum engine("engine", 4, tcpHeader, 8, &calc);
+
+  phv->get_field(tcpHeader, 0).set(0xabcd);  // srcPort
+  engine.update(&packet);
+  ASSERT_TRUE(engine.verify(packet));
+}
+
 
 class ChecksumConditionTest : public ::testing::Test {
  protected:
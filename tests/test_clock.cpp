@@ -0,0 +1,105 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <bm/bm_sim/clock.h>
+
+#include <chrono>
+#include <thread>
+
+using namespace bm;
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::this_thread::sleep_for;
+
+// Google Test fixture for clock tests
+class ClockTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    Clock::set_resolution(Clock::Consumer::METERS, microseconds(0));
+    Clock::set_resolution(Clock::Consumer::AGEING, microseconds(0));
+  }
+};
+
+TEST_F(ClockTest, ConsumerFromName) {
+  ASSERT_EQ(Clock::Consumer::AGEING, Clock::consumer_from_name("ageing"));
+  ASSERT_EQ(Clock::Consumer::METERS, Clock::consumer_from_name("meters"));
+  ASSERT_EQ(Clock::Consumer::QUEUEING, Clock::consumer_from_name("queueing"));
+  ASSERT_EQ(Clock::Consumer::TIMESTAMPS,
+            Clock::consumer_from_name("timestamps"));
+  ASSERT_EQ(Clock::Consumer::NUM_CONSUMERS, Clock::consumer_from_name("bad"));
+}
+
+TEST_F(ClockTest, Exact) {
+  ASSERT_EQ(microseconds(0), Clock::get_resolution(Clock::Consumer::METERS));
+  auto t1 = Clock::now(Clock::Consumer::METERS);
+  sleep_for(milliseconds(2));
+  auto t2 = Clock::now(Clock::Consumer::METERS);
+  ASSERT_GE(t2 - t1, milliseconds(2));
+  // same epoch as the steady clock
+  ASSERT_LE(t2, Clock::clock::now());
+}
+
+TEST_F(ClockTest, Coarse) {
+  const auto resolution = milliseconds(50);
+  Clock::set_resolution(Clock::Consumer::METERS, resolution);
+  ASSERT_EQ(resolution, Clock::get_resolution(Clock::Consumer::METERS));
+  ASSERT_EQ(microseconds(0), Clock::get_resolution(Clock::Consumer::AGEING));
+
+  auto t1 = Clock::now(Clock::Consumer::METERS);
+  auto exact = Clock::clock::now();
+  ASSERT_LE(t1, exact);
+  ASSERT_LE(exact - t1, resolution * 2);
+
+  // the cached time is not refreshed for every call, but the ticker may have
+  // run in between
+  auto t1_again = Clock::now(Clock::Consumer::METERS);
+  ASSERT_GE(t1_again, t1);
+  ASSERT_LE(t1_again - t1, resolution * 2);
+
+  // other consumers are not affected
+  auto t2 = Clock::now(Clock::Consumer::AGEING);
+  ASSERT_NE(t1, t2);
+
+  // but the cached time keeps advancing
+  sleep_for(resolution * 3);
+  auto t3 = Clock::now(Clock::Consumer::METERS);
+  ASSERT_GT(t3, t1);
+  ASSERT_LE(t3, Clock::clock::now());
+}
+
+TEST_F(ClockTest, SmallestResolution) {
+  Clock::set_resolution(Clock::Consumer::METERS, milliseconds(500));
+  Clock::set_resolution(Clock::Consumer::AGEING, milliseconds(10));
+  // the ticker runs at the smallest resolution, for every consumer
+  auto t1 = Clock::now(Clock::Consumer::METERS);
+  sleep_for(milliseconds(100));
+  auto t2 = Clock::now(Clock::Consumer::METERS);
+  ASSERT_GT(t2, t1);
+  ASSERT_LT(t2 - t1, milliseconds(500));
+}
+
+TEST_F(ClockTest, BackToExact) {
+  Clock::set_resolution(Clock::Consumer::METERS, milliseconds(500));
+  auto t1 = Clock::now(Clock::Consumer::METERS);
+  Clock::set_resolution(Clock::Consumer::METERS, microseconds(0));
+  ASSERT_EQ(microseconds(0), Clock::get_resolution(Clock::Consumer::METERS));
+  sleep_for(milliseconds(1));
+  auto t2 = Clock::now(Clock::Consumer::METERS);
+  ASSERT_GE(t2 - t1, milliseconds(1));
+  ASSERT_NE(t2, Clock::now(Clock::Consumer::METERS));
+}
@@ -21,8 +21,16 @@
 #include <gtest/gtest.h>
 
 #include <bm/bm_sim/actions.h>
+#include <bm/bm_sim/conditionals.h>
 #include <bm/bm_sim/control_action.h>
+#include <bm/bm_sim/core/primitives.h>
 #include <bm/bm_sim/packet.h>
+#include <bm/bm_sim/pipeline.h>
+#include <bm/bm_sim/tables.h>
+
+#include <memory>
+#include <string>
+#include <vector>
 
 using namespace bm;
 
@@ -82,3 +90,202 @@ TEST_F(ControlActionTest, Call) {
   EXPECT_EQ(&dummy_next_node, next_node);
   EXPECT_EQ(1u, count_primitive.get());
 }
+
+// pipeline is: if (h.f8 == 1) { t.apply(); }, with t matching exactly on h.f16
+// and calling an action which sets h.f32
+class FlowCacheTest : public ::testing::Test {
+ protected:
+  PHVFactory phv_factory;
+  std::unique_ptr<PHVSourceIface> phv_source{nullptr};
+
+  HeaderType header_type;
+  const header_id_t h{0};
+  const int f16{0}, f32{1}, f8{2}, f_other{3};
+
+  core::assign assign_primitive;
+  count count_primitive;
+  ActionFn action_fn, count_fn;
+
+  LookupStructureFactory lookup_factory;
+  MatchTable *table{nullptr};
+  std::unique_ptr<MatchActionTable> table_node{nullptr};
+  Conditional condition;
+  Pipeline pipeline;
+
+  FlowCacheTest()
+      : phv_source(PHVSourceIface::make_phv_source()),
+        header_type("test_t", 0),
+        action_fn("set_f32", 0, 1), count_fn("count", 1, 0),
+        condition("condition", 0),
+        pipeline("pipeline", 0, &condition) {
+    header_type.push_back_field("f16", 16);
+    header_type.push_back_field("f32", 32);
+    header_type.push_back_field("f8", 8);
+    header_type.push_back_field("f_other", 16);
+    phv_factory.push_back_header("h", h, header_type);
+
+    MatchKeyBuilder key_builder;
+    key_builder.push_back_field(h, f16, 16, MatchKeyParam::Type::EXACT);
+    using MUExact = MatchUnitExact<ActionEntry>;
+    std::unique_ptr<MUExact> match_unit(
+        new MUExact(64, key_builder, &lookup_factory));
+    table = new MatchTable("t", 0, std::move(match_unit));
+    table->set_next_node(action_fn.get_id(), nullptr);
+    table->set_next_node(count_fn.get_id(), nullptr);
+    table->set_next_node_miss_default(nullptr);
+    table_node = std::unique_ptr<MatchActionTable>(new MatchActionTable(
+        "t", 0, std::unique_ptr<MatchTableAbstract>(table)));
+
+    condition.push_back_load_field(h, f8);
+    condition.push_back_load_const(Data(1));
+    condition.push_back_op(ExprOpcode::EQ_DATA);
+    condition.build();
+    condition.set_next_node_if_true(table_node.get());
+    condition.set_next_node_if_false(nullptr);
+
+    action_fn.push_back_primitive(&assign_primitive);
+    action_fn.parameter_push_back_field(h, f32);
+    action_fn.parameter_push_back_action_data(0);
+    action_fn.set_flow_cacheable(true);
+
+    count_fn.push_back_primitive(&count_primitive);
+
+    pipeline.enable_flow_cache(1024);
+  }
+
+  virtual void SetUp() {
+    phv_source->set_phv_factory(0, &phv_factory);
+  }
+
+  Packet get_pkt(int v16, int v8, int v_other) {
+    Packet pkt = Packet::make_new(64, PacketBuffer(128), phv_source.get());
+    Header &hdr = pkt.get_phv()->get_header(h);
+    hdr.mark_valid();
+    hdr.get_field(f16).set(v16);
+    hdr.get_field(f8).set(v8);
+    hdr.get_field(f_other).set(v_other);
+    return pkt;
+  }
+
+  entry_handle_t add_entry(const std::string &key, const ActionFn *action,
+                           int v) {
+    std::vector<MatchKeyParam> match_key;
+    match_key.emplace_back(MatchKeyParam::Type::EXACT, key);
+    ActionData action_data;
+    if (action == &action_fn) action_data.push_back_action_data(v);
+    entry_handle_t handle;
+    EXPECT_EQ(MatchErrorCode::SUCCESS,
+              table->add_entry(match_key, action, action_data, &handle));
+    return handle;
+  }
+
+  int get_f32(Packet *pkt) {
+    return pkt->get_phv()->get_field(h, f32).get_int();
+  }
+};
+
+TEST_F(FlowCacheTest, Replay) {
+  add_entry(std::string("\x00\xaa", 2), &action_fn, 0x1234);
+  FlowCache *cache = pipeline.get_flow_cache();
+
+  auto pkt_1 = get_pkt(0xaa, 1, 0);
+  pipeline.apply(&pkt_1);
+  EXPECT_EQ(0x1234, get_f32(&pkt_1));
+  EXPECT_EQ(1u, cache->get_num_entries());
+
+  // f_other is not consulted by the pipeline
+  auto pkt_2 = get_pkt(0xaa, 1, 99);
+  ASSERT_TRUE(cache->lookup(&pkt_2));
+  EXPECT_EQ(0x1234, get_f32(&pkt_2));
+  EXPECT_EQ(99, pkt_2.get_phv()->get_field(h, f_other).get_int());
+
+  // table miss
+  auto pkt_3 = get_pkt(0xbb, 1, 0);
+  EXPECT_FALSE(cache->lookup(&pkt_3));
+  pipeline.apply(&pkt_3);
+  EXPECT_EQ(0, get_f32(&pkt_3));
+  EXPECT_EQ(2u, cache->get_num_entries());
+  auto pkt_4 = get_pkt(0xbb, 1, 0);
+  EXPECT_TRUE(cache->lookup(&pkt_4));
+  EXPECT_EQ(0, get_f32(&pkt_4));
+
+  // table is not applied, the path consults fewer fields
+  auto pkt_5 = get_pkt(0xaa, 2, 0);
+  EXPECT_FALSE(cache->lookup(&pkt_5));
+  pipeline.apply(&pkt_5);
+  EXPECT_EQ(0, get_f32(&pkt_5));
+  auto pkt_6 = get_pkt(0xcc, 2, 0);
+  EXPECT_TRUE(cache->lookup(&pkt_6));
+  EXPECT_EQ(3u, cache->get_num_entries());
+}
+
+TEST_F(FlowCacheTest, Invalidation) {
+  auto handle = add_entry(std::string("\x00\xaa", 2), &action_fn, 0x1234);
+
+  auto pkt_1 = get_pkt(0xaa, 1, 0);
+  pipeline.apply(&pkt_1);
+  EXPECT_EQ(0x1234, get_f32(&pkt_1));
+
+  ActionData action_data;
+  action_data.push_back_action_data(0x5678);
+  ASSERT_EQ(MatchErrorCode::SUCCESS,
+            table->modify_entry(handle, &action_fn, std::move(action_data)));
+
+  auto pkt_2 = get_pkt(0xaa, 1, 0);
+  EXPECT_FALSE(pipeline.get_flow_cache()->lookup(&pkt_2));
+  pipeline.apply(&pkt_2);
+  EXPECT_EQ(0x5678, get_f32(&pkt_2));
+}
+
+TEST_F(FlowCacheTest, NotCacheable) {
+  add_entry(std::string("\x00\xaa", 2), &count_fn, 0);
+
+  for (size_t i = 1; i <= 3; i++) {
+    auto pkt = get_pkt(0xaa, 1, 0);
+    pipeline.apply(&pkt);
+    EXPECT_EQ(i, count_primitive.get());
+  }
+  EXPECT_EQ(0u, pipeline.get_flow_cache()->get_num_entries());
+}
+
+TEST_F(FlowCacheTest, DefaultSize) {
+  Pipeline::set_default_flow_cache_size(16);
+  Pipeline cached_pipeline("cached_pipeline", 1, &condition);
+  Pipeline::set_default_flow_cache_size(0);
+  Pipeline uncached_pipeline("uncached_pipeline", 2, &condition);
+  ASSERT_NE(nullptr, cached_pipeline.get_flow_cache());
+  EXPECT_EQ(nullptr, uncached_pipeline.get_flow_cache());
+
+  add_entry(std::string("\x00\xaa", 2), &action_fn, 0x1234);
+  auto pkt = get_pkt(0xaa, 1, 0);
+  cached_pipeline.apply(&pkt);
+  EXPECT_EQ(0x1234, get_f32(&pkt));
+  EXPECT_EQ(1u, cached_pipeline.get_flow_cache()->get_num_entries());
+}
+
+// same pipeline as above, without a flow cache
+using PipelineBatchTest = FlowCacheTest;
+
+TEST_F(PipelineBatchTest, ApplyBatch) {
+  add_entry(std::string("\x00\xaa", 2), &action_fn, 0x1234);
+  add_entry(std::string("\x00\xbb", 2), &action_fn, 0x5678);
+  Pipeline batch_pipeline("batch_pipeline", 1, &condition);
+
+  // the second packet does not go through the table, the fourth one is a miss
+  std::vector<Packet> pkts;
+  pkts.push_back(get_pkt(0xaa, 1, 0));
+  pkts.push_back(get_pkt(0xaa, 2, 0));
+  pkts.push_back(get_pkt(0xbb, 1, 0));
+  pkts.push_back(get_pkt(0xcc, 1, 0));
+  pkts.push_back(get_pkt(0xaa, 1, 0));
+  pkts[4].mark_for_exit();
+  std::vector<Packet *> pkt_ptrs;
+  for (auto &pkt : pkts) pkt_ptrs.push_back(&pkt);
+
+  batch_pipeline.apply_batch(pkt_ptrs);
+  EXPECT_EQ(0x1234, get_f32(&pkts[0]));
+  EXPECT_EQ(0, get_f32(&pkts[1]));
+  EXPECT_EQ(0x5678, get_f32(&pkts[2]));
+  EXPECT_EQ(0, get_f32(&pkts[3]));
+  EXPECT_EQ(0, get_f32(&pkts[4]));
+}
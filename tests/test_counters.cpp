@@ -26,6 +26,8 @@
 #include <bm/bm_sim/phv_source.h>
 
 #include <random>
+#include <thread>
+#include <vector>
 
 using namespace bm;
 
@@ -104,3 +106,52 @@ TEST_F(CountersTest, CounterArray) {
     ASSERT_EQ(0u, packets);
   }
 }
+
+TEST_F(CountersTest, Sharded) {
+  counter_value_t bytes, packets;
+
+  Counter::set_num_shards(3);
+  ASSERT_EQ(4u, Counter::get_num_shards());
+  CounterArray c_array("counter", 0, 16);
+  Counter::set_num_shards(1);
+
+  // the cells are only allocated when the counter is first incremented
+  c_array[0].write_counter(0u, 0u);
+  c_array[0].query_counter(&bytes, &packets);
+  ASSERT_EQ(0u, bytes);
+  ASSERT_EQ(0u, packets);
+
+  const size_t nb_threads = 8;
+  const size_t nb_pkts = 1000;
+  const size_t pkt_size = 100;
+  auto count = [this, &c_array]() {
+    const Packet pkt = get_pkt(pkt_size);
+    for (size_t i = 0; i < nb_pkts; ++i) {
+      for (Counter &c : c_array) c.increment_counter(pkt);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < nb_threads; ++i) threads.emplace_back(count);
+  for (auto &t : threads) t.join();
+
+  for (Counter &c : c_array) {
+    c.query_counter(&bytes, &packets);
+    ASSERT_EQ(nb_threads * nb_pkts * pkt_size, bytes);
+    ASSERT_EQ(nb_threads * nb_pkts, packets);
+  }
+
+  Counter &c = c_array[0];
+  c.write_counter(10, 1);
+  c.query_counter(&bytes, &packets);
+  ASSERT_EQ(10u, bytes);
+  ASSERT_EQ(1u, packets);
+  count();
+  c.query_counter(&bytes, &packets);
+  ASSERT_EQ(10u + nb_pkts * pkt_size, bytes);
+  ASSERT_EQ(1u + nb_pkts, packets);
+
+  c_array.reset_counters();
+  c.query_counter(&bytes, &packets);
+  ASSERT_EQ(0u, bytes);
+  ASSERT_EQ(0u, packets);
+}
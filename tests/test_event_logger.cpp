@@ -0,0 +1,277 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <bm/bm_sim/event_logger.h>
+#include <bm/bm_sim/packet.h>
+#include <bm/bm_sim/phv.h>
+#include <bm/bm_sim/phv_source.h>
+#include <bm/bm_sim/transport.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstring>
+
+using namespace bm;
+
+using std::chrono::milliseconds;
+
+namespace {
+
+// keeps all the messages in memory; senders can be blocked with hold()
+class EventSink : public TransportIface {
+ public:
+  void hold() {
+    std::unique_lock<std::mutex> lock(mutex);
+    held = true;
+  }
+
+  void release() {
+    std::unique_lock<std::mutex> lock(mutex);
+    held = false;
+    cv.notify_all();
+  }
+
+  bool wait_for_blocked_sender() {
+    std::unique_lock<std::mutex> lock(mutex);
+    return cv.wait_for(lock, milliseconds(1000), [this] { return blocked; });
+  }
+
+  std::vector<std::string> get_msgs() const {
+    std::unique_lock<std::mutex> lock(mutex);
+    return msgs;
+  }
+
+ private:
+  int open_() override {
+    return 0;
+  }
+
+  int send_(const std::string &msg) const override {
+    return send_(msg.data(), static_cast<int>(msg.size()));
+  }
+
+  int send_(const char *msg, int len) const override {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (held) {
+      blocked = true;
+      cv.notify_all();
+      cv.wait(lock, [this] { return !held; });
+      blocked = false;
+    }
+    msgs.emplace_back(msg, len);
+    return 0;
+  }
+
+  int send_msgs_(const std::initializer_list<std::string> &) const override {
+    return 0;
+  }
+
+  int send_msgs_(const std::initializer_list<MsgBuf> &) const override {
+    return 0;
+  }
+
+  mutable std::vector<std::string> msgs{};
+  mutable bool held{false};
+  mutable bool blocked{false};
+  mutable std::mutex mutex{};
+  mutable std::condition_variable cv{};
+};
+
+}  // namespace
+
+class EventLoggerTest : public ::testing::Test {
+ protected:
+  static constexpr device_id_t device_id = 7;
+  // size of a config change message, which is just the common header
+  static constexpr size_t msg_size = 40;
+  static constexpr int config_change_type = 999;
+
+  EventLoggerTest()
+      : sink(new EventSink()),
+        event_logger(std::unique_ptr<TransportIface>(sink), device_id) { }
+
+  // checks that the message only includes config change events and returns
+  // the number of events
+  size_t count_events(const std::string &msg) const {
+    EXPECT_EQ(0u, msg.size() % msg_size);
+    for (size_t offset = 0; offset < msg.size(); offset += msg_size) {
+      int type;
+      uint64_t switch_id;
+      std::memcpy(&type, msg.data() + offset, sizeof(type));
+      std::memcpy(&switch_id, msg.data() + offset + sizeof(type),
+                  sizeof(switch_id));
+      EXPECT_EQ(config_change_type, type);
+      EXPECT_EQ(device_id, switch_id);
+    }
+    return msg.size() / msg_size;
+  }
+
+  size_t count_events() const {
+    size_t count = 0;
+    for (const auto &msg : sink->get_msgs()) count += count_events(msg);
+    return count;
+  }
+
+  EventSink *sink;  // owned by event_logger
+  EventLogger event_logger;
+};
+
+constexpr device_id_t EventLoggerTest::device_id;
+constexpr size_t EventLoggerTest::msg_size;
+constexpr int EventLoggerTest::config_change_type;
+
+TEST_F(EventLoggerTest, Synchronous) {
+  const size_t num_events = 10;
+  for (size_t i = 0; i < num_events; i++) event_logger.config_change();
+  auto msgs = sink->get_msgs();
+  ASSERT_EQ(num_events, msgs.size());
+  for (const auto &msg : msgs) ASSERT_EQ(1u, count_events(msg));
+}
+
+TEST_F(EventLoggerTest, Batches) {
+  const size_t num_events = 100;
+  event_logger.set_async(1024);
+  sink->hold();
+  event_logger.config_change();
+  // the drain thread is blocked while sending the first event, the other
+  // events accumulate in the ring and are sent together
+  ASSERT_TRUE(sink->wait_for_blocked_sender());
+  for (size_t i = 0; i < num_events; i++) event_logger.config_change();
+  sink->release();
+  event_logger.set_async(0);
+
+  auto msgs = sink->get_msgs();
+  ASSERT_EQ(2u, msgs.size());
+  ASSERT_EQ(1u, count_events(msgs.at(0)));
+  ASSERT_EQ(num_events, count_events(msgs.at(1)));
+}
+
+TEST_F(EventLoggerTest, MaxBatchSize) {
+  const size_t num_events = 1000;
+  event_logger.set_async(1024);
+  sink->hold();
+  event_logger.config_change();
+  ASSERT_TRUE(sink->wait_for_blocked_sender());
+  for (size_t i = 0; i < num_events; i++) event_logger.config_change();
+  sink->release();
+  event_logger.set_async(0);
+
+  auto msgs = sink->get_msgs();
+  ASSERT_LT(2u, msgs.size());
+  for (const auto &msg : msgs) ASSERT_GE(8192u, msg.size());
+  ASSERT_EQ(num_events + 1, count_events());
+}
+
+TEST_F(EventLoggerTest, Overflow) {
+  const size_t ring_size = 16;
+  const size_t num_dropped = 10;
+  event_logger.set_async(ring_size);
+  sink->hold();
+  event_logger.config_change();
+  ASSERT_TRUE(sink->wait_for_blocked_sender());
+  for (size_t i = 0; i < ring_size + num_dropped; i++)
+    event_logger.config_change();
+  ASSERT_EQ(num_dropped, event_logger.get_dropped_events());
+  sink->release();
+  event_logger.set_async(0);
+  ASSERT_EQ(0u, event_logger.get_dropped_events());
+  ASSERT_EQ(ring_size + 1, count_events());
+}
+
+TEST_F(EventLoggerTest, MultipleThreads) {
+  const size_t num_threads = 4;
+  const size_t num_events = 5000;
+  event_logger.set_async(64);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < num_threads; i++) {
+    threads.emplace_back([this, num_events] {
+      for (size_t j = 0; j < num_events; j++) event_logger.config_change();
+    });
+  }
+  for (auto &t : threads) t.join();
+  auto dropped = event_logger.get_dropped_events();
+  event_logger.set_async(0);
+  ASSERT_EQ(num_threads * num_events, count_events() + dropped);
+}
+
+TEST_F(EventLoggerTest, OrderPerThread) {
+  // size of a packet in message: the common header and the port
+  const size_t packet_in_size = msg_size + sizeof(int);
+  const int num_events = 500;
+  PHVFactory phv_factory;
+  auto phv_source = PHVSourceIface::make_phv_source();
+  phv_source->set_phv_factory(0, &phv_factory);
+  auto packet_in = [this, &phv_source](int port) {
+    auto pkt = Packet::make_new(0, port, 0, 0, 0, PacketBuffer(),
+                                phv_source.get());
+    event_logger.packet_in(pkt);
+  };
+
+  event_logger.set_async(1024);
+  // one thread uses even ports and the other one odd ports; the events of each
+  // thread must be published in order, but they can be interleaved in any way
+  std::vector<std::thread> threads;
+  for (int first_port = 0; first_port < 2; first_port++) {
+    threads.emplace_back([&packet_in, first_port, num_events] {
+      for (int port = first_port; port < 2 * num_events; port += 2)
+        packet_in(port);
+    });
+  }
+  for (auto &t : threads) t.join();
+  event_logger.set_async(0);
+  ASSERT_EQ(0u, event_logger.get_dropped_events());
+
+  std::string all_msgs;
+  for (const auto &msg : sink->get_msgs()) all_msgs += msg;
+  ASSERT_EQ(2 * num_events * packet_in_size, all_msgs.size());
+  int next_port[2] = {0, 1};
+  for (size_t offset = 0; offset < all_msgs.size(); offset += packet_in_size) {
+    int port_in;
+    std::memcpy(&port_in, all_msgs.data() + offset + msg_size,
+                sizeof(port_in));
+    ASSERT_EQ(next_port[port_in % 2], port_in);
+    next_port[port_in % 2] += 2;
+  }
+}
+
+TEST_F(EventLoggerTest, ThreadExit) {
+  const size_t ring_size = 16;
+  const size_t num_dropped = 10;
+  event_logger.set_async(ring_size);
+  sink->hold();
+  event_logger.config_change();
+  ASSERT_TRUE(sink->wait_for_blocked_sender());
+  std::thread other_thread([this, ring_size, num_dropped] {
+    for (size_t i = 0; i < ring_size + num_dropped; i++)
+      event_logger.config_change();
+  });
+  other_thread.join();
+  sink->release();
+  // the ring of the other thread is freed once it has been drained, its
+  // events and dropped events must not be lost
+  for (int i = 0; i < 100 && count_events() < ring_size + 1; i++)
+    std::this_thread::sleep_for(milliseconds(10));
+  ASSERT_EQ(ring_size + 1, count_events());
+  ASSERT_EQ(num_dropped, event_logger.get_dropped_events());
+  event_logger.set_async(0);
+}
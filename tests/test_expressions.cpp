@@ -69,3 +69,59 @@ TEST_F(ExpressionsTest, EmptyBool) {
   const auto b = expr.eval_bool(*phv.get());
   ASSERT_FALSE(b);
 }
+
+TEST_F(ExpressionsTest, FieldChain) {
+  // ((f8 - 5) * 32) & 0xffff
+  Expression expr;
+  expr.push_back_load_field(testHeader1, 2);
+  expr.push_back_load_const(Data(5));
+  expr.push_back_op(ExprOpcode::SUB);
+  expr.push_back_load_const(Data(32));
+  expr.push_back_op(ExprOpcode::MUL);
+  expr.push_back_load_const(Data(0xffff));
+  expr.push_back_op(ExprOpcode::BIT_AND);
+  expr.build();
+
+  FieldChainExpression chain;
+  ASSERT_TRUE(expr.get_field_chain(&chain));
+  ASSERT_EQ(testHeader1, chain.header);
+  ASSERT_EQ(2, chain.field_offset);
+  ASSERT_EQ(3u, chain.steps.size());
+
+  auto &f = phv->get_field(testHeader1, 2);
+  // includes values for which the intermediate result is negative
+  for (int v : {0, 3, 5, 6, 15, 255}) {
+    f.set(v);
+    int64_t res;
+    ASSERT_TRUE(chain.eval(v, &res));
+    ASSERT_EQ(expr.eval_arith(*phv.get()).get<int64_t>(), res);
+  }
+}
+
+TEST_F(ExpressionsTest, NotFieldChain) {
+  FieldChainExpression chain;
+  {  // more than one field
+    Expression expr;
+    expr.push_back_load_field(testHeader1, 2);
+    expr.push_back_load_field(testHeader2, 2);
+    expr.push_back_op(ExprOpcode::ADD);
+    expr.build();
+    ASSERT_FALSE(expr.get_field_chain(&chain));
+  }
+  {  // unsupported operation
+    Expression expr;
+    expr.push_back_load_field(testHeader1, 2);
+    expr.push_back_load_const(Data(2));
+    expr.push_back_op(ExprOpcode::DIV);
+    expr.build();
+    ASSERT_FALSE(expr.get_field_chain(&chain));
+  }
+  {  // constant operand too large
+    Expression expr;
+    expr.push_back_load_field(testHeader1, 2);
+    expr.push_back_load_const(Data("0x100000000"));
+    expr.push_back_op(ExprOpcode::ADD);
+    expr.build();
+    ASSERT_FALSE(expr.get_field_chain(&chain));
+  }
+}
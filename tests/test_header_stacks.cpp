@@ -391,6 +391,36 @@ TEST_F(HeaderStackP4_16Test, PopFront) {
   EXPECT_FALSE(h2.is_valid());
 }
 
+// only valid headers carry data through a shift; checks that their values end
+// up in the right place when validity is not contiguous
+TEST_F(HeaderStackP4_16Test, ShiftSparse) {
+  auto &stack = this->stack;
+  auto *phv = this->phv.get();
+
+  auto &h0 = phv->get_header(this->testHeader_0);
+  auto &h1 = phv->get_header(this->testHeader_1);
+  auto &h2 = phv->get_header(this->testHeader_2);
+
+  const unsigned int v0 = 10u; const unsigned int v2 = 12u;
+  h0.mark_valid(); h0.get_field(0).set(v0);
+  h1.get_field(0).set(11u);
+  h2.mark_valid(); h2.get_field(0).set(v2);
+
+  EXPECT_EQ(1u, stack.push_front());
+  EXPECT_FALSE(h0.is_valid());
+  EXPECT_TRUE(h1.is_valid());
+  EXPECT_EQ(v0, h1.get_field(0).get_uint());
+  EXPECT_FALSE(h2.is_valid());
+
+  h2.mark_valid(); h2.get_field(0).set(v2);
+  EXPECT_EQ(1u, stack.pop_front());
+  EXPECT_TRUE(h0.is_valid());
+  EXPECT_EQ(v0, h0.get_field(0).get_uint());
+  EXPECT_TRUE(h1.is_valid());
+  EXPECT_EQ(v2, h1.get_field(0).get_uint());
+  EXPECT_FALSE(h2.is_valid());
+}
+
 }  // namespace testing
 
 }  // namespace bm
@@ -23,6 +23,10 @@
 #include <bm/bm_sim/phv.h>
 
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <cstring>
 
 using namespace bm;
 
@@ -79,6 +83,46 @@ TEST_F(HeaderTest, CmpDiffType) {
   ASSERT_FALSE(h10.cmp(h20)); ASSERT_FALSE(h20.cmp(h10));
 }
 
+// mix of byte-aligned and non byte-aligned fields, IPv4-style
+TEST(HeaderExtractPlan, ExtractDeparse) {
+  HeaderType header_type("test_t", 0);
+  header_type.push_back_field("f4_1", 4);
+  header_type.push_back_field("f4_2", 4);
+  header_type.push_back_field("f16", 16);
+  header_type.push_back_field("f3", 3);
+  header_type.push_back_field("f13", 13);
+  header_type.push_back_field("f8", 8);
+
+  const auto &plan = header_type.get_extract_plan();
+  ASSERT_EQ(6u, plan.size());
+  const std::vector<std::pair<int, int> > expected_placements = {
+    {0, 0}, {0, 4}, {1, 0}, {3, 0}, {3, 3}, {5, 0}};
+  for (size_t i = 0; i < plan.size(); i++) {
+    EXPECT_EQ(static_cast<int>(i), plan[i].field_offset);
+    EXPECT_EQ(expected_placements[i].first, plan[i].byte_offset);
+    EXPECT_EQ(expected_placements[i].second, plan[i].bit_offset);
+  }
+
+  PHVFactory phv_factory;
+  phv_factory.push_back_header("test", 0, header_type);
+  auto phv = phv_factory.create();
+  auto &hdr = phv->get_header(0);
+
+  const char data[6] = {'\x4a', '\x12', '\x34', '\xbf', '\xfe', '\x99'};
+  hdr.extract(data, *phv);
+  EXPECT_TRUE(hdr.is_valid());
+  EXPECT_EQ(0x4, hdr.get_field(0).get_int());
+  EXPECT_EQ(0xa, hdr.get_field(1).get_int());
+  EXPECT_EQ(0x1234, hdr.get_field(2).get_int());
+  EXPECT_EQ(0x5, hdr.get_field(3).get_int());
+  EXPECT_EQ(0x1ffe, hdr.get_field(4).get_int());
+  EXPECT_EQ(0x99, hdr.get_field(5).get_int());
+
+  char out[6] = {};
+  hdr.deparse(out);
+  EXPECT_EQ(0, memcmp(data, out, sizeof(data)));
+}
+
 
 class HeaderVLTest : public ::testing::Test {
  protected:
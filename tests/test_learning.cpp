@@ -26,7 +26,9 @@
 #include <bm/bm_sim/packet.h>
 
 #include <memory>
+#include <set>
 #include <string>
+#include <vector>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
@@ -553,3 +555,141 @@ TEST_F(LearningTest, OneSampleCbMode) {
   ASSERT_EQ((char) 0xa, data[0]);
   ASSERT_EQ((char) 0xba, data[1]);
 }
+
+TEST_F(LearningTest, MultipleThreads) {
+  LearnEngineIface::list_id_t list_id = 1;
+  size_t max_samples = 64; unsigned timeout_ms = 0;
+  learn_on_test1_f16(list_id, max_samples, timeout_ms);
+
+  const int nb_threads = 4;
+  const int nb_values = 256;  // per thread
+  std::vector<Packet> pkts;
+  for (int t = 0; t < nb_threads; t++) pkts.push_back(get_pkt());
+
+  auto learn_values = [this, list_id, nb_values](Packet *pkt, int t) {
+    Field &f = pkt->get_phv()->get_field(testHeader1, 0);
+    // every value is learned twice, the duplicates must be filtered out
+    for (int rep = 0; rep < 2; rep++) {
+      for (int v = t * nb_values; v < (t + 1) * nb_values; v++) {
+        f.set(v);
+        learn_engine->learn(list_id, *pkt);
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nb_threads; t++)
+    threads.emplace_back(learn_values, &pkts[t], t);
+
+  auto msg_hdr = reinterpret_cast<LearnEngineIface::msg_hdr_t *>(buffer);
+  const char *data = buffer + sizeof(LearnEngineIface::msg_hdr_t);
+  std::set<int> values;
+  size_t nb_duplicates = 0;
+  const size_t nb_buffers = nb_threads * nb_values / max_samples;
+  for (size_t i = 0; i < nb_buffers; i++) {
+    learn_writer->read(buffer, sizeof(buffer));
+    EXPECT_EQ(i, msg_hdr->buffer_id);
+    EXPECT_EQ(max_samples, msg_hdr->num_samples);
+    for (size_t s = 0; s < max_samples; s++) {
+      int v = (static_cast<unsigned char>(data[2 * s]) << 8) |
+          static_cast<unsigned char>(data[2 * s + 1]);
+      if (!values.insert(v).second) nb_duplicates++;
+    }
+  }
+
+  for (auto &thread : threads) thread.join();
+
+  ASSERT_EQ(0u, nb_duplicates);
+  ASSERT_EQ(static_cast<size_t>(nb_threads * nb_values), values.size());
+  sleep_for(milliseconds(100));
+  ASSERT_NE(MemoryAccessor::Status::CAN_READ, learn_writer->check_status());
+}
+
+TEST_F(LearningTest, FilterAckDedupCache) {
+  LearnEngineIface::list_id_t list_id = 1;
+  size_t max_samples = 1; unsigned timeout_ms = 0;
+  learn_on_test1_f16(list_id, max_samples, timeout_ms);
+
+  auto msg_hdr = reinterpret_cast<LearnEngineIface::msg_hdr_t *>(buffer);
+  const char *data = buffer + sizeof(LearnEngineIface::msg_hdr_t);
+
+  Packet pkt = get_pkt();
+  Field &f = pkt.get_phv()->get_field(testHeader1, 0);
+
+  f.set("0xaba");
+  learn_engine->learn(list_id, pkt);
+  learn_writer->read(buffer, sizeof(buffer));
+  ASSERT_EQ(0u, msg_hdr->buffer_id);
+
+  f.set("0xabb");
+  learn_engine->learn(list_id, pkt);
+  learn_writer->read(buffer, sizeof(buffer));
+  ASSERT_EQ(1u, msg_hdr->buffer_id);
+
+  // both samples are duplicates
+  for (int i = 0; i < 8; i++) {
+    f.set("0xaba");
+    learn_engine->learn(list_id, pkt);
+    f.set("0xabb");
+    learn_engine->learn(list_id, pkt);
+  }
+  sleep_for(milliseconds(100));
+  ASSERT_NE(MemoryAccessor::Status::CAN_READ, learn_writer->check_status());
+
+  // only 0xaba can be learned again after it is acked
+  ASSERT_EQ(LearnEngineIface::SUCCESS, learn_engine->ack(list_id, 0, 0));
+  learn_engine->learn(list_id, pkt);  // 0xabb
+  sleep_for(milliseconds(100));
+  ASSERT_NE(MemoryAccessor::Status::CAN_READ, learn_writer->check_status());
+  f.set("0xaba");
+  learn_engine->learn(list_id, pkt);
+  learn_writer->read(buffer, sizeof(buffer));
+  ASSERT_EQ(2u, msg_hdr->buffer_id);
+  ASSERT_EQ(1u, msg_hdr->num_samples);
+  ASSERT_EQ((char) 0xa, data[0]);
+  ASSERT_EQ((char) 0xba, data[1]);
+
+  // after a reset, everything can be learned again
+  learn_engine->reset_state();
+  f.set("0xabb");
+  learn_engine->learn(list_id, pkt);
+  learn_writer->read(buffer, sizeof(buffer));
+  ASSERT_EQ(0u, msg_hdr->buffer_id);
+  ASSERT_EQ((char) 0xa, data[0]);
+  ASSERT_EQ((char) 0xbb, data[1]);
+}
+
+TEST_F(LearningTest, FilterNoDedupCache) {
+  const size_t cache_size = LearnEngineIface::get_dedup_cache_size();
+  LearnEngineIface::set_dedup_cache_size(0);
+  LearnEngineIface::list_id_t list_id = 1;
+  size_t max_samples = 2; unsigned timeout_ms = 0;
+  learn_on_test1_f16(list_id, max_samples, timeout_ms);
+  LearnEngineIface::set_dedup_cache_size(cache_size);
+
+  auto msg_hdr = reinterpret_cast<LearnEngineIface::msg_hdr_t *>(buffer);
+
+  Packet pkt = get_pkt();
+  Field &f = pkt.get_phv()->get_field(testHeader1, 0);
+
+  f.set("0xaba");
+  learn_engine->learn(list_id, pkt);
+  learn_engine->learn(list_id, pkt);
+  sleep_for(milliseconds(100));
+  ASSERT_NE(MemoryAccessor::Status::CAN_READ, learn_writer->check_status());
+
+  f.set("0xabb");
+  learn_engine->learn(list_id, pkt);
+  learn_writer->read(buffer, sizeof(buffer));
+  ASSERT_EQ(0u, msg_hdr->buffer_id);
+  ASSERT_EQ(2u, msg_hdr->num_samples);
+
+  ASSERT_EQ(LearnEngineIface::SUCCESS, learn_engine->ack_buffer(list_id, 0));
+  f.set("0xaba");
+  learn_engine->learn(list_id, pkt);
+  f.set("0xabb");
+  learn_engine->learn(list_id, pkt);
+  learn_writer->read(buffer, sizeof(buffer));
+  ASSERT_EQ(1u, msg_hdr->buffer_id);
+  ASSERT_EQ(2u, msg_hdr->num_samples);
+}
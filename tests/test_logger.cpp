@@ -0,0 +1,108 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define BMLOG_SUBSYSTEM PARSER
+
+#include <gtest/gtest.h>
+
+#include <bm/bm_sim/logger.h>
+
+#include <unistd.h>
+
+#include <string>
+
+using namespace bm;
+
+class LoggerTest : public ::testing::Test {
+ protected:
+  using Subsystem = Logger::Subsystem;
+
+  LoggerTest()
+      : log_file("/tmp/bmv2-test-logger-" + std::to_string(::getpid()) +
+                 ".log") { }
+
+  void SetUp() override {
+    Logger::set_logger_file(log_file);
+  }
+
+  void TearDown() override {
+    for (int i = 0; i < static_cast<int>(Subsystem::NUM_SUBSYSTEMS); i++)
+      Logger::set_subsystem_enabled(static_cast<Subsystem>(i), true);
+    Logger::set_log_level(Logger::LogLevel::OFF);
+    ::unlink(log_file.c_str());
+  }
+
+  int log_arg() {
+    return ++num_evaluations;
+  }
+
+  std::string log_file;
+  int num_evaluations{0};
+};
+
+TEST_F(LoggerTest, SubsystemNames) {
+  for (int i = 0; i < static_cast<int>(Subsystem::NUM_SUBSYSTEMS); i++) {
+    auto subsystem = static_cast<Subsystem>(i);
+    Subsystem from_name;
+    ASSERT_TRUE(Logger::subsystem_from_name(Logger::subsystem_name(subsystem),
+                                            &from_name));
+    ASSERT_EQ(subsystem, from_name);
+  }
+  Subsystem from_name;
+  ASSERT_FALSE(Logger::subsystem_from_name("bad", &from_name));
+  ASSERT_FALSE(Logger::subsystem_from_name("all", &from_name));
+}
+
+TEST_F(LoggerTest, LogLevel) {
+  Logger::set_log_level(Logger::LogLevel::TRACE);
+  ASSERT_TRUE(Logger::debug_enabled(Subsystem::PARSER));
+  ASSERT_TRUE(Logger::trace_enabled(Subsystem::PARSER));
+
+  Logger::set_log_level(Logger::LogLevel::DEBUG);
+  ASSERT_TRUE(Logger::debug_enabled(Subsystem::PARSER));
+  ASSERT_FALSE(Logger::trace_enabled(Subsystem::PARSER));
+
+  Logger::set_log_level(Logger::LogLevel::INFO);
+  ASSERT_FALSE(Logger::debug_enabled(Subsystem::PARSER));
+  ASSERT_FALSE(Logger::trace_enabled(Subsystem::PARSER));
+}
+
+TEST_F(LoggerTest, Subsystems) {
+  Logger::set_log_level(Logger::LogLevel::TRACE);
+  Logger::set_subsystem_enabled(Subsystem::PARSER, false);
+  ASSERT_FALSE(Logger::is_subsystem_enabled(Subsystem::PARSER));
+  ASSERT_FALSE(Logger::debug_enabled(Subsystem::PARSER));
+  ASSERT_FALSE(Logger::trace_enabled(Subsystem::PARSER));
+  ASSERT_TRUE(Logger::is_subsystem_enabled(Subsystem::TABLES));
+  ASSERT_TRUE(Logger::debug_enabled(Subsystem::TABLES));
+  ASSERT_TRUE(Logger::trace_enabled(Subsystem::TABLES));
+
+  Logger::set_subsystem_enabled(Subsystem::PARSER, true);
+  ASSERT_TRUE(Logger::debug_enabled(Subsystem::PARSER));
+}
+
+// the arguments of a disabled message are not evaluated
+TEST_F(LoggerTest, Macros) {
+  Logger::set_log_level(Logger::LogLevel::DEBUG);
+  BMLOG_DEBUG("debug {}", log_arg());
+  BMLOG_TRACE("trace {}", log_arg());
+  Logger::set_subsystem_enabled(Subsystem::PARSER, false);
+  BMLOG_DEBUG("debug {}", log_arg());
+#ifdef BMLOG_DEBUG_ON
+  ASSERT_EQ(1, num_evaluations);
+#else
+  ASSERT_EQ(0, num_evaluations);
+#endif
+}
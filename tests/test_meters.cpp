@@ -191,3 +191,51 @@ TEST_F(MetersTest, PreColor) {
   ASSERT_EQ(RED, meter.execute(pkt, RED));
   ASSERT_EQ(GREEN, meter.execute(pkt));
 }
+
+TEST_F(MetersTest, Concurrent) {
+  const color_t GREEN = 0;
+
+  Meter meter(MeterType::PACKETS, 1);
+  // the bucket is never refilled in practice
+  const size_t burst_size = 1000;
+  Meter::rate_config_t rate = {0.000000001, burst_size};
+  meter.set_rates({rate});
+
+  const size_t nb_threads = 4;
+  std::vector<size_t> green_counts(nb_threads, 0);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < nb_threads; i++) {
+    threads.emplace_back([this, &meter, &green_counts, i]() {
+      Packet pkt = get_pkt(128);
+      for (size_t j = 0; j < burst_size; j++)
+        if (meter.execute(pkt) == GREEN) green_counts[i]++;
+    });
+  }
+  for (auto &t : threads) t.join();
+
+  size_t green_count = 0;
+  for (auto c : green_counts) green_count += c;
+  ASSERT_EQ(burst_size, green_count);
+}
+
+TEST_F(MetersTest, CoarseTime) {
+  const color_t GREEN = 0;
+  const color_t RED = 1;
+
+  Meter::set_time_resolution(std::chrono::microseconds(1000));
+
+  Meter meter(MeterType::PACKETS, 1);
+  // 100 packets per second, burst size of 1
+  Meter::rate_config_t rate = {0.0001, 1};
+  meter.set_rates({rate});
+
+  Packet pkt = get_pkt(128);
+
+  ASSERT_EQ(GREEN, meter.execute(pkt));
+  ASSERT_EQ(RED, meter.execute(pkt));
+  sleep_for(milliseconds(30));
+  ASSERT_EQ(GREEN, meter.execute(pkt));
+  ASSERT_EQ(RED, meter.execute(pkt));
+
+  Meter::set_time_resolution(std::chrono::microseconds(0));
+}
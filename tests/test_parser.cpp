@@ -32,12 +32,15 @@
 
 #include <chrono>
 #include <fstream>
+#include <functional>
 #include <thread>
 #include <mutex>
 #include <vector>
 #include <string>
 #include <utility>  // for std::pair
 
+#include "extract.h"
+
 using namespace bm;
 
 /* Frame (66 bytes) */
@@ -206,6 +209,36 @@ class ParserTest : public ParserTestGeneric {
         phv_source.get());
   }
 
+  Packet get_truncated_tcp_pkt(size_t size) {
+    return Packet::make_new(
+        size, PacketBuffer(256, (const char *) raw_tcp_pkt, size),
+        phv_source.get());
+  }
+
+  // parses the packet with both the interpreter and a compiled parser and
+  // checks that the results are identical
+  void check_compiled(const std::function<Packet()> &make_pkt) {
+    Parser compiled_parser("compiled_parser", 1, &error_codes);
+    compiled_parser.set_init_state(&ethernetParseState);
+    compiled_parser.compile(phv_factory);
+    ASSERT_TRUE(compiled_parser.is_compiled());
+
+    auto packet_1 = make_pkt();
+    auto packet_2 = make_pkt();
+    parser.parse(&packet_1);
+    compiled_parser.parse(&packet_2);
+    ASSERT_EQ(packet_1.get_error_code(), packet_2.get_error_code());
+    ASSERT_EQ(packet_1.get_data_size(), packet_2.get_data_size());
+    for (auto header : {ethernetHeader, ipv4Header, udpHeader, tcpHeader}) {
+      const auto &hdr_1 = packet_1.get_phv()->get_header(header);
+      const auto &hdr_2 = packet_2.get_phv()->get_header(header);
+      ASSERT_EQ(hdr_1.is_valid(), hdr_2.is_valid());
+      for (size_t i = 0; i < hdr_1.size(); i++)
+        ASSERT_EQ(hdr_1.get_field(i).get_bytes(),
+                  hdr_2.get_field(i).get_bytes());
+    }
+  }
+
   // virtual void TearDown() { }
 };
 
@@ -295,6 +328,21 @@ TEST_F(ParserTest, ParseEthernetIPv4TCP_Stress) {
   }
 }
 
+TEST_F(ParserTest, Compiled) {
+  check_compiled([this] { return get_tcp_pkt(); });
+  check_compiled([this] { return get_udp_pkt(); });
+}
+
+TEST_F(ParserTest, CompiledPacketTooShort) {
+  // ethernet and ipv4 headers, followed by a truncated tcp header
+  check_compiled([this] { return get_truncated_tcp_pkt(14 + 20 + 10); });
+  auto packet = get_truncated_tcp_pkt(14 + 20 + 10);
+  parser.compile(phv_factory);
+  parse_and_check_error(&packet, ErrorCodeMap::Core::PacketTooShort);
+  ASSERT_TRUE(packet.get_phv()->get_header(ipv4Header).is_valid());
+  ASSERT_FALSE(packet.get_phv()->get_header(tcpHeader).is_valid());
+}
+
 TEST_F(ParserTest, DeparseEthernetIPv4TCP) {
   auto packet = get_tcp_pkt();
   parse_and_check_no_error(&packet);
@@ -315,6 +363,34 @@ TEST_F(ParserTest, DeparseEthernetIPv4UDP) {
   ASSERT_EQ(0, memcmp(raw_udp_pkt, packet.data(), sizeof(raw_udp_pkt)));
 }
 
+TEST_F(ParserTest, DeparseUnmodifiedHeaders) {
+  auto packet = get_tcp_pkt();
+  auto phv = packet.get_phv();
+  parse_and_check_no_error(&packet);
+
+  // the TCP header is just before the payload
+  auto &tcp_hdr = phv->get_header(tcpHeader);
+  char *tcp_data = packet.data() - tcp_hdr.get_nbytes_packet();
+  ASSERT_FALSE(tcp_hdr.deparse_to_packet(tcp_data));
+  phv->get_field(tcpHeader, 1).set(0x1234);  // dstPort
+  ASSERT_TRUE(tcp_hdr.deparse_to_packet(tcp_data));
+  ASSERT_FALSE(tcp_hdr.deparse_to_packet(tcp_data));
+  phv->get_field(tcpHeader, 1).set(0x0050);  // original value
+
+  // decrement TTL and remove Ethernet header: the IPv4 header is rewritten in
+  // place and the TCP header is untouched
+  phv->get_field(ipv4Header, 7).set(0x3f);
+  phv->get_header(ethernetHeader).mark_invalid();
+  deparser.deparse(&packet);
+
+  const size_t eth_size = 14;
+  std::vector<char> expected(raw_tcp_pkt + eth_size,
+                             raw_tcp_pkt + sizeof(raw_tcp_pkt));
+  expected[8] = 0x3f;  // TTL
+  ASSERT_EQ(expected.size(), packet.get_data_size());
+  ASSERT_EQ(0, memcmp(expected.data(), packet.data(), expected.size()));
+}
+
 TEST_F(ParserTest, DeparseEthernetIPv4_Stress) {
   const char *ref_pkt;
   size_t size;
@@ -452,6 +528,29 @@ TEST_F(ParserOpSetTest, SetFromLookahead) {
 
   test(0, 32, 0xb59dfd17);
   test(8, 8, 0x9d);
+  // the lookahead width is different from the field width
+  test(3, 13, 0x159d);
+  test(12, 20, 0xdfd17);
+}
+
+TEST(LookAhead, ExtractUint64) {
+  const unsigned char data_[10] = {0xb5, 0x9d, 0xfd, 0x17, 0xd5,
+                                   0xd7, 0x01, 0x8e, 0x6a, 0xf3};
+  const char *data = reinterpret_cast<const char *>(data_);
+  for (int bit_offset = 0; bit_offset < 8; bit_offset++) {
+    for (int bitwidth = 1; bitwidth <= 64; bitwidth++) {
+      char bytes[8];
+      const int nbytes = (bitwidth + 7) / 8;
+      extract::generic_extract(data, bit_offset, bitwidth, bytes);
+      uint64_t expected = 0;
+      for (int i = 0; i < nbytes; i++)
+        expected = (expected << 8) | static_cast<unsigned char>(bytes[i]);
+      // generic_extract does not always clear the extra bits in the first byte
+      if (bitwidth < 64) expected &= (static_cast<uint64_t>(1) << bitwidth) - 1;
+      ASSERT_EQ(expected,
+                extract::extract_uint64(data, bit_offset, bitwidth));
+    }
+  }
 }
 
 TEST_F(ParserOpSetTest, SetFromExpression) {
@@ -672,6 +771,21 @@ TEST_F(MPLSParserTest, ParseEthernetMPLS3) {
   ASSERT_EQ(3u, MPLS_hdr_3.get_field(0).get_uint());  // label
 }
 
+// the MPLS state extracts to a stack and is run by the interpreter, while the
+// ethernet state is compiled
+TEST_F(MPLSParserTest, ParseEthernetMPLS3Compiled) {
+  parser.compile(phv_factory);
+  auto packet = get_mpls_pkt();
+  auto phv = packet.get_phv();
+  parse_and_check_no_error(&packet);
+
+  ASSERT_TRUE(phv->get_header(ethernetHeader).is_valid());
+  ASSERT_EQ(1u, phv->get_field(MPLSHeader1, 0).get_uint());  // label
+  ASSERT_EQ(2u, phv->get_field(MPLSHeader2, 0).get_uint());  // label
+  ASSERT_EQ(3u, phv->get_field(MPLSHeader3, 0).get_uint());  // label
+  ASSERT_FALSE(phv->get_header(MPLSHeader4).is_valid());
+}
+
 class SwitchCaseTest : public ::testing::Test {
  protected:
   PHVFactory phv_factory;
@@ -765,6 +879,56 @@ TEST_F(SwitchCaseTest, Mask) {
   }
 }
 
+// exact cases are looked up in a table, but the first matching case must still
+// win, including when exact cases are interleaved with masked ones
+TEST_F(SwitchCaseTest, ExactFirstMatch) {
+  for (int nbytes : {1, 2, 9}) {
+    ParseState pstate("pstate", 0);
+    const ParseState next_state_1("s1", 1);
+    const ParseState next_state_2("s2", 2);
+    const ParseState next_state_3("s3", 3);
+    const ParseState next_state_4("s4", 4);
+    const ParseState next_state_default("default", 5);
+    pstate.set_default_switch_case(&next_state_default);
+
+    auto make_key = [nbytes](unsigned char last) {
+      ByteContainer key(static_cast<size_t>(nbytes));
+      key.back() = static_cast<char>(last);
+      return key;
+    };
+    ByteContainer mask(static_cast<size_t>(nbytes), '\xff');
+    mask.back() = static_cast<char>(0xf0);
+
+    pstate.add_switch_case(make_key(0x01), &next_state_1);
+    pstate.add_switch_case(make_key(0x01), &next_state_2);
+    pstate.add_switch_case(make_key(0x02), nullptr);
+    // matches 0x00 to 0x0f
+    pstate.add_switch_case_with_mask(make_key(0x00), mask, &next_state_3);
+    pstate.add_switch_case(make_key(0x03), &next_state_4);
+    pstate.add_switch_case(make_key(0x13), &next_state_4);
+    // full mask, same as an exact case
+    pstate.add_switch_case_with_mask(
+        make_key(0x14), ByteContainer(static_cast<size_t>(nbytes), '\xff'),
+        &next_state_2);
+
+    ParseSwitchKeyBuilder builder;
+    builder.push_back_lookahead(0, nbytes * 8);
+    pstate.set_key_builder(builder);
+
+    auto next = [&pstate, this](const ByteContainer &key) {
+      Packet packet = get_pkt();
+      size_t bytes_parsed = 0;
+      return pstate(&packet, key.data(), &bytes_parsed);
+    };
+    EXPECT_EQ(&next_state_1, next(make_key(0x01)));
+    EXPECT_EQ(nullptr, next(make_key(0x02)));
+    EXPECT_EQ(&next_state_3, next(make_key(0x03)));
+    EXPECT_EQ(&next_state_3, next(make_key(0x00)));
+    EXPECT_EQ(&next_state_4, next(make_key(0x13)));
+    EXPECT_EQ(&next_state_2, next(make_key(0x14)));
+    EXPECT_EQ(&next_state_default, next(make_key(0x15)));
+  }
+}
 
 // Google Test fixture for IPv4 TLV parsing test
 // This test is targetted a TLV parsing but covers many aspects of the parser
@@ -0,0 +1,113 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <bm/bm_sim/sharded_shared_mutex.h>
+
+#include <boost/thread/locks.hpp>
+
+#include <time.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using bm::ShardedSharedMutex;
+
+using ReadLock = boost::shared_lock<ShardedSharedMutex>;
+using WriteLock = boost::unique_lock<ShardedSharedMutex>;
+
+TEST(ShardedSharedMutex, TryLock) {
+  ShardedSharedMutex mutex;
+  {
+    ReadLock lock_1(mutex);
+    ASSERT_FALSE(mutex.try_lock());
+    // other readers can still get in
+    std::thread t([&mutex] {
+        ASSERT_TRUE(mutex.try_lock_shared());
+        mutex.unlock_shared();
+    });
+    t.join();
+  }
+  {
+    WriteLock lock(mutex);
+    std::thread t([&mutex] {
+        ASSERT_FALSE(mutex.try_lock_shared());
+        ASSERT_FALSE(mutex.try_lock());
+    });
+    t.join();
+  }
+  ASSERT_TRUE(mutex.try_lock());
+  mutex.unlock();
+}
+
+// writers increment 2 counters under the write lock, readers check that the 2
+// counters are always equal
+TEST(ShardedSharedMutex, ReadersAndWriters) {
+  ShardedSharedMutex mutex;
+  // not atomic on purpose, these are protected by the mutex
+  int c1 = 0, c2 = 0;
+  const int iterations = 10000;
+  const int nb_readers = 4;
+  const int nb_writers = 2;
+
+  auto read_loop = [&]() {
+    for (int i = 0; i < iterations; i++) {
+      ReadLock lock(mutex);
+      ASSERT_EQ(c1, c2);
+    }
+  };
+
+  auto write_loop = [&]() {
+    for (int i = 0; i < iterations / 10; i++) {
+      WriteLock lock(mutex);
+      c1++;
+      c2++;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < nb_readers; i++) threads.emplace_back(read_loop);
+  for (int i = 0; i < nb_writers; i++) threads.emplace_back(write_loop);
+  for (auto &t : threads) t.join();
+
+  ASSERT_EQ(nb_writers * (iterations / 10), c1);
+  ASSERT_EQ(c1, c2);
+}
+
+// a reader waiting for a writer which holds the mutex for a long time does not
+// keep spinning
+TEST(ShardedSharedMutex, LongWriter) {
+  ShardedSharedMutex mutex;
+  const auto hold_time = std::chrono::milliseconds(300);
+  auto thread_cpu_ms = []() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+  };
+
+  WriteLock write_lock(mutex);
+  double reader_cpu_ms = 0;
+  std::thread reader([&mutex, &reader_cpu_ms, &thread_cpu_ms] {
+      const double start = thread_cpu_ms();
+      ReadLock lock(mutex);
+      reader_cpu_ms = thread_cpu_ms() - start;
+  });
+  std::this_thread::sleep_for(hold_time);
+  write_lock.unlock();
+  reader.join();
+  ASSERT_LT(reader_cpu_ms, hold_time.count() / 3.0);
+}
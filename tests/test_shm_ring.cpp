@@ -0,0 +1,270 @@
+/* Copyright 2013-present Barefoot Networks, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <bm/bm_sim/shm_ring.h>
+#include <bm/bm_sim/transport.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstring>
+
+using namespace bm;
+
+using std::chrono::milliseconds;
+
+class ShmRingTest : public ::testing::Test {
+ protected:
+  ShmRingTest()
+      : name("bmv2-test-ring-" + std::to_string(::getpid())) { }
+
+  void TearDown() override {
+    ::unlink(ShmRing::get_path(name).c_str());
+  }
+
+  std::string name;
+};
+
+TEST_F(ShmRingTest, ParseAddr) {
+  std::string ring_name;
+  ASSERT_TRUE(ShmRing::parse_addr("shm://bmv2-0-notifications", &ring_name));
+  ASSERT_EQ("bmv2-0-notifications", ring_name);
+  ASSERT_FALSE(ShmRing::parse_addr("ipc:///tmp/bmv2-0-notifications.ipc",
+                                   &ring_name));
+}
+
+TEST_F(ShmRingTest, PushPop) {
+  ASSERT_EQ(nullptr, ShmRing::attach(name));
+  auto producer = ShmRing::create(name, 4096);
+  ASSERT_NE(nullptr, producer);
+  auto consumer = ShmRing::attach(name);
+  ASSERT_NE(nullptr, consumer);
+
+  char buf[64];
+  ASSERT_EQ(ShmRing::POP_TIMEOUT,
+            consumer->pop(buf, sizeof(buf), milliseconds(10)));
+
+  const char hdr[] = "abc";
+  const char data[] = "defgh";
+  ASSERT_TRUE(producer->push({{hdr, 3}, {data, 5}}));
+  ASSERT_EQ(8, consumer->pop(buf, sizeof(buf), milliseconds(10)));
+  ASSERT_EQ(0, std::memcmp("abcdefgh", buf, 8));
+
+  // truncated
+  ASSERT_TRUE(producer->push({{data, 5}}));
+  ASSERT_EQ(5, consumer->pop(buf, 2, milliseconds(10)));
+  ASSERT_EQ(0, std::memcmp("de", buf, 2));
+
+  // empty message, not to be confused with a timeout
+  ASSERT_TRUE(producer->push({{data, 0}}));
+  ASSERT_EQ(0, consumer->pop(buf, sizeof(buf), milliseconds(10)));
+  ASSERT_EQ(ShmRing::POP_TIMEOUT,
+            consumer->pop(buf, sizeof(buf), milliseconds(10)));
+
+  ASSERT_FALSE(consumer->is_closed());
+  producer.reset();
+  ASSERT_TRUE(consumer->is_closed());
+  ASSERT_EQ(ShmRing::POP_CLOSED,
+            consumer->pop(buf, sizeof(buf), milliseconds(10)));
+}
+
+TEST_F(ShmRingTest, ReplaceOpen) {
+  auto producer = ShmRing::create(name, 4096);
+  ASSERT_NE(nullptr, producer);
+  auto consumer = ShmRing::attach(name);
+  ASSERT_NE(nullptr, consumer);
+
+  // the ring is still in use
+  ASSERT_EQ(nullptr, ShmRing::create(name, 4096));
+  ASSERT_FALSE(consumer->is_closed());
+  ASSERT_TRUE(producer->push({{"abc", 3}}));
+
+  auto new_producer = ShmRing::create(name, 4096, true);
+  ASSERT_NE(nullptr, new_producer);
+  ASSERT_TRUE(consumer->is_closed());
+
+  // a closed ring can always be replaced
+  new_producer.reset();
+  ASSERT_NE(nullptr, ShmRing::create(name, 4096));
+}
+
+TEST_F(ShmRingTest, Permissions) {
+  const std::string path = ShmRing::get_path(name);
+  struct stat st;
+  {
+    auto producer = ShmRing::create(name, 4096);
+    ASSERT_NE(nullptr, producer);
+    ASSERT_EQ(0, ::stat(path.c_str(), &st));
+    ASSERT_EQ(0600u, st.st_mode & 0777);
+  }
+  auto producer = ShmRing::create(name, 4096, false, 0644);
+  ASSERT_NE(nullptr, producer);
+  ASSERT_EQ(0, ::stat(path.c_str(), &st));
+  ASSERT_EQ(0644u, st.st_mode & 0777);
+}
+
+TEST_F(ShmRingTest, Symlink) {
+  const std::string path = ShmRing::get_path(name);
+  const std::string target = path + "-target";
+  {
+    int fd = ::open(target.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    ASSERT_LE(0, fd);
+    ASSERT_EQ(3, ::write(fd, "abc", 3));
+    ::close(fd);
+  }
+  ASSERT_EQ(0, ::symlink(target.c_str(), path.c_str()));
+
+  // the link is replaced by a new file, its target is left untouched
+  auto producer = ShmRing::create(name, 4096);
+  ASSERT_NE(nullptr, producer);
+  struct stat st;
+  ASSERT_EQ(0, ::lstat(path.c_str(), &st));
+  ASSERT_TRUE(S_ISREG(st.st_mode));
+  ASSERT_EQ(0, ::stat(target.c_str(), &st));
+  ASSERT_EQ(3, st.st_size);
+  ::unlink(target.c_str());
+
+  // consumers do not follow links either
+  const std::string link_name = name + "-link";
+  const std::string link_path = ShmRing::get_path(link_name);
+  ASSERT_EQ(0, ::symlink(path.c_str(), link_path.c_str()));
+  ASSERT_EQ(nullptr, ShmRing::attach(link_name));
+  ::unlink(link_path.c_str());
+}
+
+TEST_F(ShmRingTest, InvalidRecord) {
+  auto producer = ShmRing::create(name, 4096);
+  auto consumer = ShmRing::attach(name);
+  ASSERT_TRUE(producer->push({{"abc", 3}}));
+  ASSERT_TRUE(producer->push({{"def", 3}}));
+
+  // overwrite the size of the first message, the records start right after
+  // the ring header
+  {
+    int fd = ::open(ShmRing::get_path(name).c_str(), O_RDWR);
+    ASSERT_LE(0, fd);
+    struct stat st;
+    ASSERT_EQ(0, ::fstat(fd, &st));
+    const uint32_t len = 1u << 30;
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(len)),
+              ::pwrite(fd, &len, sizeof(len),
+                       st.st_size - producer->get_capacity()));
+    ::close(fd);
+  }
+
+  // both messages are dropped, but the ring can still be used
+  char buf[64];
+  ASSERT_EQ(ShmRing::POP_INVALID,
+            consumer->pop(buf, sizeof(buf), milliseconds(10)));
+  ASSERT_EQ(ShmRing::POP_TIMEOUT,
+            consumer->pop(buf, sizeof(buf), milliseconds(10)));
+  ASSERT_TRUE(producer->push({{"ghi", 3}}));
+  ASSERT_EQ(3, consumer->pop(buf, sizeof(buf), milliseconds(10)));
+  ASSERT_EQ(0, std::memcmp("ghi", buf, 3));
+}
+
+TEST_F(ShmRingTest, Overflow) {
+  auto producer = ShmRing::create(name, 4096);
+  ASSERT_EQ(4096u, producer->get_capacity());
+  auto consumer = ShmRing::attach(name);
+  std::vector<char> msg(1000, 'a');
+  size_t nb_pushed = 0;
+  while (producer->push({{msg.data(), msg.size()}})) nb_pushed++;
+  ASSERT_EQ(4u, nb_pushed);  // 4 * (1000 + 8) bytes
+  ASSERT_EQ(1u, producer->get_dropped());
+  // messages larger than half the ring are always dropped
+  std::vector<char> big_msg(3000, 'b');
+  ASSERT_FALSE(producer->push({{big_msg.data(), big_msg.size()}}));
+  ASSERT_EQ(2u, consumer->get_dropped());
+
+  char buf[1024];
+  ASSERT_EQ(1000, consumer->pop(buf, sizeof(buf), milliseconds(10)));
+  ASSERT_TRUE(producer->push({{msg.data(), msg.size()}}));
+}
+
+TEST_F(ShmRingTest, ProducerConsumer) {
+  auto producer = ShmRing::create(name, 4096);
+  auto consumer = ShmRing::attach(name);
+  const uint32_t nb_msgs = 100000;
+
+  // message sizes are not a multiple of the record alignment, and the ring
+  // wraps around many times
+  std::thread producer_thread([&producer, nb_msgs]() {
+    char payload[64];
+    for (uint32_t i = 0; i < nb_msgs; i++) {
+      std::memcpy(payload, &i, sizeof(i));
+      size_t len = sizeof(i) + (i % 37);
+      while (!producer->push({{payload, len}})) std::this_thread::yield();
+    }
+  });
+
+  char buf[64];
+  uint32_t expected = 0;
+  bool ok = true;
+  while (expected < nb_msgs) {
+    int len = consumer->pop(buf, sizeof(buf), milliseconds(1000));
+    if (len <= 0) {
+      ok = false;
+      break;
+    }
+    uint32_t i;
+    std::memcpy(&i, buf, sizeof(i));
+    if (i != expected ||
+        static_cast<size_t>(len) != sizeof(i) + (i % 37)) {
+      ok = false;
+      break;
+    }
+    expected++;
+  }
+  producer_thread.join();
+  ASSERT_TRUE(ok);
+}
+
+TEST_F(ShmRingTest, Transport) {
+  auto transport = TransportIface::make_shm(name, 4096);
+  transport->open();
+  auto consumer = ShmRing::attach(name);
+  ASSERT_NE(nullptr, consumer);
+
+  char hdr[] = "LEA|";
+  char data[] = {'\xab', '\xcd'};
+  TransportIface::MsgBuf buf_hdr = {hdr, 4};
+  TransportIface::MsgBuf buf_data = {data, sizeof(data)};
+  ASSERT_EQ(0, transport->send_msgs({buf_hdr, buf_data}));
+  ASSERT_EQ(0, transport->send(std::string("hello")));
+
+  char buf[64];
+  ASSERT_EQ(6, consumer->pop(buf, sizeof(buf), milliseconds(10)));
+  ASSERT_EQ(0, std::memcmp("LEA|\xab\xcd", buf, 6));
+  ASSERT_EQ(5, consumer->pop(buf, sizeof(buf), milliseconds(10)));
+  ASSERT_EQ(0, std::memcmp("hello", buf, 5));
+
+  // re-creating the ring closes the previous one
+  auto other_transport = TransportIface::make_shm(name, 4096, true);
+  other_transport->open();
+  ASSERT_TRUE(consumer->is_closed());
+  auto new_consumer = ShmRing::attach(name);
+  ASSERT_NE(nullptr, new_consumer);
+  ASSERT_FALSE(new_consumer->is_closed());
+}
@@ -22,6 +22,9 @@
 
 #include <bm/bm_sim/stateful.h>
 
+#include <thread>
+#include <vector>
+
 using bm::RegisterArray;
 
 // Google Test fixture for Stateful tests
@@ -70,3 +73,51 @@ TEST_F(StatefulTest, Notifier) {
     ASSERT_EQ(index_test_v, index);
   }
 }
+
+TEST_F(StatefulTest, ReadWrite) {
+  bm::Data v;
+  reg_array.write(7, bm::Data(0xab));
+  reg_array.read(7, &v);
+  ASSERT_EQ(0xabu, v.get_uint());
+  // values are truncated to the register bitwidth
+  reg_array.write(8, bm::Data("0x1ffffffff"));
+  reg_array.read(8, &v);
+  ASSERT_EQ(0xffffffffu, v.get_uint());
+}
+
+TEST_F(StatefulTest, ReadWriteWithRegisterSync) {
+  bm::RegisterSync register_sync;
+  register_sync.add_register_array(&reg_array);
+  bm::RegisterSync::RegisterLocks RL;
+  register_sync.lock(&RL);
+  // the array is already locked by this thread, this must not deadlock
+  bm::Data v;
+  reg_array.write(3, bm::Data(99));
+  reg_array.read(3, &v);
+  ASSERT_EQ(99u, v.get_uint());
+  ASSERT_TRUE(bm::RegisterSync::is_locked_by_thread(&reg_array));
+}
+
+TEST_F(StatefulTest, ConcurrentStripedWrites) {
+  constexpr size_t nb_threads = 4;
+  constexpr int iterations = 10000;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < nb_threads; t++) {
+    threads.emplace_back([this, t]() {
+      bm::Data v;
+      for (int i = 0; i < iterations; i++) {
+        // each thread increments its own register and reads a shared one
+        reg_array.read(t, &v);
+        v.add(v, bm::Data(1));
+        reg_array.write(t, v);
+        reg_array.read(size - 1, &v);
+      }
+    });
+  }
+  for (auto &t : threads) t.join();
+  bm::Data v;
+  for (size_t t = 0; t < nb_threads; t++) {
+    reg_array.read(t, &v);
+    ASSERT_EQ(static_cast<unsigned int>(iterations), v.get_uint());
+  }
+}
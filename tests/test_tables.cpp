@@ -532,6 +532,50 @@ TYPED_TEST(TableSizeTwo, NextNodeHitMiss) {
   ASSERT_EQ(&dummy_node_miss, this->table->apply_action(&pkt));
 }
 
+TYPED_TEST(TableSizeTwo, ApplyActionBatch) {
+  std::string key_1 = "\x0a\xba";
+  std::string key_2 = "\x0b\xbb";
+  entry_handle_t handle_1, handle_2;
+  MatchErrorCode rc;
+
+  rc = this->add_entry(key_1, &handle_1);
+  ASSERT_EQ(MatchErrorCode::SUCCESS, rc);
+  rc = this->add_entry(key_2, &handle_2);
+  ASSERT_EQ(MatchErrorCode::SUCCESS, rc);
+
+  const std::vector<std::string> values = {"0xaba", "0xcba", "0xbbb", "0xaba"};
+  std::vector<Packet> pkts;
+  std::vector<Packet *> pkt_ptrs;
+  for (const auto &v : values) {
+    pkts.push_back(this->get_pkt(64));
+    pkts.back().get_phv()->get_field(this->testHeader1, 0).set(v);
+  }
+  for (auto &pkt : pkts) pkt_ptrs.push_back(&pkt);
+
+  std::vector<const ControlFlowNode *> next_nodes;
+  this->table->apply_action_batch(pkt_ptrs, &next_nodes);
+  ASSERT_EQ(values.size(), next_nodes.size());
+
+  const auto handle_index_mask = static_cast<entry_handle_t>(0x00ffffff);
+  ASSERT_EQ(nullptr, next_nodes[0]);
+  ASSERT_EQ(handle_index_mask & handle_1, pkts[0].get_entry_index());
+  ASSERT_EQ(&this->node_miss_default, next_nodes[1]);
+  ASSERT_EQ(Packet::INVALID_ENTRY_INDEX, pkts[1].get_entry_index());
+  ASSERT_EQ(nullptr, next_nodes[2]);
+  ASSERT_EQ(handle_index_mask & handle_2, pkts[2].get_entry_index());
+  ASSERT_EQ(nullptr, next_nodes[3]);
+  ASSERT_EQ(handle_index_mask & handle_1, pkts[3].get_entry_index());
+
+  // same as for individual lookups, the counters are updated for hits
+  uint64_t counter_bytes = 0, counter_packets = 0;
+  rc = this->table->query_counters(handle_1, &counter_bytes, &counter_packets);
+  ASSERT_EQ(MatchErrorCode::SUCCESS, rc);
+  ASSERT_EQ(2u, counter_packets);
+  rc = this->table->query_counters(handle_2, &counter_bytes, &counter_packets);
+  ASSERT_EQ(MatchErrorCode::SUCCESS, rc);
+  ASSERT_EQ(1u, counter_packets);
+}
+
 TYPED_TEST(TableSizeTwo, SetDefaultAction) {
   std::string key = "\x0a\xba";
   MatchErrorCode rc;
@@ -3473,6 +3517,120 @@ TEST_F(TableTernaryCache, CacheUpdate) {
 }
 
 
+// small ternary tables use a priority-sorted array instead of the default
+// ternary lookup structure; we check that both structures agree
+class TableTernarySmall : public ::testing::Test {
+ protected:
+  static constexpr size_t small_size = 64u;
+  static constexpr size_t large_size = 1024u;
+  // 9 bytes, so that the key does not fit in a single 64-bit word
+  static constexpr size_t nbytes = 9u;
+
+  PHVFactory phv_factory;
+
+  HeaderType testHeaderType;
+  header_id_t testHeader{0};
+  ActionFn action_fn;
+
+  std::unique_ptr<PHVSourceIface> phv_source{nullptr};
+
+  TableTernarySmall()
+      : testHeaderType("test_t", 0), action_fn("actionA", 0, 0),
+        phv_source(PHVSourceIface::make_phv_source()) {
+    testHeaderType.push_back_field("f72", nbytes * 8);
+    phv_factory.push_back_header("testHdr", testHeader, testHeaderType);
+  }
+
+  std::unique_ptr<MatchTable> create_table(size_t t_size) {
+    MatchKeyBuilder key_builder;
+    key_builder.push_back_field(testHeader, 0, nbytes * 8,
+                                MatchKeyParam::Type::TERNARY);
+    std::unique_ptr<MUTernary> match_unit(
+        new MUTernary(t_size, key_builder, &lookup_factory));
+    std::unique_ptr<MatchTable> table(
+        new MatchTable("test_table", 0, std::move(match_unit), false));
+    table->set_next_node(0, nullptr);
+    return table;
+  }
+
+  bool lookup(MatchTable *table, const std::string &binary_key,
+              entry_handle_t *lookup_handle) {
+    bool hit;
+    const ControlFlowNode *next_node;
+    Packet packet = Packet::make_new(128, PacketBuffer(256), phv_source.get());
+    auto &hdr = packet.get_phv()->get_header(testHeader);
+    hdr.mark_valid();
+    hdr.get_field(0).set(binary_key.data(), binary_key.size());
+    table->lookup(packet, &hit, lookup_handle, &next_node);
+    return hit;
+  }
+
+  virtual void SetUp() {
+    phv_source->set_phv_factory(0, &phv_factory);
+  }
+};
+
+TEST_F(TableTernarySmall, SameResultsAsLarge) {
+  auto small_table = create_table(small_size);
+  auto large_table = create_table(large_size);
+
+  std::mt19937 gen(42);
+  // few distinct byte values, to get a good mix of hits and misses
+  std::uniform_int_distribution<int> byte_dis(0, 3);
+  std::uniform_int_distribution<int> mask_dis(0, 2);
+  std::uniform_int_distribution<int> priority_dis(0, 8);
+  auto gen_bytes = [&gen, &byte_dis]() {
+    std::string bytes(nbytes, '\0');
+    for (auto &b : bytes) b = static_cast<char>(byte_dis(gen));
+    return bytes;
+  };
+  auto gen_mask = [&gen, &mask_dis]() {
+    std::string mask(nbytes, '\0');
+    for (auto &b : mask) b = (mask_dis(gen) == 0) ? '\x00' : '\xff';
+    return mask;
+  };
+
+  std::vector<std::pair<entry_handle_t, entry_handle_t> > handles;
+  for (size_t i = 0; i < small_size; i++) {
+    std::vector<MatchKeyParam> match_key;
+    match_key.emplace_back(MatchKeyParam::Type::TERNARY, gen_bytes(),
+                           gen_mask());
+    int priority = priority_dis(gen);
+    entry_handle_t h_small, h_large;
+    auto rc_small = small_table->add_entry(match_key, &action_fn, ActionData(),
+                                           &h_small, priority);
+    auto rc_large = large_table->add_entry(match_key, &action_fn, ActionData(),
+                                           &h_large, priority);
+    ASSERT_EQ(rc_large, rc_small);
+    if (rc_small != MatchErrorCode::SUCCESS) continue;
+    ASSERT_EQ(h_large, h_small);
+    handles.emplace_back(h_small, h_large);
+  }
+
+  auto check_lookups = [&]() {
+    for (size_t i = 0; i < 256; i++) {
+      auto key = gen_bytes();
+      entry_handle_t h_small, h_large;
+      bool hit_small = lookup(small_table.get(), key, &h_small);
+      bool hit_large = lookup(large_table.get(), key, &h_large);
+      ASSERT_EQ(hit_large, hit_small);
+      if (hit_small) {
+        ASSERT_EQ(h_large, h_small);
+      }
+    }
+  };
+
+  check_lookups();
+  // delete every other entry and check again
+  for (size_t i = 0; i < handles.size(); i += 2) {
+    ASSERT_EQ(MatchErrorCode::SUCCESS,
+              small_table->delete_entry(handles[i].first));
+    ASSERT_EQ(MatchErrorCode::SUCCESS,
+              large_table->delete_entry(handles[i].second));
+  }
+  check_lookups();
+}
+
 template <typename MTType>
 class TableDefaultDefaultEntryTest : public ::testing::Test {
  protected:
@@ -230,6 +230,14 @@ exception InvalidCrcOperation {
  1:CrcErrorCode code
 }
 
+enum LogErrorCode {
+  INVALID_SUBSYSTEM = 1
+}
+
+exception InvalidLogOperation {
+ 1:LogErrorCode code
+}
+
 enum BmActionEntryType {
   NONE = 0,  // used when querying default entry, if none configured
   ACTION_DATA = 1,
@@ -703,6 +711,16 @@ service Standard {
 
   void bm_reset_state()
 
+  // enable or disable debug and trace messages for a subsystem ("parser",
+  // "tables", ...), or for all subsystems if subsystem is "all"
+  void bm_set_log_subsystem(
+    1:string subsystem,
+    2:bool enabled
+  ) throws (1:InvalidLogOperation ouch)
+
+  // subsystem name -> enabled
+  map<string, bool> bm_get_log_subsystems()
+
   string bm_get_config()
   string bm_get_config_md5()
 
@@ -140,8 +140,11 @@ class Msg(object):
 
     def extract(self):
         bytes_extracted = self.extract_hdr()
-        msg_remainder = self.msg[bytes_extracted:]
-        return self.struct_.unpack(msg_remainder)
+        return self.struct_.unpack_from(self.msg, bytes_extracted)
+
+    # size of this event in the message
+    def size(self):
+        return struct.calcsize("<iQIQQQ") + self.struct_.size
 
     def __str__(self):
         return "type: %s, switch_id: %d, cxt_id: %d, sig: %d, " \
@@ -432,21 +435,24 @@ def recv_msgs(socket_addr, client):
 
     while True:
         msg = sub.recv()
-        msg_type = get_msg_type(msg)
-
-        try:
-            p = MSG_TYPES.get_msg_class(msg_type)(msg)
-        except:
-            print "Unknown msg type", msg_type
-            continue
-        p.extract()
-        print p
-
-        if p.type_ == MSG_TYPES.CONFIG_CHANGE:
-            print "The JSON config has changed"
-            print "Requesting new config from switch,",
-            print "which may cause some log messages to be dropped"
-            json_init(client)
+        # with --nanolog-ring-size, a message can include several events
+        while msg:
+            msg_type = get_msg_type(msg)
+
+            try:
+                p = MSG_TYPES.get_msg_class(msg_type)(msg)
+            except:
+                print "Unknown msg type", msg_type
+                break
+            p.extract()
+            print p
+            msg = msg[p.size():]
+
+            if p.type_ == MSG_TYPES.CONFIG_CHANGE:
+                print "The JSON config has changed"
+                print "Requesting new config from switch,",
+                print "which may cause some log messages to be dropped"
+                json_init(client)
 
 def main():
     deprecated_args = ["json"]
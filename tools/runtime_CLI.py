@@ -673,6 +673,9 @@ def handle_bad_input(f):
         except InvalidCrcOperation as e:
             error = CrcErrorCode._VALUES_TO_NAMES[e.code]
             print "Invalid crc operation (%s)" % error
+        except InvalidLogOperation as e:
+            error = LogErrorCode._VALUES_TO_NAMES[e.code]
+            print "Invalid log operation (%s)" % error
     return handle
 
 def handle_bad_input_mc(f):
@@ -2297,6 +2300,22 @@ class RuntimeAPI(cmd.Cmd):
         self.exactly_n_args(line.split(), 0)
         self.client.bm_reset_state()
 
+    @handle_bad_input
+    def do_set_log_subsystem(self, line):
+        "Enable or disable debug and trace messages for a subsystem, or for all of them: set_log_subsystem <subsystem | all> <enabled?>"
+        args = line.split()
+        self.exactly_n_args(args, 2)
+        enabled = parse_bool(args[1])
+        self.client.bm_set_log_subsystem(args[0], enabled)
+
+    @handle_bad_input
+    def do_show_log_subsystems(self, line):
+        "Show which subsystems have debug and trace messages enabled: show_log_subsystems"
+        self.exactly_n_args(line.split(), 0)
+        subsystems = self.client.bm_get_log_subsystems()
+        for name, enabled in sorted(subsystems.items()):
+            print "{:15}: {}".format(name, "enabled" if enabled else "disabled")
+
     @handle_bad_input
     def do_write_config_to_file(self, line):
         "Retrieves the JSON config currently used by the switch and dumps it to user-specified file"